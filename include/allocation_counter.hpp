@@ -0,0 +1,4 @@
+#pragma once
+
+// Number of heap allocations made through operator new since the program started, on any thread
+unsigned long long allocationCount();
@@ -0,0 +1,20 @@
+#pragma once
+#include <light_clusters.hpp>
+#include <shader.hpp>
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+// Run a named benchmark, returns the process exit code. Needs a current OpenGL context unless the benchmark is
+// CPU only
+int runBenchmark(const std::string&);
+// Whether a benchmark runs on the CPU alone, those don't need a window or a GPU
+bool isCpuBenchmark(const std::string&);
+// Model matrices of the stress scene: copies of a model on a square grid around the origin
+std::vector<glm::mat4> stressSceneTransforms(unsigned int);
+// Point lights of the light scene circling over a square around the origin, the same lights every call apart from
+// where they are on their circles: count, half the square's side, time in seconds, output
+void lightSceneLights(unsigned int, float, float, std::vector<PointLight>&);
+// Use a shader and set the light scene's ambient light, sun and shininess on it, names it doesn't have are skipped
+void applyLightSceneLighting(Shader&);
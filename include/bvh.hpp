@@ -0,0 +1,68 @@
+#pragma once
+#include <frustum.hpp>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+// Axis aligned box by its corners
+struct Aabb {
+    glm::vec3 min;
+    glm::vec3 max;
+
+    // Box holding both
+    static Aabb merge(const Aabb& a, const Aabb& b) { return Aabb{ glm::min(a.min, b.min), glm::max(a.max, b.max) }; }
+    // Box around a transformed box (box, matrix)
+    static Aabb transform(const Aabb&, const glm::mat4&);
+    glm::vec3 center() const { return (min + max) * 0.5f; }
+    float surfaceArea() const {
+        glm::vec3 size = glm::max(max - min, glm::vec3(0.0f));
+        return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+    }
+};
+
+// Bounding volume hierarchy over scene objects, identified by their index in the box list it was built from.
+// Built top down with the binned surface area heuristic. Moving objects are refitted: update changes one box and
+// grows or shrinks its ancestors, refit redoes all boxes bottom up after many changes. Neither changes the tree,
+// so objects that moved far from where they were built make queries slower until the next build.
+class Bvh {
+public:
+    // Build over the boxes of all objects
+    void build(const std::vector<Aabb>&);
+    // Give an object a new box and refit the nodes above it, stops as soon as a node's box stays the same
+    void update(unsigned int, const Aabb&);
+    // Give many objects new boxes (indexed like build's), then refit the whole tree in one pass
+    void refit(const std::vector<Aabb>&);
+    // Append every object whose box is at least partially inside the frustum. Returns the number of nodes visited
+    size_t queryFrustum(const Frustum&, std::vector<unsigned int>&) const;
+    // Closest object whose box the ray (origin, direction) hits within the given distance, which is updated to
+    // the hit. Returns the object, or ~0u when nothing was hit
+    unsigned int raycast(glm::vec3, glm::vec3, float&) const;
+
+    size_t nodeCount() const { return nodes.size(); }
+    size_t objectCount() const { return boxes.size(); }
+    // Surface area heuristic cost of the tree relative to its root, grows as refits loosen the boxes
+    float cost() const;
+private:
+    struct Node {
+        Aabb bounds;
+        // first child, the second one follows it. 0 for leaves, the root is never anyone's child
+        unsigned int left;
+        // range of objects in the subtree
+        unsigned int first;
+        unsigned int count;
+        unsigned int parent;
+    };
+    struct BuildObject;
+    std::vector<Node> nodes;
+    // object indices and their boxes in tree order, every subtree covers a contiguous range
+    std::vector<unsigned int> objects;
+    std::vector<Aabb> boxes;
+    // position in tree order and leaf node of every object
+    std::vector<unsigned int> objectSlot;
+    std::vector<unsigned int> objectLeaf;
+
+    // split the root until every leaf is small or not worth splitting
+    void subdivide(std::vector<BuildObject>&);
+    Aabb leafBounds(const Node&) const;
+};
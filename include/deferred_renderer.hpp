@@ -0,0 +1,49 @@
+#pragma once
+#include <shader.hpp>
+
+// Deferred shading with a compact G-buffer: the geometry pass only writes surface attributes, then one full screen
+// pass lights every visible pixel once, however many fragments were drawn over it. Per pixel the G-buffer holds
+// albedo and specular intensity (RGBA8), an octahedral normal and the shininess (RGB10_A2) and 32 bit float depth,
+// the lighting pass reconstructs the position from depth and the Camera block. Lights come from the clusters
+// LightClusters::bind bound, the same ones forward shading with model_clustered.frag loops over, and both shade them
+// with the code in clustered_lighting.glsl, so the two paths light the same scene the same way. Everything drawn into the G-buffer is treated as opaque.
+// Needs GL 4.3 for the light storage buffers, check supported() first. All functions must run on the GL thread.
+class DeferredRenderer {
+public:
+    DeferredRenderer();
+    ~DeferredRenderer();
+    DeferredRenderer(const DeferredRenderer&) = delete;
+    DeferredRenderer& operator=(const DeferredRenderer&) = delete;
+
+    // Whether the current context has what this path needs
+    static bool supported();
+
+    // What meshes have to be drawn with between beginGeometry and resolve, it takes the same material textures and
+    // shininess uniform as model_clustered.frag
+    Shader& geometryShader() { return geometry; }
+    // The full screen lighting pass, it takes the same ambient and sun uniforms as model_clustered.frag
+    Shader& lightingShader() { return lighting; }
+
+    // Bind the G-buffer, (re)created at the given size (width, height) in pixels, and clear its depth
+    void beginGeometry(int, int);
+    // Light the G-buffer into the default framebuffer, the Camera and ClusterGrid blocks and the light storage
+    // buffers have to be bound. Pixels nothing was drawn to are left as they were
+    void resolve();
+private:
+    Shader geometry;
+    Shader lighting;
+    UniformHandle<int> albedoSpecularUniform;
+    UniformHandle<int> normalUniform;
+    UniformHandle<int> depthUniform;
+    unsigned int framebuffer = 0;
+    unsigned int albedoSpecular = 0;
+    unsigned int normal = 0;
+    unsigned int depth = 0;
+    int width = 0, height = 0;
+    // the lighting pass draws a triangle covering the screen from gl_VertexID, core profiles still need a VAO bound
+    unsigned int emptyVAO = 0;
+
+    // Create the G-buffer textures and attach them at the current size
+    void createTargets();
+    void deleteTargets();
+};
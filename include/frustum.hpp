@@ -0,0 +1,39 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// View frustum as six inward facing planes (xyz normal, w distance), in the space of the matrix it was built from
+struct Frustum {
+    glm::vec4 planes[6];
+
+    Frustum() = default;
+    // Extract the planes of a projection * view (* model) matrix, the result lives in that matrix's input space
+    explicit Frustum(const glm::mat4&);
+    // Whether a sphere is at least partially inside
+    bool intersectsSphere(glm::vec3, float) const;
+    // Whether an axis aligned box (center, half size) is at least partially inside
+    bool intersectsBox(glm::vec3, glm::vec3) const;
+};
+
+// Bounds of many objects, one array per component so culling can test several objects per instruction
+struct BoundsArrays {
+    std::vector<float> centerX, centerY, centerZ;
+    // bounding sphere around the center
+    std::vector<float> radius;
+    // half size of the axis aligned box around the center
+    std::vector<float> extentX, extentY, extentZ;
+
+    size_t size() const { return centerX.size(); }
+    void clear();
+    // Add an object: center, sphere radius, box half size
+    void push(glm::vec3, float, glm::vec3);
+};
+
+// Visibility of every sphere or box against a frustum in the same space, 1 when at least partially inside.
+// Tests 8 objects at a time with AVX, 4 with SSE, one at a time without either
+void cullSpheres(const Frustum&, const BoundsArrays&, std::vector<unsigned char>&);
+void cullBoxes(const Frustum&, const BoundsArrays&, std::vector<unsigned char>&);
+// One object at a time, what the SIMD versions have to agree with
+void cullSpheresScalar(const Frustum&, const BoundsArrays&, std::vector<unsigned char>&);
+void cullBoxesScalar(const Frustum&, const BoundsArrays&, std::vector<unsigned char>&);
@@ -0,0 +1,61 @@
+#pragma once
+#include <vertex.hpp>
+
+#include <cstddef>
+#include <map>
+
+// Where a mesh's data lives inside a GeometryArena
+struct GeometryAllocation {
+    VertexFormat format = VertexFormat::Full;
+    // vertex array object shared by every mesh of the format
+    unsigned int VAO = 0;
+    // first vertex in the format's vertex buffer, passed as the base vertex of draws
+    unsigned int baseVertex = 0;
+    unsigned int vertexCount = 0;
+    // first byte in the shared index buffer
+    size_t indexOffset = 0;
+    size_t indexBytes = 0;
+};
+
+// Large vertex and index buffers meshes are suballocated from: one vertex buffer and VAO per vertex format and one
+// index buffer shared by all of them. Meshes draw with glDrawElementsBaseVertex, so switching between meshes of the
+// same format needs no buffer or VAO changes. Buffers grow on demand, allocations keep their offsets when they do.
+// All functions must run on the GL thread.
+class GeometryArena {
+public:
+    GeometryArena() = default;
+    ~GeometryArena();
+    GeometryArena(const GeometryArena&) = delete;
+    GeometryArena& operator=(const GeometryArena&) = delete;
+
+    // Copy vertex data in the given format (data, vertex count) and index data of any size (data, bytes) into the arena
+    GeometryAllocation allocate(VertexFormat, const void*, size_t, const void*, size_t);
+    // Give an allocation's space back
+    void free(const GeometryAllocation&);
+    // Arena shared by all models that don't have their own
+    static GeometryArena& shared();
+private:
+    // first fit free list over a buffer of some capacity, in elements
+    struct RangeAllocator {
+        size_t capacity = 0;
+        std::map<size_t, size_t> freeRanges;
+
+        // returns false when no free range is large enough
+        bool allocate(size_t, size_t, size_t&);
+        void free(size_t, size_t);
+        void grow(size_t);
+    };
+    struct VertexPool {
+        unsigned int VAO = 0;
+        unsigned int VBO = 0;
+        RangeAllocator ranges;
+    };
+    // indexed by VertexFormat
+    VertexPool pools[static_cast<size_t>(VertexFormat::PackedFloatSkinned) + 1];
+    unsigned int EBO = 0;
+    RangeAllocator indexRanges;
+
+    VertexPool& pool(VertexFormat);
+    // replace a buffer with a larger one holding the same contents
+    static unsigned int growBuffer(unsigned int, size_t, size_t);
+};
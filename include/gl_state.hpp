@@ -0,0 +1,54 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <cstddef>
+
+// Shadow copy of the GL bindings the renderer uses: program, VAO, textures and samplers per unit and the buffer
+// binding points. Binds that wouldn't change anything are skipped, every call is counted in RenderStats as issued
+// or elided. It only works if all binds go through here, code that binds behind its back has to call invalidate.
+// Must only be used on the GL thread.
+class GLState {
+public:
+    static GLState& current();
+
+    void useProgram(unsigned int);
+    void bindVertexArray(unsigned int);
+    // Bind a texture to a unit (unit, target, texture), the active unit only changes when a bind is needed
+    void bindTexture(unsigned int, GLenum, unsigned int);
+    // Bind a sampler object to a unit (unit, sampler)
+    void bindSampler(unsigned int, unsigned int);
+    void bindBuffer(GLenum, unsigned int);
+    // Bind a buffer to an indexed binding point (target, index, buffer). Always issued, but the generic binding of
+    // the target changes along with it
+    void bindBufferBase(GLenum, unsigned int, unsigned int);
+    // Same for a byte range of the buffer (target, index, buffer, offset, size)
+    void bindBufferRange(GLenum, unsigned int, unsigned int, size_t, size_t);
+
+    // Deleting an object unbinds it. These delete and forget it, so a new object reusing the name isn't skipped
+    void deleteProgram(unsigned int);
+    void deleteVertexArray(unsigned int);
+    void deleteTexture(unsigned int);
+    void deleteBuffer(unsigned int);
+
+    // Forget everything, the next bind of every kind is issued
+    void invalidate();
+private:
+    // units and targets tracked, binds outside of them are always issued
+    static const unsigned int TEXTURE_UNITS = 32;
+    static const unsigned int TEXTURE_TARGETS = 3;
+    static const unsigned int BUFFER_TARGETS = 8;
+    // a binding that isn't known, so the next bind can't be skipped
+    static const unsigned int UNKNOWN = ~0u;
+
+    unsigned int program = UNKNOWN;
+    unsigned int vertexArray = UNKNOWN;
+    unsigned int activeUnit = UNKNOWN;
+    unsigned int textures[TEXTURE_UNITS][TEXTURE_TARGETS];
+    unsigned int samplers[TEXTURE_UNITS];
+    unsigned int buffers[BUFFER_TARGETS];
+
+    GLState();
+    void activeTexture(unsigned int);
+    // counts a call and returns whether it has to be issued
+    static bool changes(unsigned int&, unsigned int);
+};
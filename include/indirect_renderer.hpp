@@ -0,0 +1,104 @@
+#pragma once
+#include <shader.hpp>
+#include <mesh.hpp>
+#include <render_view.hpp>
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Attribute location of the draw index read by the indirect shaders
+#define DRAW_INDEX_ATTRIBUTE_LOCATION 12
+
+// Draws a frame's meshes with a few glMultiDrawElementsIndirect calls: one command per visible mesh (or meshlet
+// range) in a GL_DRAW_INDIRECT_BUFFER and the per-draw model view projection matrices, texture coordinate
+// transforms and material layers in an SSBO range of UniformRing, the camera comes from the shared Camera block.
+// Diffuse textures are copied into texture arrays, one per size and format, so draws only split where the VAO,
+// index type or texture array changes.
+// The shader finds its draw through a per-instance attribute holding 0, 1, 2... and each command's base instance,
+// which stands in for gl_DrawID (core only from GL 4.6). Needs GL 4.3, check supported() first.
+// All functions must run on the GL thread.
+class IndirectRenderer {
+public:
+    IndirectRenderer();
+    ~IndirectRenderer();
+    IndirectRenderer(const IndirectRenderer&) = delete;
+    IndirectRenderer& operator=(const IndirectRenderer&) = delete;
+
+    // Whether the current context has what this path needs
+    static bool supported();
+
+    // Add a mesh at a level of detail: mesh, model matrix, level of detail
+    void add(Mesh&, const glm::mat4&, unsigned int);
+    // Add index ranges of a mesh's full resolution level (mesh, model matrix, counts, byte offsets, range count),
+    // as gathered by Mesh::cullMeshlets. Base vertices come from the mesh
+    void addRanges(Mesh&, const glm::mat4&, const GLsizei*, const void* const*, unsigned int);
+    // Draw everything added since the last submit with a view, the Camera block has to be bound for it
+    void submit(const RenderView&);
+private:
+    // layout of glMultiDrawElementsIndirect commands
+    struct DrawCommand {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+    // std430 layout of DrawData in the shader
+    struct DrawData {
+        glm::mat4 modelViewProjection;
+        glm::vec4 uvTransform;
+        uint32_t layer;
+        uint32_t packedVertex;
+        uint32_t padding[2];
+    };
+    // draws that can go into the same multi-draw call
+    struct Group {
+        unsigned int VAO;
+        unsigned int indexSize;
+        // index into arrays, or ~0u for meshes without a diffuse texture
+        unsigned int textureArray;
+        std::vector<DrawCommand> commands;
+        // where the group's commands start in the command buffer
+        size_t firstCommand;
+    };
+    // layers of diffuse textures sharing size and format, grown by copying into a larger array
+    struct TextureArray {
+        unsigned int id = 0;
+        GLenum internalFormat;
+        int width, height, levels;
+        unsigned int layers = 0;
+        unsigned int capacity = 0;
+    };
+    struct TextureSlot {
+        unsigned int texture;
+        unsigned int array;
+        unsigned int layer;
+    };
+
+    Shader shader;
+    UniformHandle<int> diffuseArrayUniform;
+    unsigned int commandBuffer = 0;
+    // 0, 1, 2... read per instance, so base instance n gives the shader draw index n
+    unsigned int drawIndexBuffer = 0;
+    size_t drawIndexCapacity = 0;
+
+    std::vector<Group> groups;
+    std::vector<DrawData> draws;
+    // model matrices of the draws, turned into the draws' model view projection matrices all at once on submit
+    std::vector<glm::mat4> drawTransforms;
+    std::vector<glm::mat4> drawMatrices;
+    std::vector<DrawCommand> commands;
+    std::vector<TextureArray> arrays;
+    // slots by texture path, the id tells whether the texture was replaced since it was copied
+    std::unordered_map<std::string, TextureSlot> textureSlots;
+
+    // draw data and group of a mesh, returns the draw index
+    uint32_t addDraw(Mesh&, const glm::mat4&, Group*&);
+    // layer of a material's diffuse texture, copying it into an array the first time
+    TextureSlot diffuseSlot(const Material&);
+    void copyLayer(TextureArray&, unsigned int, unsigned int);
+    void growArray(TextureArray&);
+};
@@ -0,0 +1,52 @@
+#pragma once
+#include <transform_batch.hpp>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// First attribute locations of the per-instance model matrix (mat4) and normal matrix (mat3), one location per column.
+// With the vertex attributes below 8 and the indirect draw index at 12 they fill the 16 locations every GL 3.3
+// implementation has, which leaves no room for a model view projection matrix next to them: lit shaders transform the
+// world space position they need anyway by the Camera block's view projection matrix. Shaders that only need the clip
+// space position (Shader::instancesInClipSpace) get the model view projection in place of the model matrix instead
+#define INSTANCE_ATTRIBUTE_LOCATION 8
+#define INSTANCE_NORMAL_ATTRIBUTE_LOCATION 13
+
+// What every instance brings, interleaved in the buffer
+struct InstanceData {
+    // model matrix, or model view projection for shaders that draw instances in clip space
+    glm::mat4 model;
+    NormalMatrix normalMatrix;
+};
+
+// Stream of per-instance model and normal matrices read by the shaders as mat4 and mat3 vertex attributes with
+// divisor 1. Each upload goes behind the previous one, the buffer is orphaned once it's full, so the GPU never waits
+// for data it's still reading. All functions must run on the GL thread.
+class InstanceBuffer {
+public:
+    InstanceBuffer() = default;
+    ~InstanceBuffer();
+    InstanceBuffer(const InstanceBuffer&) = delete;
+    InstanceBuffer& operator=(const InstanceBuffer&) = delete;
+
+    // Copy the matrices of instances (model or model view projection matrices, normal matrices, count) into the
+    // buffer, returns the byte offset they start at. The normal matrices may be null for shaders that don't read them
+    size_t upload(const glm::mat4*, const NormalMatrix*, size_t);
+    // Point the instance attributes of a VAO at the instances uploaded at the given byte offset
+    void bind(unsigned int, size_t);
+    // Drop what's known about a VAO that is being deleted, its name may come back for a new one
+    void forget(unsigned int);
+
+    // Buffer shared by everything that draws instanced
+    static InstanceBuffer& shared();
+private:
+    unsigned int VBO = 0;
+    size_t capacity = 0;
+    size_t cursor = 0;
+    // the instances of an upload interleaved before they're copied
+    std::vector<InstanceData> staging;
+    // offset the instance attributes of each VAO point at, re-pointing only happens when it changes
+    std::vector<std::pair<unsigned int, size_t>> pointed;
+};
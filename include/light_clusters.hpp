@@ -0,0 +1,117 @@
+#pragma once
+#include <render_view.hpp>
+#include <thread_pool.hpp>
+#include <uniform_ring.hpp>
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Shader storage binding points of the clustered lighting buffers
+#define LIGHT_STORAGE_BINDING 1
+#define CLUSTER_STORAGE_BINDING 2
+#define LIGHT_INDEX_STORAGE_BINDING 3
+
+// std430 layout of a point light: world space position and the radius its light reaches, color scaled by intensity
+struct PointLight {
+    glm::vec3 position;
+    float radius;
+    glm::vec3 color;
+    float padding;
+};
+
+// std430 layout of a cluster: where its lights start in the index list and how many there are
+struct ClusterRange {
+    uint32_t offset;
+    uint32_t count;
+};
+
+// std140 layout of the ClusterGrid block: how a fragment finds its cluster
+struct ClusterConstants {
+    // clusters along x, y and z, and the number of lights
+    glm::uvec4 size;
+    // viewport width and height in pixels, near and far plane distance
+    glm::vec4 viewport;
+    // scale and bias turning the log of view space depth into a depth slice
+    glm::vec4 slicing;
+};
+
+// Clustered forward lighting: the view frustum is split into a grid of screen tiles and depth slices growing
+// exponentially with distance, and every point light is assigned to the clusters its sphere touches. A fragment then
+// only loops over the lights of its own cluster, so thousands of lights cost about as much per pixel as a few.
+// Assignment runs on the CPU, one depth slice per thread pool task: the lights reaching into a slice's depth range
+// are gathered first, then tested against the view space box around each row of tiles and the lights touching a row
+// against the boxes of its clusters, four at a time with SSE.
+// build touches no GL and can be checked without a GPU, bind needs GL 4.3 for the shader storage buffers.
+class LightClusters {
+public:
+    // Grid size: tiles across and down the screen, depth slices
+    LightClusters(unsigned int = 16, unsigned int = 9, unsigned int = 24);
+
+    // Whether the current context has shader storage buffers
+    static bool supported();
+
+    // Assign lights to the clusters of a view with a perspective projection: view, viewport size in pixels, lights
+    void build(const RenderView&, glm::vec2, const std::vector<PointLight>&, ThreadPool&);
+    // Same on the calling thread, one light at a time. What build has to agree with
+    void buildScalar(const RenderView&, glm::vec2, const std::vector<PointLight>&);
+    // Write the lights the last build was given, its clusters and index list into the ring and bind them to their
+    // storage binding points, the grid constants to CLUSTER_BLOCK_BINDING (ring, lights). Must run on the GL thread
+    void bind(UniformRing&, const std::vector<PointLight>&) const;
+
+    unsigned int clusterCount() const { return tilesX * tilesY * slices; }
+    // Cluster x + tilesX * (y + tilesY * z), tile rows from the bottom of the screen and slices from the near plane
+    const std::vector<ClusterRange>& clusters() const { return ranges; }
+    // Indices into the lights of the last build, each cluster's in ascending order
+    const std::vector<uint32_t>& lightIndices() const { return indices; }
+private:
+    // view space bounds of one cluster
+    struct Box {
+        glm::vec3 min;
+        glm::vec3 max;
+    };
+    // view space lights, one array per component so SSE loads four lights at once
+    struct LightArrays {
+        std::vector<float> x, y, z, radiusSquared;
+        std::vector<uint32_t> light;
+
+        size_t size() const { return light.size(); }
+        void clear();
+        void push(float, float, float, float, uint32_t);
+        // Pad the components to whole groups of four with lights no box can reach, push only before padding
+        void pad();
+    };
+    // work of one depth slice
+    struct Slice {
+        // lights reaching into the slice's depth range, and those of them touching the current row of tiles
+        LightArrays lights;
+        LightArrays row;
+        // positions in a LightArrays that touched the last box tested
+        std::vector<uint32_t> hits;
+        // lights of the slice's clusters, one cluster after the other, and how many each has
+        std::vector<uint32_t> indices;
+        std::vector<uint32_t> counts;
+    };
+
+    unsigned int tilesX, tilesY, slices;
+    // projection the boxes were computed for, its near and far plane distance
+    glm::mat4 boxProjection = glm::mat4(0.0f);
+    float nearPlane = 0.0f, farPlane = 0.0f;
+    glm::vec2 viewportSize = glm::vec2(0.0f);
+    std::vector<Box> boxes;
+    std::vector<float> sliceDepths;
+    std::vector<Slice> sliceWork;
+    // view space position and radius of the lights of the last build
+    std::vector<glm::vec4> viewLights;
+    std::vector<ClusterRange> ranges;
+    std::vector<uint32_t> indices;
+
+    // Recompute the cluster boxes when the projection changed, move the lights into view space
+    void prepare(const RenderView&, glm::vec2, const std::vector<PointLight>&);
+    // Gather the lights of a depth slice and test them against its clusters, with SSE or one at a time
+    void assignSlice(unsigned int, bool);
+    // Append the positions of the lights whose spheres touch a box to hits (box, lights, SSE or one at a time, hits)
+    static void touching(const Box&, const LightArrays&, bool, std::vector<uint32_t>&);
+    // Concatenate the slices' lists into the cluster ranges and index list
+    void merge();
+};
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Read-only view of a whole file mapped into the address space
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Map the file at the given path, returns false if it doesn't exist or can't be mapped
+    bool open(const std::string&);
+    void close();
+
+    const unsigned char* data() const { return bytes; }
+    size_t size() const { return length; }
+    bool isOpen() const { return bytes != nullptr; }
+private:
+    const unsigned char* bytes = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#endif
+};
+
+// 64-bit FNV-1a hash of a byte range
+uint64_t hashBytes(const void*, size_t, uint64_t = 14695981039346656037ull);
+// Hash of a file's contents, returns false if the file couldn't be read
+bool hashFile(const std::string&, uint64_t&, uint64_t* = nullptr);
@@ -0,0 +1,36 @@
+#pragma once
+#include <shader.hpp>
+#include <texture.hpp>
+
+#include <vector>
+
+// The textures a mesh is drawn with. Which sampler uniform each texture goes to is worked out once per shader
+// the material is used with, applying it afterwards only binds textures and sets integers
+class Material {
+public:
+    // textures in texture unit order
+    std::vector<Texture> textures;
+    // small number unique to the material, the render queue sorts by it
+    const unsigned int id;
+    // alpha the diffuse texture is multiplied with, imported from the source material
+    const float opacity;
+    // blended over what's behind it, drawn after everything opaque from back to front
+    const bool transparent;
+
+    // Textures and opacity, a material with an opacity below 1 is transparent
+    explicit Material(std::vector<Texture>, float = 1.0f);
+    // Bind the textures to their units, point the shader's samplers at them and set its opacity, the shader has to
+    // be in use
+    void apply(const Shader&);
+private:
+    // sampler of every texture and the opacity uniform in one shader
+    struct Binding {
+        unsigned int program;
+        std::vector<UniformHandle<int>> samplers;
+        UniformHandle<float> opacity;
+    };
+    // a material only ever meets a handful of shaders, a short list beats a map
+    std::vector<Binding> bindings;
+
+    const Binding& binding(const Shader&);
+};
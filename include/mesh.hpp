@@ -1,23 +1,107 @@
 #pragma once
 #include <shader.hpp>
+#include <geometry_arena.hpp>
+#include <material.hpp>
+#include <meshlet.hpp>
 #include <vertex.hpp>
 #include <texture.hpp>
 
+#include <memory>
 #include <vector>
 
+// Most levels of detail a mesh keeps, including the full resolution one
+#define MAX_MESH_LODS 4
+
+// One level of detail: a range of the mesh's index buffer drawn with the shared vertices
+struct MeshLod {
+    unsigned int indexOffset;
+    unsigned int indexCount;
+    // how far the simplified surface may be from the original one, in object space units
+    float error;
+};
+
 class Mesh {
 public:
+    // small number unique to the mesh, the render queue sorts by it
+    unsigned int id;
     // Mesh data
-    std::vector<Vertex> vertices;
-    std::vector<unsigned int> indices;
+    VertexFormat format;
+    unsigned int vertexCount;
+    // raw vertex data laid out as described by format
+    std::vector<unsigned char> vertices;
+    // bytes per index (1, 2 or 4), the smallest that can address every vertex
+    unsigned int indexSize;
+    // raw index buffers of all levels of detail, one after the other
+    std::vector<unsigned char> indices;
+    // level 0 is the full resolution mesh, each following one is coarser
+    std::vector<MeshLod> lods;
+    // clusters covering the full resolution level, empty when the mesh wasn't split
+    std::vector<Meshlet> meshlets;
     std::vector<Texture> textures;
-    unsigned int VAO;
+    // alpha of the source material, below 1 the mesh is drawn blended
+    float opacity = 1.0f;
+    // what the textures are drawn with, meshes with the same textures and opacity can share one
+    std::shared_ptr<Material> material;
+    // offset (xy) and scale (zw) restoring the unorm16 texture coordinates of packed formats
+    glm::vec4 uvTransform;
+    // bounding sphere and axis aligned box (center and half size) in object space, both around the same center
+    glm::vec3 boundsCenter;
+    float boundsRadius;
+    glm::vec3 boundsExtent;
+    // VAO of the arena the mesh lives in, shared with every other mesh of the same format there
+    unsigned int VAO = 0;
 
+    // Constructors only take the data, GL objects are created by setupMesh
     Mesh(std::vector<Vertex>, std::vector<unsigned int>, std::vector<Texture>);
-    void Draw(Shader&);
+    // Construct from vertex and index data already in their final layout (e.g. packed on import or a mapped mesh cache):
+    // vertex format, vertices, vertex count, texture coordinate transform, index size, indices, index count, textures
+    Mesh(VertexFormat, const unsigned char*, size_t, glm::vec4, unsigned int, const unsigned char*, size_t, std::vector<Texture>);
+    unsigned int indexCount() const { return static_cast<unsigned int>(indices.size() / indexSize); }
+    // Index i of the index buffer, whatever its size
+    unsigned int index(size_t) const;
+    // Object space position of vertex i, whatever the format
+    glm::vec3 position(size_t) const;
+    // Draw the given level of detail
+    void Draw(Shader&, unsigned int = 0);
+    // Draw the full resolution level without the meshlets that are outside the frustum or face away from the camera,
+    // both given in object space. Dropping the ones facing away assumes GL_CULL_FACE culls back faces
+    void DrawMeshlets(Shader&, const Frustum&, glm::vec3);
+    // Append the index ranges of the meshlets DrawMeshlets would draw to the given counts, offsets and base vertices,
+    // returns how many ranges were appended
+    size_t cullMeshlets(const Frustum&, glm::vec3, std::vector<GLsizei>&, std::vector<const void*>&, std::vector<GLint>&) const;
+    // Bind the MeshConstants that tell the shader how to decode the vertices, written once per UniformRing epoch
+    void applyVertexDecoding();
+    // Draw calls without any material or uniform changes, for callers that already applied them:
+    // a level of detail, or index ranges (counts, offsets, base vertices, range count) from cullMeshlets
+    void DrawLevel(unsigned int);
+    void DrawRanges(const GLsizei*, const void* const*, const GLint*, GLsizei);
+    // Draw a level of detail once per instance (level, instance count), the instance attributes have to be bound
+    void DrawLevelInstanced(unsigned int, GLsizei);
+    // Coarsest level of detail whose error stays below one pixel at the given number of pixels per object space unit
+    unsigned int selectLod(float) const;
+    // Copy the vertex and index data into an arena, must run on the GL thread
+    void setupMesh(GeometryArena&);
+    // Give the arena space back, must run on the GL thread
+    void releaseGeometry();
+    bool isResident() const { return VAO != 0; }
+    // Where the vertex and index data live in the arena
+    const GeometryAllocation& allocation() const { return geometry; }
 private:
     // Render data
-    unsigned int VBO, EBO;
+    GeometryArena* arena = nullptr;
+    GeometryAllocation geometry;
+    // index ranges of the visible meshlets, kept around so culling doesn't allocate every frame
+    std::vector<GLsizei> drawCounts;
+    std::vector<const void*> drawOffsets;
+    std::vector<GLint> drawBaseVertices;
+
+    // where this epoch's MeshConstants were written in the uniform ring
+    unsigned long long decodeEpoch = 0;
+    size_t decodeOffset = 0;
+
+    // Apply the material and bind the vertex decoding constants
+    void bindMaterial(Shader&);
 
-    void setupMesh();
-};
\ No newline at end of file
+    // Bounding sphere of the vertex data
+    void computeBounds();
+};
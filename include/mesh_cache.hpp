@@ -0,0 +1,46 @@
+#pragma once
+#include <mapped_file.hpp>
+#include <mesh.hpp>
+
+#include <string>
+#include <vector>
+
+// Bump whenever the on-disk layout or the meaning of its contents changes
+#define MESH_CACHE_VERSION 7
+
+// A mesh stored in the cache, vertex and index data point straight into the mapped file
+struct CachedMesh {
+    VertexFormat format;
+    const unsigned char* vertices;
+    unsigned int vertexCount;
+    glm::vec4 uvTransform;
+    // bytes per index
+    unsigned int indexSize;
+    const unsigned char* indices;
+    unsigned int indexCount;
+    std::vector<MeshLod> lods;
+    std::vector<Meshlet> meshlets;
+    std::vector<Texture> textures;
+    float opacity;
+};
+
+// Binary cache of imported meshes stored next to their source asset (<source>.meshcache).
+// A cache is only used when it was written by the same version from the same source contents
+// with the same import flags and model options, otherwise the source has to be imported again.
+// Other files the importer read, like the material libraries of an .obj, are part of the key too:
+// the cache goes stale when one of them changes, appears or disappears.
+class MeshCache {
+public:
+    // Path of the cache file belonging to a source asset
+    static std::string cachePath(const std::string&);
+    // Write the meshes imported from a source asset (source, import flags, option flags, other files the importer
+    // looked for, meshes), returns false on failure
+    static bool write(const std::string&, unsigned int, unsigned int, const std::vector<std::string>&, const std::vector<Mesh>&);
+
+    // Map and validate the cache of a source asset, returns false on a miss
+    bool load(const std::string&, unsigned int, unsigned int);
+    const std::vector<CachedMesh>& meshes() const { return entries; }
+private:
+    MappedFile file;
+    std::vector<CachedMesh> entries;
+};
@@ -0,0 +1,27 @@
+#pragma once
+#include <vertex.hpp>
+
+#include <vector>
+
+// Import time index/vertex reordering passes. They only work on CPU side data and don't need a GL context.
+
+// Result of running an index buffer through a simulated FIFO post-transform cache
+struct VertexCacheStats {
+    unsigned int transformed = 0;
+    // average cache miss ratio: transformed vertices per triangle (0.5 is ideal on a regular grid, 3 is the worst case)
+    float acmr = 0.0f;
+    // average transform to vertex ratio: transformed vertices per vertex (1 is ideal)
+    float atvr = 0.0f;
+};
+
+// Default size of the simulated post-transform cache
+#define VERTEX_CACHE_SIZE 16
+
+VertexCacheStats analyzeVertexCache(const std::vector<unsigned int>&, size_t, unsigned int = VERTEX_CACHE_SIZE);
+// Reorder triangles for post-transform cache hits (Forsyth's linear speed vertex cache optimisation)
+void optimizeVertexCache(std::vector<unsigned int>&, size_t);
+// Reorder clusters of cache optimized triangles so that triangles facing outwards are drawn first, which lowers
+// overdraw. The threshold limits how much the ACMR may grow (1.05 allows 5% more vertex transforms)
+void optimizeOverdraw(std::vector<unsigned int>&, const std::vector<Vertex>&, float = 1.05f);
+// Reorder vertices into the order the index buffer first uses them and remap the indices. Unused vertices are dropped
+void optimizeVertexFetch(std::vector<Vertex>&, std::vector<unsigned int>&);
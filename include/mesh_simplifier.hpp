@@ -0,0 +1,16 @@
+#pragma once
+#include <vertex.hpp>
+
+#include <vector>
+
+// Import time mesh simplification. Works on CPU side data only and doesn't need a GL context.
+
+// Simplify a triangle list with quadric error metric edge collapses until it has at most the target number of
+// indices or the next collapse would move the surface further than the target error. Collapses always move a vertex
+// onto one of its neighbours, so the result indexes the same vertex buffer as the input. Vertices on texture seams
+// and other attribute discontinuities stay in place, open borders only collapse along themselves.
+// Both errors are relative to the size of the mesh (0.01 = 1% of its bounding box diagonal); the error actually
+// reached is written to the last argument when it's given.
+std::vector<unsigned int> simplifyMesh(const std::vector<unsigned int>&, const std::vector<Vertex>&, size_t, float, float* = nullptr);
+// Bounding box diagonal of the mesh, turns the relative errors of simplifyMesh into object space distances
+float meshExtent(const std::vector<Vertex>&);
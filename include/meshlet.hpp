@@ -0,0 +1,31 @@
+#pragma once
+#include <frustum.hpp>
+#include <vertex.hpp>
+
+#include <vector>
+
+// Limits of one meshlet, small enough that culling it is much cheaper than drawing it
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+// A cluster of nearby triangles that forms a contiguous range of its mesh's index buffer
+struct Meshlet {
+    unsigned int indexOffset;
+    unsigned int indexCount;
+    // bounding sphere in object space
+    glm::vec3 center;
+    float radius;
+    // normal cone: the cluster faces away from every camera position p with
+    // dot(normalize(coneApex - p), coneAxis) >= coneCutoff. A cutoff above 1 means it can't be backface culled
+    glm::vec3 coneApex;
+    glm::vec3 coneAxis;
+    float coneCutoff;
+};
+
+// Reorder the triangles of indices[offset, offset + count) into meshlets of at most MESHLET_MAX_VERTICES
+// vertices and MESHLET_MAX_TRIANGLES triangles, grown from neighbouring triangles. CPU only, no GL context needed
+std::vector<Meshlet> buildMeshlets(std::vector<unsigned int>&, size_t, size_t, const std::vector<Vertex>&);
+// Whether a meshlet lies completely outside the frustum, both in object space
+bool meshletOutside(const Meshlet&, const Frustum&);
+// Whether every triangle of a meshlet faces away from a camera at the given object space position
+bool meshletBackfacing(const Meshlet&, glm::vec3);
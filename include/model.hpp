@@ -1,10 +1,47 @@
 #pragma once
 #include <shader.hpp>
+#include <bvh.hpp>
 #include <mesh.hpp>
+#include <render_queue.hpp>
+#include <render_view.hpp>
+#include <texture_cache.hpp>
+#include <upload_queue.hpp>
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+
+enum class ModelState {
+    Loading,    // importing and decoding on a worker thread
+    Uploading,  // CPU data is ready, GL objects are being created on the render thread
+    Resident,   // everything is on the GPU
+    Failed
+};
+
+// Import time processing applied to the meshes of a model
+struct ModelOptions {
+    // store vertices in the smallest packed layout that keeps their precision
+    bool compactVertices = true;
+    // reorder triangles and vertices for the post-transform cache, overdraw and vertex fetch
+    bool optimizeMeshes = true;
+    // simplify meshes into coarser levels of detail for drawing them far away
+    bool generateLods = true;
+    // split the full resolution meshes into meshlets that are culled one by one
+    bool buildMeshlets = true;
+
+    // suballocate vertex and index data from GeometryArena::shared() instead of an arena of the model's own.
+    // Doesn't change the imported data, so it isn't part of the cache key
+    bool sharedGeometry = true;
+
+    // bits identifying the options, part of the mesh cache key
+    unsigned int flags() const {
+        return (compactVertices ? 1u : 0u) | (optimizeMeshes ? 2u : 0u) | (generateLods ? 4u : 0u) | (buildMeshlets ? 8u : 0u);
+    }
+};
+
 class Model {
 public:
     // Model data
@@ -12,14 +49,66 @@ public:
     std::vector<Mesh> meshes;
     std::string directory;
     bool gammaCorrection;
+    ModelOptions options;
 
-    Model(std::string const& path, bool gamma = false) : gammaCorrection(gamma) {
+    // Load the model right away, blocks until it's resident
+    Model(std::string const& path, bool gamma = false, ModelOptions options = ModelOptions()) : gammaCorrection(gamma), options(options), loadState(ModelState::Loading) {
         loadModel(path);
     }
-    void Draw(Shader&);
+    // Start loading a model in the background and return immediately. Import and texture decoding run
+    // on the shared thread pool, buffer and texture creation is queued on the given upload queue
+    static std::shared_ptr<Model> LoadAsync(std::string const& path, UploadQueue uploads, bool gamma = false, ModelOptions options = ModelOptions());
+    // Releases the model's references on its textures, must run on the GL thread
+    ~Model();
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
+
+    // Queues the meshes that are resident into RenderQueue::shared() with the given model matrix, a model that is still
+    // loading draws nothing. They're drawn, merged into instanced batches with the other draws of the same mesh, when
+    // the queue is flushed
+    void Draw(Shader&, const glm::mat4&);
+    // Same but with the given model matrix, skips meshes and meshlets outside the view frustum and queues every mesh
+    // at the level of detail its size on screen needs
+    void Draw(Shader&, const RenderView&, const glm::mat4&);
+    // Same culling and level of detail selection, but the meshes go into a render queue that draws them later
+    void Submit(RenderQueue&, Shader&, const RenderView&, const glm::mat4&);
+    // Draws the model once per transform (view, transforms, count) at the given level of detail, one draw call per mesh
+    // however many instances there are. Nothing is culled, every instance is drawn
+    void DrawInstanced(Shader&, const RenderView&, const glm::mat4*, size_t, unsigned int = 0);
+    // Object space box around all meshes, empty (min above max) while the model is still loading
+    Aabb Bounds() const;
+    ModelState state() const { return loadState.load(std::memory_order_acquire); }
+    bool isResident() const { return state() == ModelState::Resident; }
 private:
+    std::atomic<ModelState> loadState;
+    // unique textures of the model: index by path and their texture cache entries
+    std::unordered_map<std::string, size_t> textureIndex;
+    std::vector<TextureCache::Handle> textureHandles;
+    TextureLoadStats textureStats;
+    // model view projection or normal matrices of the instances being drawn, whichever the shader reads
+    std::vector<glm::mat4> instanceMatrices;
+    std::vector<NormalMatrix> instanceNormals;
+    // world space bounds of the meshes and which of them are in view, rebuilt for every draw
+    BoundsArrays meshBounds;
+    std::vector<unsigned char> meshVisible;
+    // buffers of a model that doesn't use the shared arena
+    std::unique_ptr<GeometryArena> ownGeometry;
+
+    // Empty model filled in by LoadAsync
+    struct Deferred {};
+    Model(Deferred, bool gamma, ModelOptions options) : gammaCorrection(gamma), options(options), loadState(ModelState::Loading) {}
     void loadModel(std::string const&);
+    // CPU side of loading, safe to run on any thread
+    bool importModel(std::string const&);
     void processNode(aiNode*, const aiScene*);
     Mesh processMesh(aiMesh*, const aiScene*);
     std::vector<Texture> loadMaterialTextures(aiMaterial*, aiTextureType, std::string);
-};
\ No newline at end of file
+    Texture loadTexture(const std::string&, const std::string&);
+    void decodeTextures();
+    // GL side of loading, must run on the render thread
+    GeometryArena& geometryArena();
+    void uploadTexture(size_t);
+    void resolveTextures();
+    // Fill meshVisible for a model matrix (view, model matrix, its largest axis scale), non resident meshes count as culled
+    void cullMeshes(const RenderView&, const glm::mat4&, float);
+};
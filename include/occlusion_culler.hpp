@@ -0,0 +1,80 @@
+#pragma once
+#include <bvh.hpp>
+#include <mesh.hpp>
+#include <thread_pool.hpp>
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Software occlusion culling: a few occluder meshes (coarse levels of detail are plenty) are rasterized on the CPU into
+// a small depth buffer, then the screen space bounds of other objects are tested against it before they're submitted.
+// The buffer is split into 8x8 pixel tiles, each keeping its farthest depth, and those into 4x4 tile blocks doing the
+// same, so most tests are decided by a handful of block or tile depths without looking at pixels.
+// Rasterizing runs on a thread pool, one row of tiles per task, with SSE doing four pixels at a time where available.
+// Nothing here touches GL, the whole thing runs and can be checked without a GPU.
+class OcclusionCuller {
+public:
+    // Depth buffer size (width, height), rounded up to whole tile blocks
+    OcclusionCuller(unsigned int = 320, unsigned int = 192);
+
+    // Start a frame seen through a projection * view matrix, drops the last frame's occluders
+    void beginFrame(const glm::mat4&);
+    // Add an occluder: mesh, model matrix, level of detail. The mesh has to stay alive until rasterize
+    void addOccluder(const Mesh&, const glm::mat4&, unsigned int);
+    // Add an occluder from plain data: object space positions, vertex count, triangle indices, index count, model
+    // matrix. The arrays have to stay alive until rasterize
+    void addOccluder(const glm::vec3*, size_t, const uint32_t*, size_t, const glm::mat4&);
+    // Transform and rasterize the occluders on the pool, then build the tile depths
+    void rasterize(ThreadPool&);
+
+    // Whether a world space box is hidden behind the occluders. Boxes reaching behind the near plane or outside the
+    // screen are never hidden, the frustum culls those
+    bool isOccluded(const Aabb&) const;
+    // Same for many boxes on the pool, 1 where a box is hidden
+    void testBoxes(const std::vector<Aabb>&, std::vector<unsigned char>&, ThreadPool&) const;
+
+    unsigned int width() const { return bufferWidth; }
+    unsigned int height() const { return bufferHeight; }
+    // Depth of every pixel in [0, 1], rows from the bottom of the screen, 1 where no occluder was drawn
+    const std::vector<float>& depth() const { return pixels; }
+    // Occluder triangles that survived near plane clipping and back face culling in the last rasterize
+    size_t triangleCount() const;
+private:
+    struct Occluder {
+        // either a mesh level of detail or plain arrays
+        const Mesh* mesh;
+        unsigned int lod;
+        const glm::vec3* positions;
+        size_t vertexCount;
+        const uint32_t* indices;
+        size_t indexCount;
+        glm::mat4 transform;
+    };
+    // triangle ready to rasterize: edge functions (x and y factors around a point on the edge) and depth as a plane
+    // over pixel coordinates, and the pixel rows and columns its bounds touch
+    struct ScreenTriangle {
+        float edgeA[3], edgeB[3], edgeX[3], edgeY[3];
+        float depthA, depthB, depthC;
+        int minX, maxX, minY, maxY;
+    };
+
+    unsigned int bufferWidth, bufferHeight;
+    unsigned int tilesX, tilesY;
+    glm::mat4 viewProjection;
+    std::vector<Occluder> occluders;
+    // set up triangles of every occluder, filled in parallel
+    std::vector<std::vector<ScreenTriangle>> triangles;
+    // per occluder scratch of clip space vertices
+    std::vector<std::vector<glm::vec4>> clipVertices;
+    std::vector<float> pixels;
+    // farthest depth of every tile and of every block of tiles
+    std::vector<float> tileDepth;
+    std::vector<float> blockDepth;
+
+    // clip, cull and set up the triangles of one occluder
+    void setupOccluder(size_t);
+    void addTriangle(std::vector<ScreenTriangle>&, const glm::vec4&, const glm::vec4&, const glm::vec4&) const;
+    // rasterize every triangle into one row of tiles and compute its tile depths
+    void rasterizeTileRow(unsigned int);
+};
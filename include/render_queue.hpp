@@ -0,0 +1,78 @@
+#pragma once
+#include <shader.hpp>
+#include <mesh.hpp>
+#include <frustum.hpp>
+#include <indirect_renderer.hpp>
+#include <render_view.hpp>
+#include <transform_batch.hpp>
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+// One mesh to draw, with everything needed to sort and submit it
+struct DrawItem {
+    Mesh* mesh;
+    Material* material;
+    Shader* shader;
+    glm::mat4 transform;
+    // view space depth of the mesh's bounds center
+    float depth;
+    unsigned int lod;
+    // visible meshlet ranges in the queue's range arrays, no ranges means the whole level of detail is drawn
+    unsigned int firstRange;
+    unsigned int rangeCount;
+};
+
+// Draws of a frame collected from all models and submitted in an order that changes as little state as possible.
+// Every item gets a 64 bit key: opaque items sort by program, VAO, material, mesh and then front to back, transparent ones
+// come after them from back to front. The keys are radix sorted, so sorting stays linear in the number of items.
+// Consecutive opaque draws of the same mesh level, material and shader are merged into one instanced draw, their
+// model and normal matrices are streamed through the shared InstanceBuffer.
+// The storage is kept between frames, a queue that has seen its largest frame doesn't allocate anymore.
+class RenderQueue {
+public:
+    // Add a mesh drawn at a level of detail: shader, mesh, model matrix, view space depth, level of detail
+    void push(Shader&, Mesh&, const glm::mat4&, float, unsigned int);
+    // Add the full resolution level without the meshlets that fail culling against the object space frustum and
+    // camera position. Nothing is added when every meshlet was culled
+    void pushMeshlets(Shader&, Mesh&, const glm::mat4&, float, const Frustum&, glm::vec3);
+    // Sort and draw everything seen through a view, then empty the queue for the next frame. Must run on the GL thread
+    void flush(const RenderView&);
+    // Same, but the opaque items are drawn by a multi-draw indirect renderer with its own shader
+    void flush(IndirectRenderer&, const RenderView&);
+    size_t size() const { return items.size(); }
+
+    // Queue Model::Draw adds to, whoever owns the frame flushes it before the frame ends
+    static RenderQueue& shared();
+private:
+    struct SortEntry {
+        uint64_t key;
+        uint32_t item;
+    };
+    std::vector<DrawItem> items;
+    std::vector<SortEntry> entries;
+    std::vector<SortEntry> sortScratch;
+    // index ranges of all meshlet items, in the layout glMultiDrawElementsBaseVertex takes
+    std::vector<GLsizei> rangeCounts;
+    std::vector<const void*> rangeOffsets;
+    std::vector<GLint> rangeBaseVertices;
+    // model matrices of the entries being drawn and their model view projection and normal matrices, computed for
+    // all of them at once. A batch's instance data is a slice of the model and normal matrices
+    std::vector<glm::mat4> drawTransforms;
+    std::vector<glm::mat4> drawMatrices;
+    std::vector<NormalMatrix> drawNormals;
+
+    static uint64_t sortKey(const DrawItem&);
+    // whether an item can be part of an instanced batch, and whether another item can join its batch
+    static bool batchable(const DrawItem&);
+    static bool sameBatch(const DrawItem&, const DrawItem&);
+    // build the keys and sort them
+    void sortItems();
+    // sort entries by key, least significant byte first, skipping bytes every key has in common
+    void sortEntries();
+    // draw a range of the sorted entries one by one or in instanced batches (first, end, view projection matrix)
+    void drawEntries(size_t, size_t, const glm::mat4&);
+    // empty the queue, keeping the storage
+    void reset();
+};
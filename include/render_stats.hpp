@@ -0,0 +1,49 @@
+#pragma once
+
+// Renderer counters gathered per frame, averaged and printed once per reporting interval
+class RenderStats {
+public:
+    struct Counters {
+        unsigned long long drawCalls = 0;
+        unsigned long long triangles = 0;
+        // meshes tested against the view frustum and how many of them were culled
+        unsigned long long meshes = 0;
+        unsigned long long meshesCulled = 0;
+        // meshlets tested for visibility and how many of them were culled
+        unsigned long long clusters = 0;
+        unsigned long long clustersCulled = 0;
+        // objects tested against the software occlusion buffer and how many of them were hidden
+        unsigned long long occlusionTests = 0;
+        unsigned long long occlusionCulled = 0;
+        // point lights assigned to clusters and the light cluster pairs that came out of it
+        unsigned long long lights = 0;
+        unsigned long long lightAssignments = 0;
+        // state changes between the draws of the render queue
+        unsigned long long programSwitches = 0;
+        unsigned long long textureSwitches = 0;
+        unsigned long long vertexArraySwitches = 0;
+        // instanced draws the render queue merged queued draws into, and how many draws went into them
+        unsigned long long batches = 0;
+        unsigned long long batchedDraws = 0;
+        // binds that went to the driver and binds GLState skipped because they changed nothing
+        unsigned long long stateCalls = 0;
+        unsigned long long stateCallsElided = 0;
+        // CPU time spent issuing the frame's draws
+        unsigned long long submitNanoseconds = 0;
+        // heap allocations made on any thread between beginFrame and endFrame
+        unsigned long long allocations = 0;
+    };
+    // counters of the frame being rendered
+    Counters frame;
+
+    static RenderStats& current();
+    // Start counting a new frame
+    void beginFrame();
+    // Finish the frame that took the given time in seconds, prints the averages once per interval
+    void endFrame(double);
+private:
+    Counters totals;
+    double elapsed = 0.0;
+    unsigned int frames = 0;
+    unsigned long long frameStartAllocations = 0;
+};
@@ -0,0 +1,21 @@
+#pragma once
+#include <frustum.hpp>
+#include <glm/glm.hpp>
+
+#include <cmath>
+
+// Camera parameters a frame is rendered with, used to decide how much detail objects need
+struct RenderView {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec3 cameraPosition;
+    // vertical field of view in radians
+    float fovY;
+    // height of the viewport in pixels
+    float viewportHeight;
+    // world space planes of projection * view
+    Frustum frustum;
+
+    // Pixels one world space unit covers at the given distance from the camera
+    float pixelsPerUnit(float distance) const { return viewportHeight / (2.0f * std::tan(fovY * 0.5f) * distance); }
+};
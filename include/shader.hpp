@@ -2,25 +2,87 @@
 
 #include <glad/glad.h>
 #include <string>
+#include <unordered_map>
 #include <glm/glm.hpp>
 
+// Location of a uniform resolved once and kept by the caller. The type ties it to the matching Shader::set overload,
+// an invalid handle (unknown name or wrong type) is ignored when set, like location -1 in GL
+template<typename T>
+struct UniformHandle {
+    GLint location = -1;
+    bool valid() const { return location >= 0; }
+};
+
+class Shader;
+
+// Handle for code that draws with whatever shader it's given: resolved again whenever the shader changes
+template<typename T>
+struct CachedUniform {
+    const char* name;
+    unsigned int program = 0;
+    UniformHandle<T> handle;
+
+    explicit CachedUniform(const char* name) : name(name) {}
+    UniformHandle<T> get(const Shader&);
+};
+
 // Shader class
 class Shader {
 public:
     // The program ID
     unsigned int ID;
+    // The vertex shader reads aInstanceModelViewProjection instead of aInstanceModel: instances bring the matrix
+    // that takes them straight to clip space
+    bool instancesInClipSpace = false;
 
-    // Constructor reads and builds the shader
-    Shader(const char*, const char*);
+    // Constructor reads and builds the shader (vertex path, fragment path, optional path of GLSL code shared between
+    // fragment shaders, inserted right after the fragment source's #version line)
+    Shader(const char*, const char*, const char* = nullptr);
     // Destructor
     ~Shader();
     // Use/activate the shader
     void use();
-    // Utility uniform functions
+    // Look up a uniform in the table filled at link time, no GL query. Returns -1 for names that aren't active
+    GLint location(const std::string&) const;
+    // Resolve a uniform for repeated use, the type has to match its declaration in the shader
+    template<typename T>
+    UniformHandle<T> uniform(const std::string&) const;
+    // Typed setters for resolved handles, no string work or location lookups. The shader has to be in use
+    void set(UniformHandle<bool>, bool) const;
+    void set(UniformHandle<int>, int) const;
+    void set(UniformHandle<float>, float) const;
+    void set(UniformHandle<glm::vec3>, glm::vec3) const;
+    void set(UniformHandle<glm::vec4>, glm::vec4) const;
+    void set(UniformHandle<glm::mat4>, const glm::mat4&) const;
+    // Utility uniform functions, they look the name up in the uniform table on every call
     void setBool(const std::string&, bool) const;
     void setInt(const std::string&, int) const;
     void setFloat(const std::string&, float) const;
     void setVec3(const std::string&, float, float, float) const;
     void setVec3(const std::string&, glm::vec3) const;
+    void setVec4(const std::string&, glm::vec4) const;
     void setMat4(const std::string&, glm::mat4) const;
-};
\ No newline at end of file
+private:
+    struct UniformInfo {
+        GLint location;
+        GLenum type;
+    };
+    // active uniforms of the linked program by name
+    std::unordered_map<std::string, UniformInfo> uniforms;
+
+    // Fill the uniform table from the linked program
+    void reflectUniforms();
+    // Point the program's uniform blocks at the binding points UniformRing fills
+    void bindUniformBlocks();
+    // Whether a uniform declared with the GL type can be set through a handle of the type
+    static bool compatibleType(GLenum, GLenum);
+};
+
+template<typename T>
+UniformHandle<T> CachedUniform<T>::get(const Shader& shader) {
+    if (program != shader.ID) {
+        program = shader.ID;
+        handle = shader.uniform<T>(name);
+    }
+    return handle;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <texture_loader.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Process wide cache of GL textures. Files are keyed by canonical path and by a hash of their contents,
+// so the same image costs one decode and one texture object no matter how many models use it or under
+// how many paths it's stored. A matching hash is confirmed by comparing the files byte for byte, different
+// images that collide each keep their own entry. Textures are reference counted and deleted once the last
+// user releases them.
+class TextureCache {
+public:
+    struct Entry {
+        std::string path;
+        uint64_t contentHash = 0;
+        uint64_t contentSize = 0;
+        std::mutex mutex;
+        DecodedImage image;
+        unsigned int id = 0;
+        unsigned int references = 0;
+    };
+    using Handle = std::shared_ptr<Entry>;
+
+    static TextureCache& instance();
+
+    // Find the entry for an image file, registering it on first sight. Thread safe
+    Handle lookup(const std::string&);
+    // Decode the pixels of an entry unless it already has them or its texture exists, returns true if
+    // this call did the decoding. Thread safe
+    bool decode(const Handle&);
+    // Take a reference on the texture of an entry, uploading its pixels first if needed. GL thread only
+    unsigned int acquire(const Handle&);
+    // Drop a reference taken by acquire, deletes the texture when it was the last one. GL thread only
+    void release(unsigned int);
+    // Number of distinct images known to the cache
+    size_t size() const;
+private:
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, Handle> byPath;
+    // several entries per hash when different files collide
+    std::unordered_multimap<uint64_t, Handle> byContent;
+    std::unordered_map<unsigned int, Handle> byTexture;
+
+    TextureCache() = default;
+};
@@ -0,0 +1,30 @@
+#pragma once
+#include <string>
+#include <cstddef>
+
+// Pixels decoded on the CPU, waiting to be uploaded
+struct DecodedImage {
+    unsigned char* pixels = nullptr;
+    int width = 0;
+    int height = 0;
+    int components = 0;
+};
+
+// Timings of a batch of textures going through decoding and uploading
+struct TextureLoadStats {
+    // textures requested and how many of them actually had to be decoded
+    size_t count = 0;
+    size_t decoded = 0;
+    unsigned int threads = 0;
+    // wall clock time of the parallel decode and the sum of every single decode
+    double decodeMs = 0.0;
+    double decodeCpuMs = 0.0;
+    double uploadMs = 0.0;
+};
+
+// Decode an image file, safe to call from any thread
+DecodedImage decodeImage(const std::string&);
+// Release the pixels of a decoded image
+void freeImage(DecodedImage&);
+// Create a mipmapped texture from decoded pixels, must run on the GL thread. Returns 0 on failure
+unsigned int uploadTexture(const DecodedImage&);
@@ -0,0 +1,45 @@
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads pulling tasks from a shared queue
+class ThreadPool {
+public:
+    // Start the given number of workers, 0 picks one per hardware thread
+    explicit ThreadPool(unsigned int = 0);
+    // Finish the queued tasks and join the workers
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Queue a task, the returned future holds its result
+    template<typename F>
+    auto submit(F&& task) -> std::future<decltype(task())> {
+        using Result = decltype(task());
+        auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+        std::future<Result> result = packaged->get_future();
+        enqueue([packaged]() { (*packaged)(); });
+        return result;
+    }
+    // Run body(i) for every i in [0, count) on the workers and the calling thread, returns once all are done
+    void parallelFor(size_t, const std::function<void(size_t)>&);
+
+    unsigned int size() const { return static_cast<unsigned int>(workers.size()); }
+    // Process wide pool shared by the asset loaders
+    static ThreadPool& shared();
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping = false;
+
+    void enqueue(std::function<void()>);
+    void workerLoop();
+};
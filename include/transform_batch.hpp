@@ -0,0 +1,21 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+// mat3 in std140 and std430 layout: three columns, each padded to a vec4
+struct NormalMatrix {
+    glm::vec4 columns[3];
+};
+
+// Matrices the vertex shaders used to derive from the model matrix for every vertex, computed once per object on
+// the CPU for whole arrays of objects. Model view projection products take one object per iteration, AVX doing two
+// columns at a time and SSE one. Normal matrices take four objects per iteration with SSE, each lane one object.
+// Without SSE both fall back to one object at a time in plain C++
+// Model view projection matrices: view projection matrix, model matrices, count, output
+void modelViewProjections(const glm::mat4&, const glm::mat4*, size_t, glm::mat4*);
+// Inverse transpose of the upper 3x3 of every model matrix: model matrices, count, output
+void normalMatrices(const glm::mat4*, size_t, NormalMatrix*);
+// One object at a time with glm, the way the shaders did it. What the SIMD versions have to agree with
+void modelViewProjectionsScalar(const glm::mat4&, const glm::mat4*, size_t, glm::mat4*);
+void normalMatricesScalar(const glm::mat4*, size_t, NormalMatrix*);
@@ -0,0 +1,113 @@
+#pragma once
+#include <glad/glad.h>
+#include <render_view.hpp>
+#include <transform_batch.hpp>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+// Uniform block binding points, Shader points the blocks of every program it links at them
+#define CAMERA_BLOCK_BINDING 0
+#define DRAW_BLOCK_BINDING 1
+#define MESH_BLOCK_BINDING 2
+#define CLUSTER_BLOCK_BINDING 3
+
+// std140 layout of the Camera block, written once per frame and read by every program that needs the camera
+struct CameraConstants {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+    glm::mat4 inverseView;
+    glm::mat4 inverseProjection;
+    glm::mat4 inverseViewProjection;
+    // world space camera position, w is 1
+    glm::vec4 position;
+    // world space frustum planes, inward facing
+    glm::vec4 frustumPlanes[6];
+
+    explicit CameraConstants(const RenderView&);
+};
+
+// std140 layout of the DrawConstants block: the model matrix and the matrices the vertex shaders need from it, or
+// whether every instance brings its model and normal matrices in the instance attributes instead
+struct DrawConstants {
+    glm::mat4 model;
+    glm::mat4 modelViewProjection;
+    NormalMatrix normalMatrix;
+    GLuint instanced;
+    GLuint padding[3];
+
+    // One object (model matrix, view projection matrix), its matrices are computed here
+    DrawConstants(const glm::mat4&, const glm::mat4&);
+    // Matrices computed for many objects at once: model, model view projection, normal matrix
+    DrawConstants(const glm::mat4& model, const glm::mat4& modelViewProjection, const NormalMatrix& normalMatrix)
+        : model(model), modelViewProjection(modelViewProjection), normalMatrix(normalMatrix), instanced(0), padding{} {}
+    // Constants of an instanced draw
+    static DrawConstants instancedDraw();
+};
+
+// std140 layout of the MeshConstants block: how the vertices of a mesh are decoded
+struct MeshConstants {
+    glm::vec4 uvTransform;
+    GLuint packedVertex;
+    GLuint padding[3];
+};
+
+// Per-frame and per-draw shader constants (uniform blocks and shader storage) written one after the other into a
+// buffer split into three frame segments, each bound to its draws with glBindBufferRange. With GL 4.4 or
+// ARB_buffer_storage the buffer is created with glBufferStorage and stays mapped coherently, so writes are plain
+// copies. A fence placed at the end of a frame guards its segment, beginFrame only waits when the GPU is three frames
+// behind. Without buffer storage every write is a glBufferSubData instead.
+// A frame that writes more than a segment holds moves to a buffer twice the size, offsets written before that stay
+// valid for the draws already bound to them. All functions must run on the GL thread.
+class UniformRing {
+public:
+    UniformRing() = default;
+    ~UniformRing();
+    UniformRing(const UniformRing&) = delete;
+    UniformRing& operator=(const UniformRing&) = delete;
+
+    // Start writing into the next segment, waits for the GPU to finish the frame that used it last
+    void beginFrame();
+    // Fence the segment written since beginFrame
+    void endFrame();
+
+    // Copy data (pointer, size) behind the last write, returns the byte offset it starts at. The offset is aligned
+    // for binding as a uniform or shader storage buffer range
+    size_t write(const void*, size_t);
+    // Bind a range of the ring to an indexed binding point (target, index, offset, size)
+    void bindRange(GLenum, unsigned int, size_t, size_t);
+    // Write a block and bind it (target, binding point, value)
+    template<typename T>
+    void push(GLenum target, unsigned int index, const T& value) {
+        bindRange(target, index, write(&value, sizeof(T)), sizeof(T));
+    }
+
+    // Changes every frame and whenever the buffer is replaced, offsets written under an earlier epoch can't be bound
+    // anymore
+    unsigned long long epoch() const { return currentEpoch; }
+    // Whether the buffer is persistently mapped
+    bool persistent() const { return mapped != nullptr; }
+
+    // Ring shared by everything that draws
+    static UniformRing& shared();
+private:
+    static const unsigned int SEGMENTS = 3;
+
+    unsigned int buffer = 0;
+    unsigned char* mapped = nullptr;
+    size_t segmentSize = 0;
+    size_t alignment = 0;
+    unsigned int segment = 0;
+    // next free byte of the buffer, inside the current segment
+    size_t cursor = 0;
+    GLsync fences[SEGMENTS] = {};
+    unsigned long long currentEpoch = 0;
+    // buffers replaced during the frame, draws of this frame may still be bound to them
+    std::vector<unsigned int> retired;
+
+    // Create the buffer with segments of the given size, the current segment starts empty
+    void create(size_t);
+    void deleteFences();
+};
@@ -0,0 +1,25 @@
+#pragma once
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+// GL work produced by background loaders, executed on the render thread a little at a time.
+// Copies share the same queue, so loaders can keep a copy for as long as they run.
+class UploadQueue {
+public:
+    UploadQueue();
+
+    // Queue a task, may be called from any thread
+    void push(std::function<void()>);
+    // Run queued tasks on the calling (GL) thread until the time budget in milliseconds is used up.
+    // At least one task runs per call so progress is made even with a tiny budget. Returns the number of tasks left
+    size_t process(double);
+    size_t pending() const;
+private:
+    struct State {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+    std::shared_ptr<State> state;
+};
@@ -1,5 +1,6 @@
 #pragma once
 #include <glm/glm.hpp>
+#include <cstdint>
 
 #define MAX_BONE_INFLUENCE 4
 
@@ -18,4 +19,39 @@ struct Vertex {
 	int m_BoneIDs[MAX_BONE_INFLUENCE];
 	//weights from each bone
 	float m_Weights[MAX_BONE_INFLUENCE];
-};
\ No newline at end of file
+};
+
+// Packed vertex with a half float position: 20 bytes.
+// Position.w holds the bitangent sign, the bitangent is rebuilt as cross(normal, tangent) * sign.
+// Normal and tangent are octahedral encoded snorm16 pairs, texture coordinates are unorm16 over
+// the mesh's texture coordinate range (see Mesh::uvTransform)
+struct PackedVertexHalf {
+    uint16_t Position[4];
+    int16_t Normal[2];
+    int16_t Tangent[2];
+    uint16_t TexCoords[2];
+};
+
+// Same as PackedVertexHalf but keeps full float positions for meshes half floats can't represent: 28 bytes
+struct PackedVertexFloat {
+    float Position[4];
+    int16_t Normal[2];
+    int16_t Tangent[2];
+    uint16_t TexCoords[2];
+};
+
+// Appended to packed vertices of skinned meshes only: 8 bytes
+struct PackedSkin {
+    uint8_t BoneIDs[MAX_BONE_INFLUENCE];
+    // unorm8 weights
+    uint8_t Weights[MAX_BONE_INFLUENCE];
+};
+
+// Layout of the vertex data a mesh keeps on the GPU
+enum class VertexFormat : uint32_t {
+    Full,
+    PackedHalf,
+    PackedFloat,
+    PackedHalfSkinned,
+    PackedFloatSkinned
+};
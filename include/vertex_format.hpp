@@ -0,0 +1,28 @@
+#pragma once
+#include <vertex.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Size in bytes of one vertex in the given format
+unsigned int vertexStride(VertexFormat);
+bool isPackedFormat(VertexFormat);
+bool isSkinnedFormat(VertexFormat);
+const char* vertexFormatName(VertexFormat);
+
+// Pick the smallest packed format that keeps the precision of the vertices: half float positions when the
+// rounding error stays well below the size of the mesh, skinning attributes only when the mesh is skinned
+VertexFormat chooseVertexFormat(const std::vector<Vertex>&, bool);
+// Convert vertices to the given format. Packed formats store texture coordinates relative to their range,
+// the offset (xy) and scale (zw) needed to restore them are written to the last argument
+std::vector<unsigned char> packVertices(const std::vector<Vertex>&, VertexFormat, glm::vec4&);
+
+// IEEE half float of a float, rounded to nearest even, and back. Done here rather than with glm's packing header,
+// whose implementation doesn't build warning free
+uint16_t floatToHalf(float);
+float halfToFloat(uint16_t);
+
+// Smallest index size in bytes (1, 2 or 4) able to address the given number of vertices
+unsigned int chooseIndexSize(size_t);
+// Narrow 32 bit indices to the given index size
+std::vector<unsigned char> packIndices(const std::vector<unsigned int>&, unsigned int);
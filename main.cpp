@@ -10,8 +10,21 @@
 #include <shader.hpp>
 #include <camera.hpp>
 #include <model.hpp>
-
+#include <benchmark.hpp>
+#include <render_stats.hpp>
+#include <indirect_renderer.hpp>
+#include <occlusion_culler.hpp>
+#include <uniform_ring.hpp>
+#include <light_clusters.hpp>
+#include <deferred_renderer.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
@@ -21,6 +34,15 @@ void processInput(GLFWwindow *window);
 // settings
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
+// time per frame spent creating GL objects for models loaded in the background
+const double UPLOAD_BUDGET_MS = 2.0;
+// copies of the backpack in the stress scene
+const unsigned int STRESS_COPIES = 10000;
+// copies nearest to the camera drawn into the software occlusion buffer
+const size_t STRESS_OCCLUDERS = 32;
+// copies of the backpack in the light scene and the default number of point lights over them
+const unsigned int LIGHT_SCENE_COPIES = 400;
+const unsigned int LIGHT_SCENE_LIGHTS = 1024;
 
 // camera
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
@@ -32,8 +54,51 @@ bool firstMouse = true;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
-int main()
+// how the stress scene draws its copies, cycled with I: Model::DrawInstanced, one Model::Submit per copy that the
+// render queue merges into batches, or Model::Draw per copy, which the frame's queue batches too
+enum class StressMode { Instanced, Queued, PerCopy };
+const char* const STRESS_MODE_NAMES[] = { "instanced", "queued", "per copy" };
+StressMode stressMode = StressMode::Instanced;
+bool stressKeyDown = false;
+// left click picks the copy under the crosshair in the stress scene
+bool pickRequested = false;
+bool pickButtonDown = false;
+// O toggles software occlusion culling of the stress scene's copies
+bool occlusionCulling = true;
+bool occlusionKeyDown = false;
+// G switches the light scene between forward shading and deferred shading through a G-buffer
+bool deferredShading = false;
+bool shadingKeyDown = false;
+
+int main(int argc, char** argv)
 {
+    // command line: --benchmark <name> runs a benchmark instead of the scene, --scene stress draws
+    // STRESS_COPIES backpacks instead of the default scene, --scene lights draws LIGHT_SCENE_COPIES backpacks
+    // lit by --lights <count> point lights with clustered shading, --shading deferred starts it with deferred
+    // instead of forward shading, --renderer indirect submits the render queue with multi-draw indirect
+    std::string benchmarkName;
+    std::string sceneName;
+    std::string rendererName;
+    unsigned int lightCount = LIGHT_SCENE_LIGHTS;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--benchmark" && i + 1 < argc)
+            benchmarkName = argv[++i];
+        else if (arg == "--scene" && i + 1 < argc)
+            sceneName = argv[++i];
+        else if (arg == "--renderer" && i + 1 < argc)
+            rendererName = argv[++i];
+        else if (arg == "--lights" && i + 1 < argc)
+            lightCount = static_cast<unsigned int>(std::stoul(argv[++i]));
+        else if (arg == "--shading" && i + 1 < argc)
+            deferredShading = std::string(argv[++i]) == "deferred";
+    }
+    bool stressScene = sceneName == "stress";
+    bool lightScene = sceneName == "lights";
+    if (!benchmarkName.empty() && isCpuBenchmark(benchmarkName))
+        return runBenchmark(benchmarkName);
+
     // glfw: initialize and configure
     // ------------------------------
     glfwInit();
@@ -76,15 +141,86 @@ int main()
     // configure global opengl state
     // -----------------------------
     glEnable(GL_DEPTH_TEST);
+    // meshlets facing away from the camera are skipped on the CPU, which is only invisible when back faces are culled
+    glEnable(GL_CULL_FACE);
+
+    if (!benchmarkName.empty())
+    {
+        int result = runBenchmark(benchmarkName);
+        glfwTerminate();
+        return result;
+    }
 
     // build and compile shaders
     // -------------------------
     Shader modelShader("./shaders/model_shader.vert", "./shaders/model_shader.frag");
+    // frame, draw and mesh constants of every shader are written here
+    UniformRing& uniformRing = UniformRing::shared();
+
+    // load models in the background, they show up once they are resident
+    // --------------------------------------------------------------------
+    UploadQueue uploads;
+    std::shared_ptr<Model> backpack = Model::LoadAsync("./assets/backpack/backpack.obj", uploads);
+    std::shared_ptr<Model> cube = Model::LoadAsync("./assets/cube/cube.obj", uploads);
+    std::vector<glm::mat4> stressTransforms;
+    if (stressScene)
+    {
+        stressTransforms = stressSceneTransforms(STRESS_COPIES);
+        std::cout << "Stress scene: " << STRESS_COPIES << " backpacks, press I to cycle between instanced, queued and per copy drawing, "
+                  << "O to toggle occlusion culling, click to pick a copy" << std::endl;
+    }
+    // copies of the stress scene, built once the backpack's bounds are known. Instanced and queued drawing only
+    // visit the copies it finds in the frustum that the nearest copies don't hide
+    Bvh stressBvh;
+    std::vector<Aabb> stressBounds;
+    OcclusionCuller occlusion;
+    std::vector<Aabb> occludeeBounds;
+    std::vector<unsigned char> occluded;
+    std::vector<unsigned int> visibleCopies;
+    std::vector<glm::mat4> visibleTransforms;
+
+    // point lights of the light scene, assigned to clusters of the view every frame and shaded per cluster
+    std::unique_ptr<Shader> litShader;
+    std::unique_ptr<DeferredRenderer> deferredRenderer;
+    LightClusters lightClusters;
+    std::vector<PointLight> lights;
+    std::vector<glm::mat4> lightSceneTransforms;
+    if (lightScene)
+    {
+        if (LightClusters::supported() && DeferredRenderer::supported())
+        {
+            litShader = std::make_unique<Shader>("./shaders/model_lit.vert", "./shaders/model_clustered.frag", "./shaders/clustered_lighting.glsl");
+            deferredRenderer = std::make_unique<DeferredRenderer>();
+            applyLightSceneLighting(*litShader);
+            applyLightSceneLighting(deferredRenderer->geometryShader());
+            applyLightSceneLighting(deferredRenderer->lightingShader());
+            lightSceneTransforms = stressSceneTransforms(LIGHT_SCENE_COPIES);
+            std::cout << "Light scene: " << LIGHT_SCENE_COPIES << " backpacks, " << lightCount << " point lights, "
+                      << (deferredShading ? "deferred" : "forward") << " shading, press G to switch" << std::endl;
+        }
+        else
+        {
+            std::cout << "ERROR::RENDERER:: Clustered lighting needs OpenGL 4.3, drawing the default scene" << std::endl;
+            lightScene = false;
+        }
+    }
 
-    // load models
-    // -----------
-    Model backpack("./assets/backpack/backpack.obj");
-    Model cube("./assets/cube/cube.obj");
+    // draws of every model are collected here and submitted sorted by state, Model::Draw queues into it as well
+    RenderQueue& renderQueue = RenderQueue::shared();
+    std::unique_ptr<IndirectRenderer> indirectRenderer;
+    if (rendererName == "indirect")
+    {
+        if (IndirectRenderer::supported())
+            indirectRenderer = std::make_unique<IndirectRenderer>();
+        else
+            std::cout << "ERROR::RENDERER:: Multi-draw indirect needs OpenGL 4.3, drawing directly" << std::endl;
+    }
+    auto flushQueue = [&](const RenderView& view) {
+        if (indirectRenderer)
+            renderQueue.flush(*indirectRenderer, view);
+        else
+            renderQueue.flush(view);
+    };
 
     // draw in wireframe
     //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
@@ -98,11 +234,16 @@ int main()
         float currentFrame = static_cast<float>(glfwGetTime());
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
+        RenderStats::current().beginFrame();
+        uniformRing.beginFrame();
 
         // input
         // -----
         processInput(window);
 
+        // create GL objects for models that finished loading, without stalling the frame
+        uploads.process(UPLOAD_BUDGET_MS);
+
         // render
         // ------
         glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
@@ -112,30 +253,151 @@ int main()
         modelShader.use();
 
         // view/projection transformations
-        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, stressScene ? 1000.0f : 100.0f);
         glm::mat4 view = camera.GetViewMatrix();
-        modelShader.setMat4("projection", projection);
-        modelShader.setMat4("view", view);
-
-        // render the loaded model
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f)); // translate it down so it's at the center of the scene
-        model = glm::scale(model, glm::vec3(1.0f, 1.0f, 1.0f));	// it's a bit too big for our scene, so scale it down
-        modelShader.setMat4("model", model);
-        backpack.Draw(modelShader);
-
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(3.0f, 0.0f, 0.0f));
-        model = glm::scale(model, glm::vec3(1.0f, 1.0f, 1.0f));
-        modelShader.setMat4("model", model);
-        cube.Draw(modelShader);
+        // what the models need to pick their level of detail
+        RenderView renderView;
+        renderView.view = view;
+        renderView.projection = projection;
+        renderView.cameraPosition = camera.Position;
+        renderView.fovY = glm::radians(camera.Zoom);
+        renderView.viewportHeight = (float)SCR_HEIGHT;
+        renderView.frustum = Frustum(projection * view);
+        // one camera block for every program drawn this frame
+        uniformRing.push(GL_UNIFORM_BUFFER, CAMERA_BLOCK_BINDING, CameraConstants(renderView));
+
+        auto submitStart = std::chrono::steady_clock::now();
+        if (stressScene)
+        {
+            if (stressBvh.objectCount() == 0 && backpack->isResident())
+            {
+                Aabb bounds = backpack->Bounds();
+                stressBounds.reserve(stressTransforms.size());
+                for (const glm::mat4& transform : stressTransforms)
+                    stressBounds.push_back(Aabb::transform(bounds, transform));
+                stressBvh.build(stressBounds);
+            }
+            visibleCopies.clear();
+            stressBvh.queryFrustum(renderView.frustum, visibleCopies);
+            if (occlusionCulling && !visibleCopies.empty())
+            {
+                // the nearest copies occlude the others with their coarsest level of detail
+                size_t occluderCount = std::min(STRESS_OCCLUDERS, visibleCopies.size());
+                std::partial_sort(visibleCopies.begin(), visibleCopies.begin() + occluderCount, visibleCopies.end(), [&](unsigned int a, unsigned int b) {
+                    return glm::length(stressBounds[a].center() - camera.Position) < glm::length(stressBounds[b].center() - camera.Position);
+                });
+                occlusion.beginFrame(projection * view);
+                for (size_t i = 0; i < occluderCount; i++)
+                {
+                    for (const Mesh& mesh : backpack->meshes)
+                        occlusion.addOccluder(mesh, stressTransforms[visibleCopies[i]], static_cast<unsigned int>(mesh.lods.size() - 1));
+                }
+                occlusion.rasterize(ThreadPool::shared());
+                occludeeBounds.clear();
+                for (unsigned int copy : visibleCopies)
+                    occludeeBounds.push_back(stressBounds[copy]);
+                occlusion.testBoxes(occludeeBounds, occluded, ThreadPool::shared());
+                size_t kept = 0;
+                for (size_t i = 0; i < visibleCopies.size(); i++)
+                {
+                    if (!occluded[i])
+                        visibleCopies[kept++] = visibleCopies[i];
+                }
+                RenderStats::current().frame.occlusionTests += visibleCopies.size();
+                RenderStats::current().frame.occlusionCulled += visibleCopies.size() - kept;
+                visibleCopies.resize(kept);
+            }
+            if (pickRequested)
+            {
+                float distance = std::numeric_limits<float>::max();
+                unsigned int picked = stressBvh.raycast(camera.Position, camera.Front, distance);
+                if (picked != ~0u)
+                    std::cout << "Picked backpack " << picked << " at distance " << distance << std::endl;
+                else
+                    std::cout << "Picked nothing" << std::endl;
+                pickRequested = false;
+            }
+
+            if (stressMode == StressMode::Instanced)
+            {
+                visibleTransforms.clear();
+                for (unsigned int copy : visibleCopies)
+                    visibleTransforms.push_back(stressTransforms[copy]);
+                backpack->DrawInstanced(modelShader, renderView, visibleTransforms.data(), visibleTransforms.size());
+            }
+            else if (stressMode == StressMode::Queued)
+            {
+                for (unsigned int copy : visibleCopies)
+                    backpack->Submit(renderQueue, modelShader, renderView, stressTransforms[copy]);
+                flushQueue(renderView);
+            }
+            else
+            {
+                // one draw per copy into the queue flushed below, which computes the matrices of all of them at once
+                for (const glm::mat4& transform : stressTransforms)
+                    backpack->Draw(modelShader, transform);
+            }
+        }
+        else if (lightScene)
+        {
+            // move the lights, sort them into the clusters of this view and shade every copy with its clusters' lights
+            int framebufferWidth, framebufferHeight;
+            glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+            // half the side of the copies' grid, they're 4 units apart
+            float lightExtent = 2.0f * std::sqrt(float(LIGHT_SCENE_COPIES));
+            lightSceneLights(lightCount, lightExtent, currentFrame, lights);
+            lightClusters.build(renderView, glm::vec2(framebufferWidth, framebufferHeight), lights, ThreadPool::shared());
+            lightClusters.bind(uniformRing, lights);
+            RenderStats::current().frame.lights += lights.size();
+            RenderStats::current().frame.lightAssignments += lightClusters.lightIndices().size();
+            // the indirect shaders don't light, the light scene always draws directly
+            if (deferredShading)
+            {
+                deferredRenderer->beginGeometry(framebufferWidth, framebufferHeight);
+                for (const glm::mat4& transform : lightSceneTransforms)
+                    backpack->Submit(renderQueue, deferredRenderer->geometryShader(), renderView, transform);
+                renderQueue.flush(renderView);
+                deferredRenderer->resolve();
+            }
+            else
+            {
+                for (const glm::mat4& transform : lightSceneTransforms)
+                    backpack->Submit(renderQueue, *litShader, renderView, transform);
+                renderQueue.flush(renderView);
+            }
+        }
+        else
+        {
+            // render the loaded model
+            glm::mat4 model = glm::mat4(1.0f);
+            model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f)); // translate it down so it's at the center of the scene
+            model = glm::scale(model, glm::vec3(1.0f, 1.0f, 1.0f));	// it's a bit too big for our scene, so scale it down
+            backpack->Submit(renderQueue, modelShader, renderView, model);
+
+            model = glm::mat4(1.0f);
+            model = glm::translate(model, glm::vec3(3.0f, 0.0f, 0.0f));
+            model = glm::scale(model, glm::vec3(1.0f, 1.0f, 1.0f));
+            cube->Submit(renderQueue, modelShader, renderView, model);
+        }
+        // whatever was queued and not drawn yet, Model::Draw calls included
+        flushQueue(renderView);
+        RenderStats::current().frame.submitNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - submitStart).count();
+        uniformRing.endFrame();
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
         glfwSwapBuffers(window);
         glfwPollEvents();
+        RenderStats::current().endFrame(deltaTime);
     }
 
+    // models release their textures, which needs the context to still be around
+    backpack.reset();
+    cube.reset();
+    indirectRenderer.reset();
+    litShader.reset();
+    deferredRenderer.reset();
+
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
     glfwTerminate();
@@ -161,6 +423,35 @@ void processInput(GLFWwindow *window)
         camera.ProcessKeyboard(UP, deltaTime);
     if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS)
         camera.ProcessKeyboard(DOWN, deltaTime);
+
+    bool stressKey = glfwGetKey(window, GLFW_KEY_I) == GLFW_PRESS;
+    if (stressKey && !stressKeyDown)
+    {
+        stressMode = static_cast<StressMode>((static_cast<int>(stressMode) + 1) % 3);
+        std::cout << "Stress scene: " << STRESS_MODE_NAMES[static_cast<int>(stressMode)] << " drawing" << std::endl;
+    }
+    stressKeyDown = stressKey;
+
+    bool pickButton = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+    if (pickButton && !pickButtonDown)
+        pickRequested = true;
+    pickButtonDown = pickButton;
+
+    bool occlusionKey = glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS;
+    if (occlusionKey && !occlusionKeyDown)
+    {
+        occlusionCulling = !occlusionCulling;
+        std::cout << "Stress scene: occlusion culling " << (occlusionCulling ? "on" : "off") << std::endl;
+    }
+    occlusionKeyDown = occlusionKey;
+
+    bool shadingKey = glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS;
+    if (shadingKey && !shadingKeyDown)
+    {
+        deferredShading = !deferredShading;
+        std::cout << "Light scene: " << (deferredShading ? "deferred" : "forward") << " shading" << std::endl;
+    }
+    shadingKeyDown = shadingKey;
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
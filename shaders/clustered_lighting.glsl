@@ -0,0 +1,87 @@
+// Clustered lighting shared by the forward (model_clustered.frag) and deferred (deferred_lighting.frag) paths, Shader
+// inserts it after the #version line of both fragment shaders
+
+// light that isn't clustered: ambient and one directional light
+uniform vec3 ambientColor;
+uniform vec3 sunDirection;
+uniform vec3 sunColor;
+
+// shared by every program, written into UniformRing once per frame
+layout (std140) uniform Camera
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    mat4 inverseView;
+    mat4 inverseProjection;
+    mat4 inverseViewProjection;
+    vec4 cameraPosition;
+    vec4 frustumPlanes[6];
+};
+// how a fragment finds its cluster, written by LightClusters once per frame
+layout (std140) uniform ClusterGrid
+{
+    // clusters along x, y and z, and the number of lights
+    uvec4 clusterSize;
+    // viewport width and height in pixels, near and far plane distance
+    vec4 clusterViewport;
+    // scale and bias turning the log of view space depth into a depth slice
+    vec4 clusterSlicing;
+};
+
+struct PointLight
+{
+    vec3 position;
+    float radius;
+    vec3 color;
+    float padding;
+};
+layout (std430, binding = 1) readonly buffer Lights
+{
+    PointLight lights[];
+};
+// offset into lightIndices and light count of every cluster
+layout (std430, binding = 2) readonly buffer Clusters
+{
+    uvec2 clusters[];
+};
+layout (std430, binding = 3) readonly buffer LightIndices
+{
+    uint lightIndices[];
+};
+
+// Blinn-Phong from a light direction and the light reaching the surface
+vec3 shade(vec3 lightDir, vec3 radiance, vec3 normal, vec3 viewDir, vec3 albedo, float specularIntensity, float shininess)
+{
+    float diffuse = max(dot(normal, lightDir), 0.0);
+    float specular = pow(max(dot(normal, normalize(lightDir + viewDir)), 0.0), shininess);
+    return radiance * (diffuse * albedo + specular * specularIntensity);
+}
+
+// Ambient, sun and the lights of the cluster a world space surface point is in
+vec3 lightSurface(vec3 fragPos, vec3 normal, vec3 albedo, float specularIntensity, float shininess)
+{
+    vec3 viewDir = normalize(cameraPosition.xyz - fragPos);
+    vec3 result = ambientColor * albedo + shade(normalize(-sunDirection), sunColor, normal, viewDir, albedo, specularIntensity, shininess);
+
+    // the cluster: screen tile from the pixel, depth slice from the log of the view space depth
+    float depth = -(view * vec4(fragPos, 1.0)).z;
+    uvec2 tile = min(uvec2(gl_FragCoord.xy * vec2(clusterSize.xy) / clusterViewport.xy), clusterSize.xy - 1u);
+    uint slice = uint(clamp(floor(log(depth) * clusterSlicing.x + clusterSlicing.y), 0.0, float(clusterSize.z - 1u)));
+    uvec2 cluster = clusters[tile.x + clusterSize.x * (tile.y + clusterSize.y * slice)];
+
+    for (uint i = 0u; i < cluster.y; i++)
+    {
+        PointLight light = lights[lightIndices[cluster.x + i]];
+        vec3 toLight = light.position - fragPos;
+        float distanceSquared = dot(toLight, toLight);
+        float radiusSquared = light.radius * light.radius;
+        if (distanceSquared >= radiusSquared)
+            continue;
+        // inverse square falloff, windowed to reach zero at the radius the clusters were built with
+        float window = 1.0 - (distanceSquared * distanceSquared) / (radiusSquared * radiusSquared);
+        float attenuation = window * window / max(distanceSquared, 0.01);
+        result += shade(toLight * inversesqrt(max(distanceSquared, 1.0e-8)), light.color * attenuation, normal, viewDir, albedo, specularIntensity, shininess);
+    }
+    return result;
+}
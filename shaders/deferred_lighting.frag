@@ -0,0 +1,33 @@
+#version 430 core
+
+// G-buffer written by gbuffer.frag
+uniform sampler2D gAlbedoSpecular;
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+
+out vec4 FragColor;
+
+// lightSurface and the blocks it reads come from clustered_lighting.glsl
+
+vec3 octDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gDepth, pixel, 0).r;
+    // nothing was drawn here
+    if (depth == 1.0)
+        discard;
+    vec4 albedoSpecular = texelFetch(gAlbedoSpecular, pixel, 0);
+    vec4 packedNormal = texelFetch(gNormal, pixel, 0);
+    vec3 normal = octDecode(packedNormal.rg * 2.0 - 1.0);
+    // world space position from the pixel and its depth
+    vec4 position = inverseViewProjection * vec4(gl_FragCoord.xy / clusterViewport.xy * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+    FragColor = vec4(lightSurface(position.xyz / position.w, normal, albedoSpecular.rgb, albedoSpecular.a, packedNormal.b * 256.0), 1.0);
+}
@@ -0,0 +1,25 @@
+#version 330 core
+layout (location = 0) out vec4 gAlbedoSpecular; // albedo, specular intensity
+layout (location = 1) out vec4 gNormal; // octahedral normal mapped to [0, 1], shininess / 256
+
+uniform sampler2D texture_diffuse1;
+uniform sampler2D texture_specular1;
+uniform float shininess;
+
+in vec2 TexCoords;
+in vec3 Normal;
+
+vec2 octEncode(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 e = n.xy;
+    if (n.z < 0.0)
+        e = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return e;
+}
+
+void main()
+{
+    gAlbedoSpecular = vec4(texture(texture_diffuse1, TexCoords).rgb, texture(texture_specular1, TexCoords).r);
+    gNormal = vec4(octEncode(normalize(Normal)) * 0.5 + 0.5, shininess / 256.0, 0.0);
+}
@@ -1,10 +1,27 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// shared by every program, written into UniformRing once per frame
+layout (std140) uniform Camera
+{
+  mat4 view;
+  mat4 projection;
+  mat4 viewProjection;
+  mat4 inverseView;
+  mat4 inverseProjection;
+  mat4 inverseViewProjection;
+  vec4 cameraPosition;
+  vec4 frustumPlanes[6];
+};
+// the matrices derived from the model matrix are computed on the CPU once per draw
+layout (std140) uniform DrawConstants
+{
+  mat4 model;
+  mat4 modelViewProjection;
+  mat3 normalMatrix;
+  bool instanced;
+};
 
 void main() {
-  gl_Position = projection * view * model * vec4(aPos, 1.0);
+  gl_Position = modelViewProjection * vec4(aPos, 1.0);
 }
@@ -0,0 +1,20 @@
+#version 430 core
+
+uniform sampler2D texture_diffuse1;
+uniform sampler2D texture_specular1;
+uniform float shininess;
+uniform float opacity;
+
+out vec4 FragColor;
+
+in vec2 TexCoords;
+in vec3 FragPos;
+in vec3 Normal;
+
+// lightSurface and the blocks it reads come from clustered_lighting.glsl
+void main()
+{
+    vec4 diffuse = texture(texture_diffuse1, TexCoords);
+    float specularIntensity = texture(texture_specular1, TexCoords).r;
+    FragColor = vec4(lightSurface(FragPos, normalize(Normal), diffuse.rgb, specularIntensity, shininess), diffuse.a * opacity);
+}
@@ -0,0 +1,17 @@
+#version 430 core
+
+// diffuse textures of every material drawn by the same multi-draw call, one layer each
+uniform sampler2DArray diffuseArray;
+
+out vec4 FragColor;
+
+in vec2 TexCoords;
+flat in uint Layer;
+
+void main()
+{
+    if (Layer == 0xFFFFFFFFu)
+        FragColor = vec4(1.0);
+    else
+        FragColor = texture(diffuseArray, vec3(TexCoords, float(Layer)));
+}
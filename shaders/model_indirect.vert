@@ -0,0 +1,71 @@
+#version 430 core
+layout (location = 0) in vec4 aPos; // w: bitangent sign of packed vertices
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in vec3 aTangent;
+layout (location = 4) in vec3 aBitangent;
+layout (location = 7) in vec4 aPackedFrame; // octahedral normal (xy) and tangent (zw) of packed vertices
+layout (location = 12) in uint aDrawIndex; // per instance, equals the command's base instance
+
+// everything that used to be a per mesh uniform, one entry per draw
+struct DrawData
+{
+    mat4 modelViewProjection; // computed on the CPU
+    vec4 uvTransform;
+    uint layer; // diffuse layer in the texture array, 0xFFFFFFFF without one
+    uint packedVertex;
+    uint pad0;
+    uint pad1;
+};
+
+layout (std430, binding = 0) readonly buffer Draws
+{
+    DrawData draws[];
+};
+
+out vec2 TexCoords;
+out vec3 Normal;
+out vec3 Tangent;
+out vec3 Bitangent;
+flat out uint Layer;
+
+// shared by every program, written into UniformRing once per frame
+layout (std140) uniform Camera
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    mat4 inverseView;
+    mat4 inverseProjection;
+    mat4 inverseViewProjection;
+    vec4 cameraPosition;
+    vec4 frustumPlanes[6];
+};
+
+vec3 octDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+void main()
+{
+    DrawData draw = draws[aDrawIndex];
+    if (draw.packedVertex != 0u)
+    {
+        Normal = octDecode(aPackedFrame.xy);
+        Tangent = octDecode(aPackedFrame.zw);
+        Bitangent = cross(Normal, Tangent) * aPos.w;
+    }
+    else
+    {
+        Normal = aNormal;
+        Tangent = aTangent;
+        Bitangent = aBitangent;
+    }
+    TexCoords = draw.uvTransform.xy + aTexCoords * draw.uvTransform.zw;
+    Layer = draw.layer;
+    gl_Position = draw.modelViewProjection * vec4(aPos.xyz, 1.0);
+}
@@ -0,0 +1,69 @@
+#version 330 core
+layout (location = 0) in vec4 aPos; // w: bitangent sign of packed vertices
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 7) in vec4 aPackedFrame; // octahedral normal (xy) and tangent (zw) of packed vertices
+layout (location = 8) in mat4 aInstanceModel; // locations 8-11, model matrix per instance
+layout (location = 13) in mat3 aInstanceNormalMatrix; // locations 13-15, its normal matrix
+
+out vec2 TexCoords;
+// world space, for lighting
+out vec3 FragPos;
+out vec3 Normal;
+
+// shared by every program, written into UniformRing once per frame
+layout (std140) uniform Camera
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    mat4 inverseView;
+    mat4 inverseProjection;
+    mat4 inverseViewProjection;
+    vec4 cameraPosition;
+    vec4 frustumPlanes[6];
+};
+// written into UniformRing per draw and per mesh draw
+layout (std140) uniform DrawConstants
+{
+    mat4 model;
+    mat4 modelViewProjection;
+    mat3 normalMatrix;
+    // take the model and normal matrices from the instance attributes instead
+    bool instanced;
+};
+// packed vertex decoding
+layout (std140) uniform MeshConstants
+{
+    vec4 uvTransform;
+    bool packedVertex;
+};
+
+vec3 octDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+void main()
+{
+    vec3 normal = packedVertex ? octDecode(aPackedFrame.xy) : aNormal;
+    TexCoords = uvTransform.xy + aTexCoords * uvTransform.zw;
+    // precomputed on the CPU, per draw or per instance
+    if (instanced)
+    {
+        // instances have no model view projection matrix, the world position is needed for lighting anyway
+        vec4 worldPosition = aInstanceModel * vec4(aPos.xyz, 1.0);
+        FragPos = worldPosition.xyz;
+        Normal = aInstanceNormalMatrix * normal;
+        gl_Position = viewProjection * worldPosition;
+    }
+    else
+    {
+        FragPos = vec3(model * vec4(aPos.xyz, 1.0));
+        Normal = normalMatrix * normal;
+        gl_Position = modelViewProjection * vec4(aPos.xyz, 1.0);
+    }
+}
@@ -1,6 +1,7 @@
 #version 330 core
 
 uniform sampler2D texture_diffuse1;
+uniform float opacity;
 
 out vec4 FragColor;
 
@@ -9,4 +10,5 @@ in vec2 TexCoords;
 void main()
 {    
     FragColor = texture(texture_diffuse1, TexCoords);
+    FragColor.a *= opacity;
 }
\ No newline at end of file
@@ -1,16 +1,71 @@
 #version 330 core
-layout (location = 0) in vec3 aPos;
+layout (location = 0) in vec4 aPos; // w: bitangent sign of packed vertices
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in vec3 aTangent;
+layout (location = 4) in vec3 aBitangent;
+layout (location = 7) in vec4 aPackedFrame; // octahedral normal (xy) and tangent (zw) of packed vertices
+layout (location = 8) in mat4 aInstanceModelViewProjection; // locations 8-11, model view projection per instance
 
 out vec2 TexCoords;
+out vec3 Normal;
+out vec3 Tangent;
+out vec3 Bitangent;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// shared by every program, written into UniformRing once per frame
+layout (std140) uniform Camera
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    mat4 inverseView;
+    mat4 inverseProjection;
+    mat4 inverseViewProjection;
+    vec4 cameraPosition;
+    vec4 frustumPlanes[6];
+};
+// written into UniformRing per draw and per mesh draw
+layout (std140) uniform DrawConstants
+{
+    mat4 model;
+    mat4 modelViewProjection;
+    mat3 normalMatrix;
+    // take the matrix from the instance attribute instead
+    bool instanced;
+};
+// packed vertex decoding
+layout (std140) uniform MeshConstants
+{
+    vec4 uvTransform;
+    bool packedVertex;
+};
+
+vec3 octDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
 
 void main()
 {
-    TexCoords = aTexCoords;    
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
-}
\ No newline at end of file
+    if (packedVertex)
+    {
+        Normal = octDecode(aPackedFrame.xy);
+        Tangent = octDecode(aPackedFrame.zw);
+        Bitangent = cross(Normal, Tangent) * aPos.w;
+    }
+    else
+    {
+        Normal = aNormal;
+        Tangent = aTangent;
+        Bitangent = aBitangent;
+    }
+    TexCoords = uvTransform.xy + aTexCoords * uvTransform.zw;
+    // precomputed on the CPU per draw or per instance
+    if (instanced)
+        gl_Position = aInstanceModelViewProjection * vec4(aPos.xyz, 1.0);
+    else
+        gl_Position = modelViewProjection * vec4(aPos.xyz, 1.0);
+}
@@ -0,0 +1,52 @@
+#version 330 core
+// model_shader.vert with plain uniforms set per draw instead of blocks in UniformRing, the uniforms benchmark
+// compares both
+layout (location = 0) in vec4 aPos; // w: bitangent sign of packed vertices
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in vec3 aTangent;
+layout (location = 4) in vec3 aBitangent;
+layout (location = 7) in vec4 aPackedFrame; // octahedral normal (xy) and tangent (zw) of packed vertices
+layout (location = 8) in mat4 aInstanceModel; // locations 8-11, one matrix per instance
+
+out vec2 TexCoords;
+out vec3 Normal;
+out vec3 Tangent;
+out vec3 Bitangent;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+// take the model matrix from the instance attribute instead of the uniform
+uniform bool instanced;
+
+// packed vertex decoding
+uniform bool packedVertex;
+uniform vec4 uvTransform;
+
+vec3 octDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+void main()
+{
+    if (packedVertex)
+    {
+        Normal = octDecode(aPackedFrame.xy);
+        Tangent = octDecode(aPackedFrame.zw);
+        Bitangent = cross(Normal, Tangent) * aPos.w;
+    }
+    else
+    {
+        Normal = aNormal;
+        Tangent = aTangent;
+        Bitangent = aBitangent;
+    }
+    TexCoords = uvTransform.xy + aTexCoords * uvTransform.zw;
+    mat4 modelMatrix = instanced ? aInstanceModel : model;
+    gl_Position = projection * view * modelMatrix * vec4(aPos.xyz, 1.0);
+}
@@ -1,19 +1,51 @@
 #version 330 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec2 aTexCoords;
-layout (location = 2) in vec3 aNormal;
+layout (location = 0) in vec4 aPos; // w: bitangent sign of packed vertices
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 7) in vec4 aPackedFrame; // octahedral normal (xy) and tangent (zw) of packed vertices
 
 out vec3 FragPos;
 out vec2 TexCoords;
 out vec3 Normal;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// shared by every program, written into UniformRing once per frame
+layout (std140) uniform Camera
+{
+  mat4 view;
+  mat4 projection;
+  mat4 viewProjection;
+  mat4 inverseView;
+  mat4 inverseProjection;
+  mat4 inverseViewProjection;
+  vec4 cameraPosition;
+  vec4 frustumPlanes[6];
+};
+// the matrices derived from the model matrix are computed on the CPU once per draw
+layout (std140) uniform DrawConstants
+{
+  mat4 model;
+  mat4 modelViewProjection;
+  mat3 normalMatrix;
+  bool instanced;
+};
+// packed vertex decoding
+layout (std140) uniform MeshConstants
+{
+  vec4 uvTransform;
+  bool packedVertex;
+};
+
+vec3 octDecode(vec2 e) {
+  vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+  float t = max(-n.z, 0.0);
+  n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+  return normalize(n);
+}
 
 void main() {
-  gl_Position = projection * view * model * vec4(aPos, 1.0);
-  FragPos = vec3(model * vec4(aPos, 1.0));
-  TexCoords = aTexCoords;
-  Normal = mat3(transpose(inverse(model))) * aNormal;
+  vec3 normal = packedVertex ? octDecode(aPackedFrame.xy) : aNormal;
+  gl_Position = modelViewProjection * vec4(aPos.xyz, 1.0);
+  FragPos = vec3(model * vec4(aPos.xyz, 1.0));
+  TexCoords = uvTransform.xy + aTexCoords * uvTransform.zw;
+  Normal = normalMatrix * normal;
 }
@@ -0,0 +1,52 @@
+#version 330 core
+// shader.vert deriving its matrices from the model matrix for every vertex, the way it did before they moved to the
+// CPU. The transforms benchmark compares both
+layout (location = 0) in vec4 aPos; // w: bitangent sign of packed vertices
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 7) in vec4 aPackedFrame; // octahedral normal (xy) and tangent (zw) of packed vertices
+
+out vec3 FragPos;
+out vec2 TexCoords;
+out vec3 Normal;
+
+// shared by every program, written into UniformRing once per frame
+layout (std140) uniform Camera
+{
+  mat4 view;
+  mat4 projection;
+  mat4 viewProjection;
+  mat4 inverseView;
+  mat4 inverseProjection;
+  mat4 inverseViewProjection;
+  vec4 cameraPosition;
+  vec4 frustumPlanes[6];
+};
+layout (std140) uniform DrawConstants
+{
+  mat4 model;
+  mat4 modelViewProjection;
+  mat3 normalMatrix;
+  bool instanced;
+};
+// packed vertex decoding
+layout (std140) uniform MeshConstants
+{
+  vec4 uvTransform;
+  bool packedVertex;
+};
+
+vec3 octDecode(vec2 e) {
+  vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+  float t = max(-n.z, 0.0);
+  n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+  return normalize(n);
+}
+
+void main() {
+  vec3 normal = packedVertex ? octDecode(aPackedFrame.xy) : aNormal;
+  gl_Position = projection * view * model * vec4(aPos.xyz, 1.0);
+  FragPos = vec3(model * vec4(aPos.xyz, 1.0));
+  TexCoords = uvTransform.xy + aTexCoords * uvTransform.zw;
+  Normal = mat3(transpose(inverse(model))) * normal;
+}
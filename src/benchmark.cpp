@@ -0,0 +1,1126 @@
+#include <benchmark.hpp>
+#include <bvh.hpp>
+#include <deferred_renderer.hpp>
+#include <mesh_cache.hpp>
+#include <mesh_optimizer.hpp>
+#include <model.hpp>
+#include <occlusion_culler.hpp>
+#include <shader.hpp>
+#include <render_stats.hpp>
+#include <uniform_ring.hpp>
+#include <vertex_format.hpp>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <set>
+
+namespace {
+
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// cold (ASSIMP import + cache write) against warm (mapped mesh cache) loads of the same model
+int benchmarkModelLoad() {
+    const std::string path = "./assets/backpack/backpack.obj";
+    const int warmRuns = 5;
+
+    std::remove(MeshCache::cachePath(path).c_str());
+    auto start = std::chrono::steady_clock::now();
+    {
+        Model model(path);
+        if (model.meshes.empty())
+            return -1;
+    }
+    double cold = millisecondsSince(start);
+
+    double warmBest = 0.0, warmTotal = 0.0;
+    for (int i = 0; i < warmRuns; i++) {
+        start = std::chrono::steady_clock::now();
+        {
+            Model model(path);
+        }
+        double warm = millisecondsSince(start);
+        warmTotal += warm;
+        if (i == 0 || warm < warmBest)
+            warmBest = warm;
+    }
+
+    std::cout << "BENCHMARK::LOAD " << path << "\n"
+              << "  cold (assimp): " << cold << " ms\n"
+              << "  warm (cache):  " << warmBest << " ms best, " << warmTotal / warmRuns << " ms average over " << warmRuns << " runs\n"
+              << "  speedup:       " << cold / warmBest << "x" << std::endl;
+    return 0;
+}
+
+// positions and triangles of every mesh in a file straight from ASSIMP, so checks on them don't need a GL context
+struct ImportedMesh {
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+};
+
+bool importMeshes(const std::string& path, std::vector<ImportedMesh>& meshes) {
+    Assimp::Importer importer;
+    const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_JoinIdenticalVertices);
+    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE) {
+        std::cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << std::endl;
+        return false;
+    }
+    for (unsigned int m = 0; m < scene->mNumMeshes; m++) {
+        const aiMesh* source = scene->mMeshes[m];
+        ImportedMesh mesh;
+        mesh.vertices.resize(source->mNumVertices, Vertex{});
+        for (unsigned int i = 0; i < source->mNumVertices; i++)
+            mesh.vertices[i].Position = glm::vec3(source->mVertices[i].x, source->mVertices[i].y, source->mVertices[i].z);
+        for (unsigned int f = 0; f < source->mNumFaces; f++) {
+            const aiFace& face = source->mFaces[f];
+            if (face.mNumIndices == 3)
+                mesh.indices.insert(mesh.indices.end(), face.mIndices, face.mIndices + 3);
+        }
+        meshes.push_back(std::move(mesh));
+    }
+    return true;
+}
+
+// each triangle rotated to start at its smallest index, which keeps its winding, in sorted order. What has to stay
+// the same however triangles are reordered
+std::vector<std::array<unsigned int, 3>> sortedTriangles(const std::vector<unsigned int>& indices) {
+    std::vector<std::array<unsigned int, 3>> triangles(indices.size() / 3);
+    for (size_t t = 0; t < triangles.size(); t++) {
+        std::array<unsigned int, 3>& triangle = triangles[t];
+        triangle = { indices[t * 3], indices[t * 3 + 1], indices[t * 3 + 2] };
+        std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+    }
+    std::sort(triangles.begin(), triangles.end());
+    return triangles;
+}
+
+// meshlets must cover the reordered triangles exactly once, stay within their limits and bound their vertices
+bool validateMeshlets(const std::vector<Meshlet>& meshlets, const std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices) {
+    size_t next = 0;
+    for (const Meshlet& meshlet : meshlets) {
+        std::set<unsigned int> used;
+        for (size_t i = meshlet.indexOffset; i < size_t(meshlet.indexOffset) + meshlet.indexCount; i++) {
+            used.insert(indices[i]);
+            if (glm::length(vertices[indices[i]].Position - meshlet.center) > meshlet.radius * 1.0001f + 1e-6f)
+                return false;
+        }
+        if (meshlet.indexOffset != next || meshlet.indexCount % 3 != 0 || meshlet.indexCount / 3 > MESHLET_MAX_TRIANGLES || used.size() > MESHLET_MAX_VERTICES)
+            return false;
+        next += meshlet.indexCount;
+    }
+    return next == indices.size();
+}
+
+// fraction of meshlets culled along a fixed camera path: two orbits around the model, the second one
+// looking past it so part of the model leaves the frustum. Runs without a GPU on the imported triangles. Meshlets
+// must be valid and every triangle of a meshlet culled as backfacing has to face away from the camera
+int benchmarkClusterCulling() {
+    const std::string path = "./assets/backpack/backpack.obj";
+    const int steps = 360;
+    const float orbitRadius = 4.0f;
+
+    std::vector<ImportedMesh> meshes;
+    if (!importMeshes(path, meshes))
+        return -1;
+    std::vector<std::vector<Meshlet>> meshlets;
+    size_t meshletCount = 0;
+    for (ImportedMesh& mesh : meshes) {
+        std::vector<std::array<unsigned int, 3>> before = sortedTriangles(mesh.indices);
+        meshlets.push_back(buildMeshlets(mesh.indices, 0, mesh.indices.size(), mesh.vertices));
+        if (sortedTriangles(mesh.indices) != before || !validateMeshlets(meshlets.back(), mesh.indices, mesh.vertices)) {
+            std::cout << "ERROR::BENCHMARK:: Invalid meshlets in " << path << std::endl;
+            return -1;
+        }
+        meshletCount += meshlets.back().size();
+    }
+
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+    unsigned long long tested = 0, outside = 0, backfacing = 0, triangles = 0, trianglesDrawn = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int orbit = 0; orbit < 2; orbit++) {
+        for (int step = 0; step < steps; step++) {
+            float angle = glm::radians(360.0f * step / steps);
+            glm::vec3 eye(std::sin(angle) * orbitRadius, 1.0f, std::cos(angle) * orbitRadius);
+            glm::vec3 side = glm::normalize(glm::cross(-eye, glm::vec3(0.0f, 1.0f, 0.0f)));
+            glm::vec3 target = orbit == 0 ? glm::vec3(0.0f) : side * 2.0f;
+            Frustum frustum(projection * glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f)));
+            for (size_t m = 0; m < meshes.size(); m++) {
+                for (const Meshlet& meshlet : meshlets[m]) {
+                    tested++;
+                    triangles += meshlet.indexCount / 3;
+                    if (meshletOutside(meshlet, frustum))
+                        outside++;
+                    else if (meshletBackfacing(meshlet, eye))
+                        backfacing++;
+                    else
+                        trianglesDrawn += meshlet.indexCount / 3;
+                }
+            }
+        }
+    }
+    double elapsed = millisecondsSince(start);
+
+    // the eye positions are the same on both orbits, check the backface culled meshlets at each of them once
+    unsigned long long wronglyCulled = 0;
+    for (int step = 0; step < steps; step++) {
+        float angle = glm::radians(360.0f * step / steps);
+        glm::vec3 eye(std::sin(angle) * orbitRadius, 1.0f, std::cos(angle) * orbitRadius);
+        for (size_t m = 0; m < meshes.size(); m++) {
+            const ImportedMesh& mesh = meshes[m];
+            for (const Meshlet& meshlet : meshlets[m]) {
+                if (!meshletBackfacing(meshlet, eye))
+                    continue;
+                for (size_t i = meshlet.indexOffset; i < size_t(meshlet.indexOffset) + meshlet.indexCount; i += 3) {
+                    const glm::vec3& p0 = mesh.vertices[mesh.indices[i]].Position;
+                    glm::vec3 normal = glm::cross(mesh.vertices[mesh.indices[i + 1]].Position - p0, mesh.vertices[mesh.indices[i + 2]].Position - p0);
+                    glm::vec3 toEye = eye - p0;
+                    // counter clockwise triangles face the eye when it's in front of their plane
+                    if (glm::dot(normal, toEye) > 1e-4f * glm::length(normal) * glm::length(toEye))
+                        wronglyCulled++;
+                }
+            }
+        }
+    }
+
+    std::cout << "BENCHMARK::CLUSTERS " << path << "\n"
+              << "  meshlets:        " << meshletCount << " over " << meshes.size() << " meshes\n"
+              << "  camera steps:    " << 2 * steps << "\n"
+              << "  frustum culled:  " << 100.0 * outside / tested << "%\n"
+              << "  backface culled: " << 100.0 * backfacing / tested << "%\n"
+              << "  total culled:    " << 100.0 * (outside + backfacing) / tested << "% of clusters, "
+              << 100.0 * (triangles - trianglesDrawn) / triangles << "% of triangles\n"
+              << "  cull cost:       " << elapsed * 1.0e6 / tested << " ns per cluster\n"
+              << "  front facing triangles backface culled: " << wronglyCulled << std::endl;
+    return wronglyCulled == 0 ? 0 : -1;
+}
+
+// uniform set calls per second: a GL location query per call (how every setter used to work), a lookup in the
+// shader's uniform table by name, and a handle resolved up front. Then the CPU cost of draws setting their constants
+// as uniforms against writing them into the uniform ring
+int benchmarkUniforms() {
+    const int calls = 1000000;
+    // the variant of the model shader that still takes its constants as plain uniforms
+    Shader shader("./shaders/model_uniforms.vert", "./shaders/model_shader.frag");
+    shader.use();
+    const std::string name = "model";
+    UniformHandle<glm::mat4> handle = shader.uniform<glm::mat4>(name);
+    if (!handle.valid()) {
+        std::cout << "ERROR::BENCHMARK:: Uniform not found: " << name << std::endl;
+        return -1;
+    }
+
+    // values change every call so the driver can't drop them as redundant
+    auto run = [&](auto set) {
+        glFinish();
+        auto start = std::chrono::steady_clock::now();
+        glm::mat4 value(1.0f);
+        for (int i = 0; i < calls; i++) {
+            value[3][0] = float(i);
+            set(value);
+        }
+        glFinish();
+        return calls / (millisecondsSince(start) / 1000.0);
+    };
+    double queried = run([&](const glm::mat4& value) { glUniformMatrix4fv(glGetUniformLocation(shader.ID, name.c_str()), 1, GL_FALSE, &value[0][0]); });
+    double byName = run([&](const glm::mat4& value) { shader.setMat4(name, value); });
+    double byHandle = run([&](const glm::mat4& value) { shader.set(handle, value); });
+
+    std::cout << "BENCHMARK::UNIFORMS " << calls << " mat4 sets per variant\n"
+              << "  glGetUniformLocation per call: " << queried / 1.0e6 << " M calls/s\n"
+              << "  uniform table by name:         " << byName / 1.0e6 << " M calls/s (" << byName / queried << "x)\n"
+              << "  resolved handle:               " << byHandle / 1.0e6 << " M calls/s (" << byHandle / queried << "x)" << std::endl;
+
+    // whole draws, each with its own model matrix: resolved uniform handles against constants written into the
+    // uniform ring and bound by range. Submit is the CPU time until the last draw call returned
+    const std::string path = "./assets/backpack/backpack.obj";
+    const int draws = 10000;
+    const int frames = 20;
+    Model model(path);
+    if (model.meshes.empty())
+        return -1;
+    Mesh& mesh = model.meshes[0];
+    unsigned int lod = static_cast<unsigned int>(mesh.lods.size() - 1);
+    Shader ringShader("./shaders/model_shader.vert", "./shaders/model_shader.frag");
+    UniformRing& ring = UniformRing::shared();
+    RenderView camera;
+    camera.cameraPosition = glm::vec3(0.0f, 0.0f, 50.0f);
+    camera.projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 1000.0f);
+    camera.view = glm::lookAt(camera.cameraPosition, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    camera.frustum = Frustum(camera.projection * camera.view);
+    glm::mat4 viewProjection = camera.projection * camera.view;
+    UniformHandle<glm::mat4> projectionHandle = shader.uniform<glm::mat4>("projection");
+    UniformHandle<glm::mat4> viewHandle = shader.uniform<glm::mat4>("view");
+    UniformHandle<bool> packedHandle = shader.uniform<bool>("packedVertex");
+    UniformHandle<glm::vec4> uvHandle = shader.uniform<glm::vec4>("uvTransform");
+
+    struct Result {
+        double submit = 0.0, frame = 0.0;
+    };
+    auto drawFrames = [&](Shader& drawShader, auto frameStart, auto drawOne, auto frameEnd) {
+        Result result;
+        drawShader.use();
+        mesh.material->apply(drawShader);
+        glFinish();
+        for (int i = 0; i < frames; i++) {
+            RenderStats::current().beginFrame();
+            auto start = std::chrono::steady_clock::now();
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            frameStart();
+            glm::mat4 transform(1.0f);
+            for (int j = 0; j < draws; j++) {
+                transform[3][0] = float(j % 100) - 50.0f;
+                transform[3][1] = float(j / 100) - 50.0f;
+                drawOne(transform);
+                mesh.DrawLevel(lod);
+            }
+            result.submit += millisecondsSince(start);
+            frameEnd();
+            glFinish();
+            result.frame += millisecondsSince(start);
+        }
+        // per 1000 draws
+        result.submit *= 1000.0 / (double(frames) * draws);
+        result.frame *= 1000.0 / (double(frames) * draws);
+        return result;
+    };
+    Result uniformPath = drawFrames(shader, [&]() {
+        shader.set(projectionHandle, camera.projection);
+        shader.set(viewHandle, camera.view);
+    }, [&](const glm::mat4& transform) {
+        shader.set(handle, transform);
+        shader.set(packedHandle, isPackedFormat(mesh.format));
+        shader.set(uvHandle, mesh.uvTransform);
+    }, []() {});
+    Result ringPath = drawFrames(ringShader, [&]() {
+        ring.beginFrame();
+        ring.push(GL_UNIFORM_BUFFER, CAMERA_BLOCK_BINDING, CameraConstants(camera));
+    }, [&](const glm::mat4& transform) {
+        ring.push(GL_UNIFORM_BUFFER, DRAW_BLOCK_BINDING, DrawConstants(transform, viewProjection));
+        mesh.applyVertexDecoding();
+    }, [&]() { ring.endFrame(); });
+
+    std::cout << "BENCHMARK::UNIFORMS " << draws << " draws of " << path << " (coarsest level of the first mesh), " << frames
+              << " frames per path, per 1000 draws\n"
+              << "  uniforms:     " << uniformPath.submit << " ms submit, " << uniformPath.frame << " ms frame\n"
+              << "  uniform ring: " << ringPath.submit << " ms submit, " << ringPath.frame << " ms frame ("
+              << (ring.persistent() ? "persistently mapped" : "glBufferSubData") << ")\n"
+              << "  speedup:      " << uniformPath.submit / ringPath.submit << "x submit" << std::endl;
+    return 0;
+}
+
+// batched frustum culling of random spheres and boxes filling a cube around the camera, SIMD against one at a time.
+// Both have to agree on every object
+int benchmarkFrustumCulling() {
+    const size_t count = 1000000;
+    const int runs = 10;
+    const float worldSize = 200.0f;
+
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> position(-0.5f * worldSize, 0.5f * worldSize);
+    std::uniform_real_distribution<float> size(0.1f, 5.0f);
+    BoundsArrays bounds;
+    for (size_t i = 0; i < count; i++) {
+        glm::vec3 extent(size(random), size(random), size(random));
+        bounds.push(glm::vec3(position(random), position(random), position(random)), glm::length(extent), extent);
+    }
+    Frustum frustum(glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f) *
+                    glm::lookAt(glm::vec3(0.0f), glm::vec3(1.0f, 0.2f, 0.3f), glm::vec3(0.0f, 1.0f, 0.0f)));
+
+    std::vector<unsigned char> visible, reference;
+    auto best = [&](auto cull) {
+        double fastest = 0.0;
+        for (int i = 0; i < runs; i++) {
+            auto start = std::chrono::steady_clock::now();
+            cull(frustum, bounds, visible);
+            double elapsed = millisecondsSince(start);
+            if (i == 0 || elapsed < fastest)
+                fastest = elapsed;
+        }
+        return fastest;
+    };
+    auto countVisible = [](const std::vector<unsigned char>& flags) {
+        size_t visibleCount = 0;
+        for (unsigned char flag : flags)
+            visibleCount += flag;
+        return visibleCount;
+    };
+
+    double sphereScalar = best(cullSpheresScalar);
+    reference = visible;
+    double sphereSimd = best(cullSpheres);
+    if (visible != reference) {
+        std::cout << "ERROR::BENCHMARK:: SIMD and scalar sphere culling disagree" << std::endl;
+        return -1;
+    }
+    size_t spheresVisible = countVisible(visible);
+    double boxScalar = best(cullBoxesScalar);
+    reference = visible;
+    double boxSimd = best(cullBoxes);
+    if (visible != reference) {
+        std::cout << "ERROR::BENCHMARK:: SIMD and scalar box culling disagree" << std::endl;
+        return -1;
+    }
+    size_t boxesVisible = countVisible(visible);
+
+    std::cout << "BENCHMARK::CULL " << count << " bounds, best of " << runs << " runs\n"
+              << "  spheres: " << sphereSimd << " ms SIMD, " << sphereScalar << " ms scalar (" << sphereScalar / sphereSimd << "x), "
+              << 100.0 * (count - spheresVisible) / count << "% culled\n"
+              << "  boxes:   " << boxSimd << " ms SIMD, " << boxScalar << " ms scalar (" << boxScalar / boxSimd << "x), "
+              << 100.0 * (count - boxesVisible) / count << "% culled" << std::endl;
+    return 0;
+}
+
+// scene BVH over random boxes scattered on a wide, flat world: build, refitting after 10% of the objects moved
+// (one update each and one full refit), and frustum and ray queries against testing every box. Both have to agree
+int benchmarkBvh() {
+    const unsigned int counts[] = { 10000, 100000, 1000000 };
+    const int frustumQueries = 100;
+    const int rayQueries = 10000;
+    // rays checked against every box, the brute force version is too slow for all of them
+    const int checkedRays = 100;
+
+    std::cout << "BENCHMARK::BVH" << std::endl;
+    for (unsigned int count : counts) {
+        // same density of objects at every count
+        float worldSize = 10.0f * std::sqrt(float(count));
+        std::mt19937 random(42);
+        std::uniform_real_distribution<float> position(-0.5f * worldSize, 0.5f * worldSize);
+        std::uniform_real_distribution<float> height(0.0f, 20.0f);
+        std::uniform_real_distribution<float> size(0.1f, 3.0f);
+        std::uniform_real_distribution<float> offset(-1.0f, 1.0f);
+        std::vector<Aabb> boxes(count);
+        for (Aabb& box : boxes) {
+            glm::vec3 center(position(random), height(random), position(random));
+            glm::vec3 extent(size(random), size(random), size(random));
+            box = Aabb{ center - extent, center + extent };
+        }
+
+        Bvh bvh;
+        auto start = std::chrono::steady_clock::now();
+        bvh.build(boxes);
+        double buildTime = millisecondsSince(start);
+        float builtCost = bvh.cost();
+
+        std::vector<unsigned int> moved(count / 10);
+        for (unsigned int& object : moved) {
+            object = random() % count;
+            glm::vec3 move(offset(random), offset(random), offset(random));
+            boxes[object].min += move;
+            boxes[object].max += move;
+        }
+        start = std::chrono::steady_clock::now();
+        for (unsigned int object : moved)
+            bvh.update(object, boxes[object]);
+        double updateTime = millisecondsSince(start);
+        start = std::chrono::steady_clock::now();
+        bvh.refit(boxes);
+        double refitTime = millisecondsSince(start);
+
+        // cameras standing on the world looking along it
+        std::vector<Frustum> frustums;
+        for (int i = 0; i < frustumQueries; i++) {
+            glm::vec3 eye(position(random), 10.0f, position(random));
+            glm::vec3 forward(offset(random), -0.1f, offset(random));
+            frustums.emplace_back(glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 1000.0f) *
+                                  glm::lookAt(eye, eye + forward, glm::vec3(0.0f, 1.0f, 0.0f)));
+        }
+        std::vector<unsigned int> visible;
+        size_t visited = 0, found = 0;
+        start = std::chrono::steady_clock::now();
+        for (const Frustum& frustum : frustums) {
+            visible.clear();
+            visited += bvh.queryFrustum(frustum, visible);
+            found += visible.size();
+        }
+        double frustumTime = millisecondsSince(start) / frustumQueries;
+
+        BoundsArrays bounds;
+        for (const Aabb& box : boxes)
+            bounds.push(box.center(), glm::length(box.max - box.min) * 0.5f, (box.max - box.min) * 0.5f);
+        std::vector<unsigned char> flags;
+        size_t foundBrute = 0;
+        start = std::chrono::steady_clock::now();
+        for (const Frustum& frustum : frustums) {
+            cullBoxes(frustum, bounds, flags);
+            for (unsigned char flag : flags)
+                foundBrute += flag;
+        }
+        double bruteFrustumTime = millisecondsSince(start) / frustumQueries;
+        if (found != foundBrute) {
+            std::cout << "ERROR::BENCHMARK:: BVH and brute force frustum queries disagree" << std::endl;
+            return -1;
+        }
+
+        std::vector<glm::vec3> origins, directions;
+        for (int i = 0; i < rayQueries; i++) {
+            origins.emplace_back(position(random), 30.0f, position(random));
+            directions.push_back(glm::normalize(glm::vec3(offset(random), -0.5f, offset(random))));
+        }
+        size_t hits = 0;
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < rayQueries; i++) {
+            float distance = std::numeric_limits<float>::max();
+            hits += bvh.raycast(origins[i], directions[i], distance) != ~0u ? 1 : 0;
+        }
+        double rayTime = millisecondsSince(start) * 1000.0 / rayQueries;
+
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < checkedRays; i++) {
+            float distance = std::numeric_limits<float>::max();
+            bvh.raycast(origins[i], directions[i], distance);
+            float nearest = std::numeric_limits<float>::max();
+            glm::vec3 inverse = 1.0f / directions[i];
+            for (const Aabb& box : boxes) {
+                glm::vec3 near = (box.min - origins[i]) * inverse, far = (box.max - origins[i]) * inverse;
+                glm::vec3 entry = glm::min(near, far), exit = glm::max(near, far);
+                float enter = std::max({ entry.x, entry.y, entry.z, 0.0f });
+                if (enter <= std::min({ exit.x, exit.y, exit.z }) && enter < nearest)
+                    nearest = enter;
+            }
+            if (nearest != distance) {
+                std::cout << "ERROR::BENCHMARK:: BVH and brute force ray queries disagree" << std::endl;
+                return -1;
+            }
+        }
+        double bruteRayTime = millisecondsSince(start) * 1000.0 / checkedRays;
+
+        std::cout << "  " << count << " objects, " << bvh.nodeCount() << " nodes\n"
+                  << "    build:   " << buildTime << " ms, cost " << builtCost << "\n"
+                  << "    refit:   " << updateTime << " ms for " << moved.size() << " updates, " << refitTime
+                  << " ms full refit, cost " << bvh.cost() << "\n"
+                  << "    frustum: " << frustumTime << " ms, " << visited / frustumQueries << " nodes visited, "
+                  << found / frustumQueries << " visible (" << bruteFrustumTime << " ms testing every box)\n"
+                  << "    ray:     " << rayTime << " us, " << 100.0 * hits / rayQueries << "% hit (" << bruteRayTime
+                  << " us testing every box)" << std::endl;
+    }
+    return 0;
+}
+
+// software occlusion culling in a city of box shaped buildings seen from street level: the buildings nearest to the
+// camera are rasterized as occluders, then every object in the frustum is tested. Runs without a GPU. Hidden objects are
+// checked against rays from the camera to their corners and center, one that any ray reaches without hitting a
+// building counts as wrongly hidden (objects peeking out by less than a buffer pixel can be)
+int benchmarkOcclusion() {
+    const int blocks = 32;
+    const float blockSpacing = 20.0f;
+    const size_t objectCount = 100000;
+    const size_t occluderCount = 64;
+    const int runs = 10;
+
+    // unit cube, counter clockwise seen from outside
+    const std::vector<glm::vec3> cubePositions = { { -1, -1, -1 }, { 1, -1, -1 }, { 1, 1, -1 }, { -1, 1, -1 },
+                                                   { -1, -1, 1 },  { 1, -1, 1 },  { 1, 1, 1 },  { -1, 1, 1 } };
+    const std::vector<uint32_t> cubeIndices = { 0, 2, 1, 0, 3, 2, 4, 5, 6, 4, 6, 7, 0, 1, 5, 0, 5, 4,
+                                                3, 7, 6, 3, 6, 2, 0, 4, 7, 0, 7, 3, 1, 2, 6, 1, 6, 5 };
+
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> width(6.0f, 9.0f);
+    std::uniform_real_distribution<float> height(10.0f, 40.0f);
+    std::vector<Aabb> buildings;
+    std::vector<glm::mat4> buildingTransforms;
+    for (int z = 0; z < blocks; z++) {
+        for (int x = 0; x < blocks; x++) {
+            glm::vec3 half(width(random), 0.5f * height(random), width(random));
+            glm::vec3 center(x * blockSpacing, half.y, z * blockSpacing);
+            buildings.push_back(Aabb{ center - half, center + half });
+            buildingTransforms.push_back(glm::scale(glm::translate(glm::mat4(1.0f), center), half));
+        }
+    }
+    std::uniform_real_distribution<float> position(0.0f, blocks * blockSpacing);
+    std::uniform_real_distribution<float> size(0.25f, 1.0f);
+    std::vector<Aabb> objects(objectCount);
+    for (Aabb& object : objects) {
+        glm::vec3 half(size(random));
+        glm::vec3 center(position(random), half.y, position(random));
+        object = Aabb{ center - half, center + half };
+    }
+
+    // standing in a street between two rows of blocks, looking down it
+    glm::vec3 eye(0.5f * blockSpacing, 2.0f, 0.5f * blockSpacing);
+    glm::mat4 viewProjection = glm::perspective(glm::radians(60.0f), 800.0f / 600.0f, 0.1f, 1000.0f) *
+                               glm::lookAt(eye, eye + glm::vec3(1.0f, 0.0f, 0.35f), glm::vec3(0.0f, 1.0f, 0.0f));
+    Frustum frustum(viewProjection);
+
+    // occluders: the buildings in the frustum closest to the camera
+    std::vector<size_t> candidates;
+    for (size_t i = 0; i < buildings.size(); i++) {
+        if (frustum.intersectsBox(buildings[i].center(), (buildings[i].max - buildings[i].min) * 0.5f))
+            candidates.push_back(i);
+    }
+    size_t occluders = std::min(occluderCount, candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + occluders, candidates.end(), [&](size_t a, size_t b) {
+        return glm::length(buildings[a].center() - eye) < glm::length(buildings[b].center() - eye);
+    });
+    std::vector<Aabb> tested;
+    for (const Aabb& object : objects) {
+        if (frustum.intersectsBox(object.center(), (object.max - object.min) * 0.5f))
+            tested.push_back(object);
+    }
+
+    ThreadPool& pool = ThreadPool::shared();
+    OcclusionCuller culler;
+    std::vector<unsigned char> occluded;
+    double rasterizeTime = 0.0, testTime = 0.0;
+    for (int run = 0; run < runs; run++) {
+        auto start = std::chrono::steady_clock::now();
+        culler.beginFrame(viewProjection);
+        for (size_t i = 0; i < occluders; i++)
+            culler.addOccluder(cubePositions.data(), cubePositions.size(), cubeIndices.data(), cubeIndices.size(), buildingTransforms[candidates[i]]);
+        culler.rasterize(pool);
+        rasterizeTime += millisecondsSince(start);
+        start = std::chrono::steady_clock::now();
+        culler.testBoxes(tested, occluded, pool);
+        testTime += millisecondsSince(start);
+    }
+
+    Bvh buildingBvh;
+    buildingBvh.build(buildings);
+    size_t hidden = 0, wronglyHidden = 0;
+    for (size_t i = 0; i < tested.size(); i++) {
+        if (!occluded[i])
+            continue;
+        hidden++;
+        const Aabb& object = tested[i];
+        for (int corner = 0; corner < 9; corner++) {
+            glm::vec3 point = corner == 8 ? object.center()
+                                          : glm::vec3((corner & 1) ? object.max.x : object.min.x, (corner & 2) ? object.max.y : object.min.y,
+                                                      (corner & 4) ? object.max.z : object.min.z);
+            float distance = glm::length(point - eye);
+            if (buildingBvh.raycast(eye, (point - eye) / distance, distance) == ~0u) {
+                wronglyHidden++;
+                break;
+            }
+        }
+    }
+
+    std::cout << "BENCHMARK::OCCLUSION " << culler.width() << "x" << culler.height() << " depth buffer, " << occluders << " occluders ("
+              << culler.triangleCount() << " triangles), " << pool.size() + 1 << " threads, average of " << runs << " runs\n"
+              << "  rasterize: " << rasterizeTime / runs << " ms\n"
+              << "  test:      " << testTime / runs << " ms for " << tested.size() << " objects in the frustum\n"
+              << "  hidden:    " << hidden << " (" << 100.0 * hidden / std::max<size_t>(tested.size(), 1) << "%), "
+              << wronglyHidden << " of them reachable by a ray" << std::endl;
+    return 0;
+}
+
+// the import time reordering passes on a sphere whose triangles start out shuffled, the way they run on import:
+// vertex cache, overdraw, then vertex fetch. Runs without a GPU. Every pass has to keep the triangles (with their
+// winding), the cache pass mustn't raise the ACMR and the overdraw pass may raise it by at most its 5% threshold.
+// The fetch pass has to map the used vertices one to one onto new ones in the order the indices first use them
+int benchmarkOptimizer() {
+    const int rings = 256;
+    const int segments = 512;
+
+    std::vector<Vertex> vertices;
+    for (int r = 0; r <= rings; r++) {
+        for (int s = 0; s <= segments; s++) {
+            float theta = glm::pi<float>() * r / rings, phi = glm::two_pi<float>() * s / segments;
+            Vertex vertex{};
+            vertex.Position = glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+            vertex.Normal = vertex.Position;
+            vertex.TexCoords = glm::vec2(float(s) / segments, float(r) / rings);
+            vertices.push_back(vertex);
+        }
+    }
+    std::vector<std::array<unsigned int, 3>> triangles;
+    for (int r = 0; r < rings; r++) {
+        for (int s = 0; s < segments; s++) {
+            unsigned int a = r * (segments + 1) + s, b = a + segments + 1;
+            triangles.push_back({ a, b, a + 1 });
+            triangles.push_back({ a + 1, b, b + 1 });
+        }
+    }
+    std::mt19937 random(5);
+    std::shuffle(triangles.begin(), triangles.end(), random);
+    std::vector<unsigned int> indices;
+    for (const std::array<unsigned int, 3>& triangle : triangles)
+        indices.insert(indices.end(), triangle.begin(), triangle.end());
+    const std::vector<std::array<unsigned int, 3>> original = sortedTriangles(indices);
+
+    bool valid = true;
+    auto check = [&](bool passed, const char* what) {
+        if (!passed) {
+            std::cout << "ERROR::BENCHMARK:: " << what << std::endl;
+            valid = false;
+        }
+    };
+    float shuffled = analyzeVertexCache(indices, vertices.size()).acmr;
+    auto start = std::chrono::steady_clock::now();
+    optimizeVertexCache(indices, vertices.size());
+    double cacheTime = millisecondsSince(start);
+    float cached = analyzeVertexCache(indices, vertices.size()).acmr;
+    check(sortedTriangles(indices) == original, "Vertex cache pass changed the triangles");
+    check(cached <= shuffled, "Vertex cache pass raised the ACMR");
+
+    start = std::chrono::steady_clock::now();
+    optimizeOverdraw(indices, vertices);
+    double overdrawTime = millisecondsSince(start);
+    float overdrawn = analyzeVertexCache(indices, vertices.size()).acmr;
+    check(sortedTriangles(indices) == original, "Overdraw pass changed the triangles");
+    check(overdrawn <= cached * 1.05f, "Overdraw pass raised the ACMR by more than 5%");
+
+    const std::vector<Vertex> unfetched = vertices;
+    const std::vector<unsigned int> unfetchedIndices = indices;
+    start = std::chrono::steady_clock::now();
+    optimizeVertexFetch(vertices, indices);
+    double fetchTime = millisecondsSince(start);
+    // follow every index from the old vertex to the new one, the mapping has to be consistent both ways
+    const unsigned int unmapped = ~0u;
+    std::vector<unsigned int> forward(unfetched.size(), unmapped), backward(vertices.size(), unmapped);
+    unsigned int nextFirstUse = 0;
+    bool bijective = indices.size() == unfetchedIndices.size(), inOrder = true, sameVertices = true;
+    for (size_t i = 0; i < indices.size() && bijective; i++) {
+        unsigned int from = unfetchedIndices[i], to = indices[i];
+        if (to >= vertices.size()) {
+            bijective = false;
+            break;
+        }
+        if (forward[from] == unmapped && backward[to] == unmapped) {
+            forward[from] = to;
+            backward[to] = from;
+            inOrder = inOrder && to == nextFirstUse++;
+            sameVertices = sameVertices && std::memcmp(&vertices[to], &unfetched[from], sizeof(Vertex)) == 0;
+        }
+        bijective = forward[from] == to && backward[to] == from;
+    }
+    check(bijective && nextFirstUse == vertices.size(), "Vertex fetch remap isn't one to one or indices are out of range");
+    check(inOrder, "Vertex fetch pass didn't order vertices by first use");
+    check(sameVertices, "Vertex fetch pass changed vertex contents");
+
+    std::cout << "BENCHMARK::OPTIMIZER sphere of " << original.size() << " triangles, " << unfetched.size() << " vertices\n"
+              << "  shuffled ACMR:  " << shuffled << "\n"
+              << "  vertex cache:   " << cached << " ACMR, " << cacheTime << " ms\n"
+              << "  overdraw:       " << overdrawn << " ACMR (" << 100.0f * (overdrawn / cached - 1.0f) << "% more), " << overdrawTime << " ms\n"
+              << "  vertex fetch:   " << vertices.size() << " vertices used, " << fetchTime << " ms" << std::endl;
+    return valid ? 0 : -1;
+}
+
+// model view projection and normal matrices of many objects with random rotations, non-uniform scales and
+// translations, SIMD against glm one object at a time. Products have to match exactly, normal matrices (cross
+// products against glm's inverse) to a relative 1e-4
+int benchmarkMatrices() {
+    const size_t count = 1000000;
+    const int runs = 10;
+
+    std::mt19937 random(11);
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> scale(0.2f, 5.0f);
+    std::uniform_real_distribution<float> angle(0.0f, glm::radians(360.0f));
+    std::vector<glm::mat4> models(count);
+    for (glm::mat4& model : models) {
+        model = glm::translate(glm::mat4(1.0f), glm::vec3(position(random), position(random), position(random)));
+        model = glm::rotate(model, angle(random), glm::normalize(glm::vec3(position(random), position(random), position(random)) + glm::vec3(0.0f, 0.0f, 0.01f)));
+        model = glm::scale(model, glm::vec3(scale(random), scale(random), scale(random)));
+    }
+    glm::mat4 viewProjection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 1000.0f) *
+                               glm::lookAt(glm::vec3(0.0f, 50.0f, 200.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+    auto best = [&](auto compute) {
+        double fastest = 0.0;
+        for (int i = 0; i < runs; i++) {
+            auto start = std::chrono::steady_clock::now();
+            compute();
+            double elapsed = millisecondsSince(start);
+            if (i == 0 || elapsed < fastest)
+                fastest = elapsed;
+        }
+        return fastest;
+    };
+    std::vector<glm::mat4> matrices(count), referenceMatrices(count);
+    std::vector<NormalMatrix> normals(count), referenceNormals(count);
+    double productScalar = best([&]() { modelViewProjectionsScalar(viewProjection, models.data(), count, referenceMatrices.data()); });
+    double productSimd = best([&]() { modelViewProjections(viewProjection, models.data(), count, matrices.data()); });
+    double normalScalar = best([&]() { normalMatricesScalar(models.data(), count, referenceNormals.data()); });
+    double normalSimd = best([&]() { normalMatrices(models.data(), count, normals.data()); });
+
+    for (size_t i = 0; i < count; i++) {
+        if (matrices[i] != referenceMatrices[i]) {
+            std::cout << "ERROR::BENCHMARK:: SIMD and scalar model view projection matrices disagree" << std::endl;
+            return -1;
+        }
+        for (int column = 0; column < 3; column++) {
+            glm::vec4 difference = normals[i].columns[column] - referenceNormals[i].columns[column];
+            float magnitude = glm::length(referenceNormals[i].columns[column]);
+            if (glm::length(difference) > 1.0e-4f * magnitude || normals[i].columns[column].w != 0.0f) {
+                std::cout << "ERROR::BENCHMARK:: SIMD and scalar normal matrices disagree" << std::endl;
+                return -1;
+            }
+        }
+    }
+
+    std::cout << "BENCHMARK::MATRICES " << count << " objects, best of " << runs << " runs\n"
+              << "  model view projection: " << productSimd << " ms SIMD, " << productScalar << " ms scalar ("
+              << productScalar / productSimd << "x)\n"
+              << "  normal matrix:         " << normalSimd << " ms SIMD, " << normalScalar << " ms scalar ("
+              << normalScalar / normalSimd << "x)" << std::endl;
+    return 0;
+}
+
+// the stress scene drawn copy by copy (DrawConstants and one draw call per mesh and copy) against one instanced draw
+// per mesh, against Model::Draw per copy which the shared queue merges into batches without culling, and against
+// the render queue merging per copy submissions into batches (which also culls and picks levels of detail). Submit is the CPU time until the last draw call returned, frame time also waits for the GPU to finish
+int benchmarkInstancing() {
+    const std::string path = "./assets/backpack/backpack.obj";
+    const unsigned int copies = 10000;
+    const int frames = 20;
+
+    Model model(path);
+    if (model.meshes.empty())
+        return -1;
+    Shader shader("./shaders/model_shader.vert", "./shaders/model_shader.frag");
+    shader.use();
+    UniformRing& ring = UniformRing::shared();
+    RenderView view;
+    view.cameraPosition = glm::vec3(0.0f, 150.0f, 250.0f);
+    view.fovY = glm::radians(45.0f);
+    view.viewportHeight = 600.0f;
+    view.projection = glm::perspective(view.fovY, 800.0f / 600.0f, 0.1f, 1000.0f);
+    view.view = glm::lookAt(view.cameraPosition, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    view.frustum = Frustum(view.projection * view.view);
+    RenderQueue queue;
+    std::vector<glm::mat4> transforms = stressSceneTransforms(copies);
+
+    struct Result {
+        double submit = 0.0, frame = 0.0;
+        unsigned long long drawCalls = 0, batches = 0;
+    };
+    auto run = [&](auto draw) {
+        Result result;
+        glFinish();
+        for (int i = 0; i < frames; i++) {
+            RenderStats::current().beginFrame();
+            ring.beginFrame();
+            auto start = std::chrono::steady_clock::now();
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            ring.push(GL_UNIFORM_BUFFER, CAMERA_BLOCK_BINDING, CameraConstants(view));
+            draw();
+            result.submit += millisecondsSince(start);
+            ring.endFrame();
+            glFinish();
+            result.frame += millisecondsSince(start);
+            result.drawCalls = RenderStats::current().frame.drawCalls;
+            result.batches = RenderStats::current().frame.batches;
+        }
+        result.submit /= frames;
+        result.frame /= frames;
+        return result;
+    };
+    std::vector<glm::mat4> matrices(transforms.size());
+    std::vector<NormalMatrix> normals(transforms.size());
+    Result perCopy = run([&]() {
+        modelViewProjections(view.projection * view.view, transforms.data(), transforms.size(), matrices.data());
+        normalMatrices(transforms.data(), transforms.size(), normals.data());
+        for (size_t i = 0; i < transforms.size(); i++) {
+            ring.push(GL_UNIFORM_BUFFER, DRAW_BLOCK_BINDING, DrawConstants(transforms[i], matrices[i], normals[i]));
+            // straight to the meshes, Model::Draw would batch
+            for (Mesh& mesh : model.meshes)
+                mesh.Draw(shader);
+        }
+    });
+    Result instanced = run([&]() { model.DrawInstanced(shader, view, transforms.data(), transforms.size()); });
+    Result batched = run([&]() {
+        for (const glm::mat4& transform : transforms)
+            model.Draw(shader, transform);
+        RenderQueue::shared().flush(view);
+    });
+    Result queued = run([&]() {
+        for (const glm::mat4& transform : transforms)
+            model.Submit(queue, shader, view, transform);
+        queue.flush(view);
+    });
+
+    std::cout << "BENCHMARK::INSTANCING " << copies << " copies of " << path << ", " << frames << " frames per path\n"
+              << "  per copy:  " << perCopy.frame << " ms frame, " << perCopy.submit << " ms submit, " << perCopy.drawCalls << " draw calls\n"
+              << "  instanced: " << instanced.frame << " ms frame, " << instanced.submit << " ms submit, " << instanced.drawCalls << " draw calls\n"
+              << "  batched:   " << batched.frame << " ms frame, " << batched.submit << " ms submit, " << batched.drawCalls << " draw calls, " << batched.batches << " batches\n"
+              << "  queued:    " << queued.frame << " ms frame, " << queued.submit << " ms submit, " << queued.drawCalls << " draw calls, " << queued.batches << " batches\n"
+              << "  speedup:   " << perCopy.frame / instanced.frame << "x frame, " << perCopy.submit / instanced.submit << "x submit" << std::endl;
+    return 0;
+}
+
+// vertex stage cost of matrices derived per vertex (shader_vertex_math.vert, what shader.vert used to do) against
+// matrices computed on the CPU per draw (shader.vert), drawing the full resolution backpack many times into a one
+// pixel viewport so fragments cost next to nothing. Both read the same constants, only the vertex shaders differ
+int benchmarkTransforms() {
+    const std::string path = "./assets/backpack/backpack.obj";
+    const int copies = 100;
+    const int frames = 10;
+
+    Model model(path);
+    if (model.meshes.empty())
+        return -1;
+    Shader perVertex("./shaders/shader_vertex_math.vert", "./shaders/shader.frag");
+    Shader perDraw("./shaders/shader.vert", "./shaders/shader.frag");
+    UniformRing& ring = UniformRing::shared();
+    RenderView view;
+    view.cameraPosition = glm::vec3(0.0f, 0.0f, 30.0f);
+    view.projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+    view.view = glm::lookAt(view.cameraPosition, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    view.frustum = Frustum(view.projection * view.view);
+    std::vector<glm::mat4> transforms = stressSceneTransforms(copies);
+    std::vector<glm::mat4> matrices(transforms.size());
+    std::vector<NormalMatrix> normals(transforms.size());
+    unsigned long long vertices = 0;
+    for (const Mesh& mesh : model.meshes)
+        vertices += mesh.lods[0].indexCount;
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glViewport(0, 0, 1, 1);
+    auto run = [&](Shader& shader) {
+        shader.use();
+        glFinish();
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < frames; i++) {
+            ring.beginFrame();
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            ring.push(GL_UNIFORM_BUFFER, CAMERA_BLOCK_BINDING, CameraConstants(view));
+            modelViewProjections(view.projection * view.view, transforms.data(), transforms.size(), matrices.data());
+            normalMatrices(transforms.data(), transforms.size(), normals.data());
+            for (size_t copy = 0; copy < transforms.size(); copy++) {
+                ring.push(GL_UNIFORM_BUFFER, DRAW_BLOCK_BINDING, DrawConstants(transforms[copy], matrices[copy], normals[copy]));
+                for (Mesh& mesh : model.meshes) {
+                    mesh.applyVertexDecoding();
+                    mesh.DrawLevel(0);
+                }
+            }
+            ring.endFrame();
+            glFinish();
+        }
+        return millisecondsSince(start) / frames;
+    };
+    double perVertexTime = run(perVertex);
+    double perDrawTime = run(perDraw);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+    std::cout << "BENCHMARK::TRANSFORMS " << copies << " copies of " << path << " at full resolution, "
+              << vertices * copies << " vertices per frame, average of " << frames << " frames\n"
+              << "  matrices per vertex: " << perVertexTime << " ms\n"
+              << "  matrices per draw:   " << perDrawTime << " ms\n"
+              << "  speedup:             " << perVertexTime / perDrawTime << "x" << std::endl;
+    return 0;
+}
+
+// clustered light assignment for growing numbers of lights over a wide scene, on the thread pool with SSE against one
+// thread testing one light at a time. Both have to produce the same clusters and index lists
+int benchmarkLightClusters() {
+    const unsigned int counts[] = { 1024, 4096, 16384 };
+    const int runs = 20;
+    const float extent = 100.0f;
+
+    RenderView view;
+    view.cameraPosition = glm::vec3(0.0f, 10.0f, 60.0f);
+    view.fovY = glm::radians(45.0f);
+    view.viewportHeight = 600.0f;
+    view.projection = glm::perspective(view.fovY, 800.0f / 600.0f, 0.1f, 200.0f);
+    view.view = glm::lookAt(view.cameraPosition, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    view.frustum = Frustum(view.projection * view.view);
+    const glm::vec2 viewport(800.0f, 600.0f);
+    ThreadPool& pool = ThreadPool::shared();
+    LightClusters clusters, reference;
+    std::vector<PointLight> lights;
+
+    std::cout << "BENCHMARK::LIGHTS " << clusters.clusterCount() << " clusters, best of " << runs << " runs, "
+              << pool.size() + 1 << " threads\n";
+    for (unsigned int count : counts) {
+        lightSceneLights(count, extent, 0.0f, lights);
+        auto best = [&](auto build) {
+            double fastest = 0.0;
+            for (int i = 0; i < runs; i++) {
+                auto start = std::chrono::steady_clock::now();
+                build();
+                double elapsed = millisecondsSince(start);
+                if (i == 0 || elapsed < fastest)
+                    fastest = elapsed;
+            }
+            return fastest;
+        };
+        double scalar = best([&]() { reference.buildScalar(view, viewport, lights); });
+        double simd = best([&]() { clusters.build(view, viewport, lights, pool); });
+
+        if (clusters.lightIndices() != reference.lightIndices()) {
+            std::cout << "ERROR::BENCHMARK:: SIMD and scalar light assignment disagree" << std::endl;
+            return -1;
+        }
+        size_t fullest = 0, occupied = 0;
+        for (size_t i = 0; i < clusters.clusterCount(); i++) {
+            const ClusterRange& range = clusters.clusters()[i];
+            const ClusterRange& expected = reference.clusters()[i];
+            if (range.offset != expected.offset || range.count != expected.count) {
+                std::cout << "ERROR::BENCHMARK:: SIMD and scalar light assignment disagree" << std::endl;
+                return -1;
+            }
+            fullest = std::max<size_t>(fullest, range.count);
+            occupied += range.count > 0;
+        }
+        std::cout << "  " << count << " lights: " << simd << " ms SIMD, " << scalar << " ms scalar (" << scalar / simd << "x), "
+                  << clusters.lightIndices().size() << " assignments, "
+                  << (occupied > 0 ? double(clusters.lightIndices().size()) / occupied : 0.0) << " lights per lit cluster, "
+                  << fullest << " in the fullest\n";
+    }
+    std::cout << std::flush;
+    return 0;
+}
+
+// the light scene shaded forward (every fragment drawn loops over its cluster's lights, also the ones drawn over later)
+// against deferred (the geometry pass writes the G-buffer, one full screen pass lights every pixel once) at growing
+// light counts, seen from inside the grid of copies so they overlap. Frame time includes assigning the lights to
+// clusters and waits for the GPU to finish
+int benchmarkShading() {
+    const std::string path = "./assets/backpack/backpack.obj";
+    const unsigned int copies = 400;
+    const unsigned int counts[] = { 256, 1024, 4096 };
+    const int frames = 20;
+
+    if (!LightClusters::supported() || !DeferredRenderer::supported()) {
+        std::cout << "ERROR::BENCHMARK:: Clustered and deferred shading need OpenGL 4.3" << std::endl;
+        return -1;
+    }
+    Model model(path);
+    if (model.meshes.empty())
+        return -1;
+    Shader forward("./shaders/model_lit.vert", "./shaders/model_clustered.frag", "./shaders/clustered_lighting.glsl");
+    DeferredRenderer deferred;
+    applyLightSceneLighting(forward);
+    applyLightSceneLighting(deferred.geometryShader());
+    applyLightSceneLighting(deferred.lightingShader());
+    UniformRing& ring = UniformRing::shared();
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    RenderView view;
+    view.cameraPosition = glm::vec3(0.0f, 4.0f, 12.0f);
+    view.fovY = glm::radians(45.0f);
+    view.viewportHeight = float(viewport[3]);
+    view.projection = glm::perspective(view.fovY, float(viewport[2]) / float(viewport[3]), 0.1f, 100.0f);
+    view.view = glm::lookAt(view.cameraPosition, glm::vec3(0.0f, 0.0f, -20.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    view.frustum = Frustum(view.projection * view.view);
+    RenderQueue queue;
+    LightClusters clusters;
+    std::vector<glm::mat4> transforms = stressSceneTransforms(copies);
+    std::vector<PointLight> lights;
+
+    auto run = [&](auto draw) {
+        glFinish();
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < frames; i++) {
+            RenderStats::current().beginFrame();
+            ring.beginFrame();
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            ring.push(GL_UNIFORM_BUFFER, CAMERA_BLOCK_BINDING, CameraConstants(view));
+            clusters.build(view, glm::vec2(viewport[2], viewport[3]), lights, ThreadPool::shared());
+            clusters.bind(ring, lights);
+            draw();
+            ring.endFrame();
+            glFinish();
+        }
+        return millisecondsSince(start) / frames;
+    };
+    std::cout << "BENCHMARK::SHADING " << copies << " copies of " << path << ", " << viewport[2] << "x" << viewport[3]
+              << ", average of " << frames << " frames\n";
+    for (unsigned int count : counts) {
+        lightSceneLights(count, 2.0f * std::sqrt(float(copies)), 0.0f, lights);
+        double forwardTime = run([&]() {
+            for (const glm::mat4& transform : transforms)
+                model.Submit(queue, forward, view, transform);
+            queue.flush(view);
+        });
+        double deferredTime = run([&]() {
+            deferred.beginGeometry(viewport[2], viewport[3]);
+            for (const glm::mat4& transform : transforms)
+                model.Submit(queue, deferred.geometryShader(), view, transform);
+            queue.flush(view);
+            deferred.resolve();
+        });
+        std::cout << "  " << count << " lights: " << forwardTime << " ms forward, " << deferredTime << " ms deferred ("
+                  << forwardTime / deferredTime << "x), " << clusters.lightIndices().size() << " light cluster pairs\n";
+    }
+    std::cout << std::flush;
+    return 0;
+}
+
+}
+
+std::vector<glm::mat4> stressSceneTransforms(unsigned int count) {
+    const float spacing = 4.0f;
+    unsigned int side = static_cast<unsigned int>(std::ceil(std::sqrt(float(count))));
+    std::vector<glm::mat4> transforms;
+    transforms.reserve(count);
+    for (unsigned int i = 0; i < count; i++) {
+        float x = (float(i % side) - 0.5f * (side - 1)) * spacing;
+        float z = (float(i / side) - 0.5f * (side - 1)) * spacing;
+        transforms.push_back(glm::translate(glm::mat4(1.0f), glm::vec3(x, 0.0f, z)));
+    }
+    return transforms;
+}
+
+void lightSceneLights(unsigned int count, float extent, float time, std::vector<PointLight>& lights) {
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    lights.resize(count);
+    for (unsigned int i = 0; i < count; i++) {
+        glm::vec3 center, color;
+        center.x = (2.0f * unit(random) - 1.0f) * extent;
+        center.y = 0.5f + 2.5f * unit(random);
+        center.z = (2.0f * unit(random) - 1.0f) * extent;
+        float orbit = 1.0f + 3.0f * unit(random);
+        float speed = 3.0f * unit(random) - 1.5f;
+        float angle = 6.2831853f * unit(random) + speed * time;
+        float radius = 2.0f + 4.0f * unit(random);
+        color.r = unit(random);
+        color.g = unit(random);
+        color.b = unit(random);
+        // saturated colors, bright enough to light the whole radius against the inverse square falloff
+        color /= std::max(std::max(color.r, color.g), std::max(color.b, 0.001f));
+        lights[i] = PointLight{ center + orbit * glm::vec3(std::cos(angle), 0.0f, std::sin(angle)), radius, color * (0.5f * radius * radius), 0.0f };
+    }
+}
+
+void applyLightSceneLighting(Shader& shader) {
+    shader.use();
+    shader.setFloat("shininess", 32.0f);
+    shader.setVec3("ambientColor", glm::vec3(0.02f));
+    shader.setVec3("sunDirection", glm::normalize(glm::vec3(-0.2f, -1.0f, -0.3f)));
+    shader.setVec3("sunColor", glm::vec3(0.05f));
+}
+
+bool isCpuBenchmark(const std::string& name) {
+    return name == "clusters" || name == "cull" || name == "bvh" || name == "occlusion" || name == "optimizer" || name == "matrices" || name == "lights";
+}
+
+int runBenchmark(const std::string& name) {
+    if (name == "load")
+        return benchmarkModelLoad();
+    if (name == "clusters")
+        return benchmarkClusterCulling();
+    if (name == "uniforms")
+        return benchmarkUniforms();
+    if (name == "instancing")
+        return benchmarkInstancing();
+    if (name == "cull")
+        return benchmarkFrustumCulling();
+    if (name == "bvh")
+        return benchmarkBvh();
+    if (name == "occlusion")
+        return benchmarkOcclusion();
+    if (name == "optimizer")
+        return benchmarkOptimizer();
+    if (name == "matrices")
+        return benchmarkMatrices();
+    if (name == "transforms")
+        return benchmarkTransforms();
+    if (name == "lights")
+        return benchmarkLightClusters();
+    if (name == "shading")
+        return benchmarkShading();
+    std::cout << "ERROR::BENCHMARK:: Unknown benchmark: " << name << std::endl;
+    return -1;
+}
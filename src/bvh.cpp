@@ -0,0 +1,325 @@
+#include <bvh.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+const int SAH_BINS = 16;
+// testing a few objects costs about as much as another level of nodes, smaller leaves aren't split
+const unsigned int MIN_SPLIT_OBJECTS = 5;
+// leaves never hold more objects than this, even where the heuristic would rather stop
+const unsigned int MAX_LEAF_OBJECTS = 8;
+// cost of visiting a node relative to testing an object
+const float TRAVERSAL_COST = 1.0f;
+const unsigned int NO_OBJECT = ~0u;
+// past this depth nodes are split at their median object, which keeps trees shallow enough for the query stacks
+const unsigned int MAX_SAH_DEPTH = 32;
+const unsigned int MAX_DEPTH = 64;
+
+Aabb emptyBox() {
+    const float infinity = std::numeric_limits<float>::infinity();
+    return Aabb{ glm::vec3(infinity), glm::vec3(-infinity) };
+}
+
+// whether the ray hits the box before the limit, and the distance where it enters it
+bool rayHits(const Aabb& box, glm::vec3 origin, glm::vec3 inverseDirection, float limit, float& enter) {
+    glm::vec3 near = (box.min - origin) * inverseDirection;
+    glm::vec3 far = (box.max - origin) * inverseDirection;
+    glm::vec3 entry = glm::min(near, far), exit = glm::max(near, far);
+    enter = std::max({ entry.x, entry.y, entry.z, 0.0f });
+    return enter <= std::min({ exit.x, exit.y, exit.z, limit });
+}
+
+}
+
+Aabb Aabb::transform(const Aabb& box, const glm::mat4& matrix) {
+    // the corners' extent along each axis is the absolute matrix times the half size
+    glm::vec3 center = glm::vec3(matrix * glm::vec4(box.center(), 1.0f));
+    glm::vec3 half = (box.max - box.min) * 0.5f;
+    glm::vec3 extent = glm::abs(glm::vec3(matrix[0])) * half.x + glm::abs(glm::vec3(matrix[1])) * half.y + glm::abs(glm::vec3(matrix[2])) * half.z;
+    return Aabb{ center - extent, center + extent };
+}
+
+struct Bvh::BuildObject {
+    Aabb box;
+    glm::vec3 center;
+    unsigned int object;
+};
+
+void Bvh::build(const std::vector<Aabb>& objectBoxes) {
+    nodes.clear();
+    boxes.resize(objectBoxes.size());
+    objects.resize(objectBoxes.size());
+    objectSlot.resize(objectBoxes.size());
+    objectLeaf.assign(objectBoxes.size(), 0);
+    if (objectBoxes.empty())
+        return;
+
+    // the objects are partitioned along with their boxes, reading those through the object indices misses the
+    // cache on nearly every object of large scenes
+    std::vector<BuildObject> build(objectBoxes.size());
+    Aabb bounds = emptyBox();
+    for (size_t i = 0; i < objectBoxes.size(); i++) {
+        build[i] = BuildObject{ objectBoxes[i], objectBoxes[i].center(), static_cast<unsigned int>(i) };
+        bounds = Aabb::merge(bounds, objectBoxes[i]);
+    }
+    // a binary tree with at least one object per leaf has fewer than twice as many nodes as objects
+    nodes.reserve(2 * objectBoxes.size());
+    nodes.push_back(Node{ bounds, 0, 0, static_cast<unsigned int>(objectBoxes.size()), 0 });
+    subdivide(build);
+    for (size_t i = 0; i < build.size(); i++) {
+        boxes[i] = build[i].box;
+        objects[i] = build[i].object;
+        objectSlot[build[i].object] = static_cast<unsigned int>(i);
+    }
+}
+
+Aabb Bvh::leafBounds(const Node& node) const {
+    Aabb bounds = emptyBox();
+    for (unsigned int i = node.first; i < node.first + node.count; i++)
+        bounds = Aabb::merge(bounds, boxes[i]);
+    return bounds;
+}
+
+void Bvh::subdivide(std::vector<BuildObject>& build) {
+    struct Bin {
+        Aabb bounds;
+        unsigned int count;
+    };
+    auto rangeBounds = [&](unsigned int first, unsigned int last) {
+        Aabb bounds = emptyBox();
+        for (unsigned int i = first; i < last; i++)
+            bounds = Aabb::merge(bounds, build[i].box);
+        return bounds;
+    };
+    // nodes to split and their depth
+    std::vector<std::pair<unsigned int, unsigned int>> pending{ { 0, 0 } };
+    while (!pending.empty()) {
+        unsigned int index = pending.back().first, depth = pending.back().second;
+        pending.pop_back();
+        Node node = nodes[index];
+        unsigned int end = node.first + node.count;
+        for (unsigned int i = node.first; i < end; i++)
+            objectLeaf[build[i].object] = index;
+        if (node.count < MIN_SPLIT_OBJECTS)
+            continue;
+
+        Aabb centers = emptyBox();
+        for (unsigned int i = node.first; i < end; i++)
+            centers = Aabb{ glm::min(centers.min, build[i].center), glm::max(centers.max, build[i].center) };
+
+        // every object goes into a bin on all three axes in one pass
+        Bin bins[3][SAH_BINS];
+        for (auto& axisBins : bins) {
+            for (Bin& bin : axisBins)
+                bin = Bin{ emptyBox(), 0 };
+        }
+        glm::vec3 size = centers.max - centers.min;
+        glm::vec3 scale(size.x > 0.0f ? SAH_BINS / size.x : 0.0f, size.y > 0.0f ? SAH_BINS / size.y : 0.0f, size.z > 0.0f ? SAH_BINS / size.z : 0.0f);
+        for (unsigned int i = node.first; i < end; i++) {
+            glm::vec3 position = (build[i].center - centers.min) * scale;
+            for (int axis = 0; axis < 3; axis++) {
+                Bin& bin = bins[axis][std::min(SAH_BINS - 1, static_cast<int>(position[axis]))];
+                bin.bounds = Aabb::merge(bin.bounds, build[i].box);
+                bin.count++;
+            }
+        }
+
+        // cheapest split between bins on any axis, costs relative to testing every object of the node
+        float bestCost = std::numeric_limits<float>::infinity();
+        int bestAxis = -1, bestSplit = 0;
+        float parentArea = std::max(node.bounds.surfaceArea(), std::numeric_limits<float>::min());
+        for (int axis = 0; axis < 3; axis++) {
+            if (size[axis] <= 0.0f)
+                continue;
+            // areas and counts left of every split from one sweep, right of it from the other
+            float leftArea[SAH_BINS - 1];
+            unsigned int leftCount[SAH_BINS - 1];
+            Aabb left = emptyBox();
+            unsigned int count = 0;
+            for (int i = 0; i < SAH_BINS - 1; i++) {
+                left = Aabb::merge(left, bins[axis][i].bounds);
+                count += bins[axis][i].count;
+                leftArea[i] = count > 0 ? left.surfaceArea() : 0.0f;
+                leftCount[i] = count;
+            }
+            Aabb right = emptyBox();
+            count = 0;
+            for (int i = SAH_BINS - 1; i > 0; i--) {
+                right = Aabb::merge(right, bins[axis][i].bounds);
+                count += bins[axis][i].count;
+                if (count == 0 || leftCount[i - 1] == 0)
+                    continue;
+                float cost = TRAVERSAL_COST + (leftArea[i - 1] * leftCount[i - 1] + right.surfaceArea() * count) / parentArea;
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = i;
+                }
+            }
+        }
+
+        unsigned int middle;
+        Aabb leftBounds, rightBounds;
+        if (bestAxis < 0 || depth >= MAX_SAH_DEPTH) {
+            // every center in the same spot, or too deep: halve the objects along the longest axis
+            if (node.count <= MAX_LEAF_OBJECTS && (bestAxis < 0 || bestCost >= float(node.count)))
+                continue;
+            int axis = size.x >= size.y && size.x >= size.z ? 0 : (size.y >= size.z ? 1 : 2);
+            middle = node.first + node.count / 2;
+            std::nth_element(build.begin() + node.first, build.begin() + middle, build.begin() + end,
+                             [&](const BuildObject& a, const BuildObject& b) { return a.center[axis] < b.center[axis]; });
+            leftBounds = rangeBounds(node.first, middle);
+            rightBounds = rangeBounds(middle, end);
+        } else {
+            if (bestCost >= float(node.count) && node.count <= MAX_LEAF_OBJECTS)
+                continue;
+            auto split = std::partition(build.begin() + node.first, build.begin() + end, [&](const BuildObject& object) {
+                return std::min(SAH_BINS - 1, static_cast<int>((object.center[bestAxis] - centers.min[bestAxis]) * scale[bestAxis])) < bestSplit;
+            });
+            middle = static_cast<unsigned int>(split - build.begin());
+            // the children's boxes are their bins'
+            leftBounds = rightBounds = emptyBox();
+            for (int i = 0; i < SAH_BINS; i++) {
+                Aabb& side = i < bestSplit ? leftBounds : rightBounds;
+                side = Aabb::merge(side, bins[bestAxis][i].bounds);
+            }
+        }
+
+        unsigned int left = static_cast<unsigned int>(nodes.size());
+        nodes.push_back(Node{ leftBounds, 0, node.first, middle - node.first, index });
+        nodes.push_back(Node{ rightBounds, 0, middle, end - middle, index });
+        nodes[index].left = left;
+        pending.push_back({ left, depth + 1 });
+        pending.push_back({ left + 1, depth + 1 });
+    }
+}
+
+void Bvh::update(unsigned int object, const Aabb& box) {
+    boxes[objectSlot[object]] = box;
+    unsigned int index = objectLeaf[object];
+    Aabb bounds = leafBounds(nodes[index]);
+    while (true) {
+        Node& node = nodes[index];
+        if (node.bounds.min == bounds.min && node.bounds.max == bounds.max)
+            return;
+        node.bounds = bounds;
+        if (index == 0)
+            return;
+        index = node.parent;
+        const Node& parent = nodes[index];
+        bounds = Aabb::merge(nodes[parent.left].bounds, nodes[parent.left + 1].bounds);
+    }
+}
+
+void Bvh::refit(const std::vector<Aabb>& objectBoxes) {
+    for (size_t i = 0; i < objects.size(); i++)
+        boxes[i] = objectBoxes[objects[i]];
+    // children are always created after their parent, so walking backwards sees them first
+    for (size_t i = nodes.size(); i-- > 0;) {
+        Node& node = nodes[i];
+        node.bounds = node.left == 0 ? leafBounds(node) : Aabb::merge(nodes[node.left].bounds, nodes[node.left + 1].bounds);
+    }
+}
+
+size_t Bvh::queryFrustum(const Frustum& frustum, std::vector<unsigned int>& visible) const {
+    if (nodes.empty())
+        return 0;
+    struct Pending {
+        unsigned int node;
+        // planes the node isn't known to be fully inside of yet
+        unsigned int planes;
+    };
+    Pending stack[MAX_DEPTH + 1];
+    unsigned int size = 0;
+    stack[size++] = Pending{ 0, 0x3f };
+    size_t visited = 0;
+    while (size > 0) {
+        Pending pending = stack[--size];
+        const Node& node = nodes[pending.node];
+        visited++;
+
+        glm::vec3 center = node.bounds.center();
+        glm::vec3 extent = (node.bounds.max - node.bounds.min) * 0.5f;
+        unsigned int planes = pending.planes;
+        bool outside = false;
+        for (int i = 0; i < 6 && !outside; i++) {
+            if (!(planes & (1u << i)))
+                continue;
+            const glm::vec4& plane = frustum.planes[i];
+            float reach = glm::dot(glm::abs(glm::vec3(plane)), extent);
+            float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+            if (distance < -reach)
+                outside = true;
+            else if (distance >= reach)
+                planes &= ~(1u << i);
+        }
+        if (outside)
+            continue;
+        // fully inside, so is everything below it
+        if (planes == 0) {
+            visible.insert(visible.end(), objects.begin() + node.first, objects.begin() + node.first + node.count);
+            continue;
+        }
+        if (node.left == 0) {
+            for (unsigned int i = node.first; i < node.first + node.count; i++) {
+                const Aabb& box = boxes[i];
+                if (frustum.intersectsBox(box.center(), (box.max - box.min) * 0.5f))
+                    visible.push_back(objects[i]);
+            }
+            continue;
+        }
+        stack[size++] = Pending{ node.left, planes };
+        stack[size++] = Pending{ node.left + 1, planes };
+    }
+    return visited;
+}
+
+unsigned int Bvh::raycast(glm::vec3 origin, glm::vec3 direction, float& distance) const {
+    if (nodes.empty())
+        return NO_OBJECT;
+    glm::vec3 inverseDirection = 1.0f / direction;
+    unsigned int hit = NO_OBJECT;
+    unsigned int stack[MAX_DEPTH + 1];
+    unsigned int size = 0;
+    float entry;
+    if (rayHits(nodes[0].bounds, origin, inverseDirection, distance, entry))
+        stack[size++] = 0;
+    while (size > 0) {
+        const Node& node = nodes[stack[--size]];
+        if (node.left == 0) {
+            for (unsigned int i = node.first; i < node.first + node.count; i++) {
+                if (rayHits(boxes[i], origin, inverseDirection, distance, entry) && entry < distance) {
+                    distance = entry;
+                    hit = objects[i];
+                }
+            }
+            continue;
+        }
+        // nearer child last so it's visited first and shortens the ray for the other one
+        float nearEntry, farEntry;
+        bool nearHit = rayHits(nodes[node.left].bounds, origin, inverseDirection, distance, nearEntry);
+        bool farHit = rayHits(nodes[node.left + 1].bounds, origin, inverseDirection, distance, farEntry);
+        unsigned int nearChild = node.left, farChild = node.left + 1;
+        if (farHit && (!nearHit || farEntry < nearEntry)) {
+            std::swap(nearChild, farChild);
+            std::swap(nearHit, farHit);
+        }
+        if (farHit)
+            stack[size++] = farChild;
+        if (nearHit)
+            stack[size++] = nearChild;
+    }
+    return hit;
+}
+
+float Bvh::cost() const {
+    if (nodes.empty())
+        return 0.0f;
+    float total = 0.0f;
+    for (const Node& node : nodes)
+        total += node.bounds.surfaceArea() * (node.left == 0 ? float(node.count) : TRAVERSAL_COST);
+    return total / std::max(nodes[0].bounds.surfaceArea(), std::numeric_limits<float>::min());
+}
@@ -0,0 +1,100 @@
+#include "glad/glad.h"
+#include <deferred_renderer.hpp>
+#include <gl_state.hpp>
+#include <render_stats.hpp>
+
+#include <iostream>
+
+namespace {
+
+// texture units the lighting pass reads the G-buffer from
+const int ALBEDO_SPECULAR_UNIT = 0;
+const int NORMAL_UNIT = 1;
+const int DEPTH_UNIT = 2;
+
+// Immutable single level texture read with texelFetch: internal format, width, height
+unsigned int createTarget(GLenum format, int width, int height) {
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    GLState::current().bindTexture(0, GL_TEXTURE_2D, texture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, format, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return texture;
+}
+
+}
+
+DeferredRenderer::DeferredRenderer()
+    : geometry("./shaders/model_lit.vert", "./shaders/gbuffer.frag"),
+      lighting("./shaders/deferred_lighting.vert", "./shaders/deferred_lighting.frag", "./shaders/clustered_lighting.glsl") {
+    albedoSpecularUniform = lighting.uniform<int>("gAlbedoSpecular");
+    normalUniform = lighting.uniform<int>("gNormal");
+    depthUniform = lighting.uniform<int>("gDepth");
+    lighting.use();
+    lighting.set(albedoSpecularUniform, ALBEDO_SPECULAR_UNIT);
+    lighting.set(normalUniform, NORMAL_UNIT);
+    lighting.set(depthUniform, DEPTH_UNIT);
+    glGenFramebuffers(1, &framebuffer);
+    glGenVertexArrays(1, &emptyVAO);
+}
+
+DeferredRenderer::~DeferredRenderer() {
+    deleteTargets();
+    glDeleteFramebuffers(1, &framebuffer);
+    GLState::current().deleteVertexArray(emptyVAO);
+}
+
+bool DeferredRenderer::supported() {
+    return GLAD_GL_VERSION_4_3 != 0;
+}
+
+void DeferredRenderer::beginGeometry(int targetWidth, int targetHeight) {
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    if (targetWidth != width || targetHeight != height) {
+        width = targetWidth;
+        height = targetHeight;
+        deleteTargets();
+        createTargets();
+    }
+    // pixels nothing covers keep depth 1 and are skipped by the lighting pass, the color targets needn't be cleared
+    glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+void DeferredRenderer::resolve() {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    GLState& state = GLState::current();
+    lighting.use();
+    state.bindTexture(ALBEDO_SPECULAR_UNIT, GL_TEXTURE_2D, albedoSpecular);
+    state.bindTexture(NORMAL_UNIT, GL_TEXTURE_2D, normal);
+    state.bindTexture(DEPTH_UNIT, GL_TEXTURE_2D, depth);
+    state.bindVertexArray(emptyVAO);
+    glDisable(GL_DEPTH_TEST);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glEnable(GL_DEPTH_TEST);
+    RenderStats::current().frame.drawCalls++;
+}
+
+void DeferredRenderer::createTargets() {
+    albedoSpecular = createTarget(GL_RGBA8, width, height);
+    normal = createTarget(GL_RGB10_A2, width, height);
+    depth = createTarget(GL_DEPTH_COMPONENT32F, width, height);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedoSpecular, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normal, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+    const GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, drawBuffers);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::DEFERRED:: G-buffer of " << width << "x" << height << " is incomplete" << std::endl;
+}
+
+void DeferredRenderer::deleteTargets() {
+    GLState& state = GLState::current();
+    for (unsigned int* texture : { &albedoSpecular, &normal, &depth }) {
+        if (*texture != 0)
+            state.deleteTexture(*texture);
+        *texture = 0;
+    }
+}
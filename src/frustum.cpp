@@ -0,0 +1,188 @@
+#include <frustum.hpp>
+
+#include <cmath>
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#endif
+
+Frustum::Frustum(const glm::mat4& matrix) {
+    // Gribb/Hartmann: each plane is the last row of the matrix plus or minus one of the others
+    glm::vec4 rowX(matrix[0][0], matrix[1][0], matrix[2][0], matrix[3][0]);
+    glm::vec4 rowY(matrix[0][1], matrix[1][1], matrix[2][1], matrix[3][1]);
+    glm::vec4 rowZ(matrix[0][2], matrix[1][2], matrix[2][2], matrix[3][2]);
+    glm::vec4 rowW(matrix[0][3], matrix[1][3], matrix[2][3], matrix[3][3]);
+    planes[0] = rowW + rowX;   // left
+    planes[1] = rowW - rowX;   // right
+    planes[2] = rowW + rowY;   // bottom
+    planes[3] = rowW - rowY;   // top
+    planes[4] = rowW + rowZ;   // near
+    planes[5] = rowW - rowZ;   // far
+    // unit normals so plane distances are real distances
+    for (glm::vec4& plane : planes) {
+        float length = glm::length(glm::vec3(plane));
+        if (length > 0.0f)
+            plane /= length;
+    }
+}
+
+bool Frustum::intersectsSphere(glm::vec3 center, float radius) const {
+    for (const glm::vec4& plane : planes) {
+        if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+            return false;
+    }
+    return true;
+}
+
+bool Frustum::intersectsBox(glm::vec3 center, glm::vec3 extent) const {
+    for (const glm::vec4& plane : planes) {
+        // how far the box reaches towards the plane's normal
+        float reach = glm::dot(glm::abs(glm::vec3(plane)), extent);
+        if (glm::dot(glm::vec3(plane), center) + plane.w < -reach)
+            return false;
+    }
+    return true;
+}
+
+void BoundsArrays::clear() {
+    centerX.clear();
+    centerY.clear();
+    centerZ.clear();
+    radius.clear();
+    extentX.clear();
+    extentY.clear();
+    extentZ.clear();
+}
+
+void BoundsArrays::push(glm::vec3 center, float sphereRadius, glm::vec3 extent) {
+    centerX.push_back(center.x);
+    centerY.push_back(center.y);
+    centerZ.push_back(center.z);
+    radius.push_back(sphereRadius);
+    extentX.push_back(extent.x);
+    extentY.push_back(extent.y);
+    extentZ.push_back(extent.z);
+}
+
+void cullSpheresScalar(const Frustum& frustum, const BoundsArrays& bounds, std::vector<unsigned char>& visible) {
+    visible.resize(bounds.size());
+    for (size_t i = 0; i < bounds.size(); i++)
+        visible[i] = frustum.intersectsSphere(glm::vec3(bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i]), bounds.radius[i]) ? 1 : 0;
+}
+
+void cullBoxesScalar(const Frustum& frustum, const BoundsArrays& bounds, std::vector<unsigned char>& visible) {
+    visible.resize(bounds.size());
+    for (size_t i = 0; i < bounds.size(); i++) {
+        glm::vec3 center(bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i]);
+        glm::vec3 extent(bounds.extentX[i], bounds.extentY[i], bounds.extentZ[i]);
+        visible[i] = frustum.intersectsBox(center, extent) ? 1 : 0;
+    }
+}
+
+// the SIMD versions sum in the same order as the scalar tests, so both agree on objects touching a plane
+#if defined(__AVX__)
+
+void cullSpheres(const Frustum& frustum, const BoundsArrays& bounds, std::vector<unsigned char>& visible) {
+    visible.resize(bounds.size());
+    size_t i = 0;
+    for (; i + 8 <= bounds.size(); i += 8) {
+        __m256 x = _mm256_loadu_ps(&bounds.centerX[i]), y = _mm256_loadu_ps(&bounds.centerY[i]), z = _mm256_loadu_ps(&bounds.centerZ[i]);
+        __m256 reach = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&bounds.radius[i]));
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (const glm::vec4& plane : frustum.planes) {
+            __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(plane.x)), _mm256_mul_ps(y, _mm256_set1_ps(plane.y))), _mm256_mul_ps(z, _mm256_set1_ps(plane.z))),
+                                 _mm256_set1_ps(plane.w));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, reach, _CMP_GE_OQ));
+        }
+        int mask = _mm256_movemask_ps(inside);
+        for (int lane = 0; lane < 8; lane++)
+            visible[i + lane] = (mask >> lane) & 1;
+    }
+    for (; i < bounds.size(); i++)
+        visible[i] = frustum.intersectsSphere(glm::vec3(bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i]), bounds.radius[i]) ? 1 : 0;
+}
+
+void cullBoxes(const Frustum& frustum, const BoundsArrays& bounds, std::vector<unsigned char>& visible) {
+    visible.resize(bounds.size());
+    size_t i = 0;
+    for (; i + 8 <= bounds.size(); i += 8) {
+        __m256 x = _mm256_loadu_ps(&bounds.centerX[i]), y = _mm256_loadu_ps(&bounds.centerY[i]), z = _mm256_loadu_ps(&bounds.centerZ[i]);
+        __m256 ex = _mm256_loadu_ps(&bounds.extentX[i]), ey = _mm256_loadu_ps(&bounds.extentY[i]), ez = _mm256_loadu_ps(&bounds.extentZ[i]);
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (const glm::vec4& plane : frustum.planes) {
+            __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(plane.x)), _mm256_mul_ps(y, _mm256_set1_ps(plane.y))), _mm256_mul_ps(z, _mm256_set1_ps(plane.z))),
+                                 _mm256_set1_ps(plane.w));
+            __m256 reach = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ex, _mm256_set1_ps(std::fabs(plane.x))), _mm256_mul_ps(ey, _mm256_set1_ps(std::fabs(plane.y)))),
+                                         _mm256_mul_ps(ez, _mm256_set1_ps(std::fabs(plane.z))));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, _mm256_sub_ps(_mm256_setzero_ps(), reach), _CMP_GE_OQ));
+        }
+        int mask = _mm256_movemask_ps(inside);
+        for (int lane = 0; lane < 8; lane++)
+            visible[i + lane] = (mask >> lane) & 1;
+    }
+    for (; i < bounds.size(); i++) {
+        glm::vec3 center(bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i]);
+        glm::vec3 extent(bounds.extentX[i], bounds.extentY[i], bounds.extentZ[i]);
+        visible[i] = frustum.intersectsBox(center, extent) ? 1 : 0;
+    }
+}
+
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+
+void cullSpheres(const Frustum& frustum, const BoundsArrays& bounds, std::vector<unsigned char>& visible) {
+    visible.resize(bounds.size());
+    size_t i = 0;
+    for (; i + 4 <= bounds.size(); i += 4) {
+        __m128 x = _mm_loadu_ps(&bounds.centerX[i]), y = _mm_loadu_ps(&bounds.centerY[i]), z = _mm_loadu_ps(&bounds.centerZ[i]);
+        __m128 reach = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&bounds.radius[i]));
+        __m128 inside = _mm_cmpeq_ps(x, x);
+        for (const glm::vec4& plane : frustum.planes) {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.x)), _mm_mul_ps(y, _mm_set1_ps(plane.y))), _mm_mul_ps(z, _mm_set1_ps(plane.z))),
+                                 _mm_set1_ps(plane.w));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, reach));
+        }
+        int mask = _mm_movemask_ps(inside);
+        for (int lane = 0; lane < 4; lane++)
+            visible[i + lane] = (mask >> lane) & 1;
+    }
+    for (; i < bounds.size(); i++)
+        visible[i] = frustum.intersectsSphere(glm::vec3(bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i]), bounds.radius[i]) ? 1 : 0;
+}
+
+void cullBoxes(const Frustum& frustum, const BoundsArrays& bounds, std::vector<unsigned char>& visible) {
+    visible.resize(bounds.size());
+    size_t i = 0;
+    for (; i + 4 <= bounds.size(); i += 4) {
+        __m128 x = _mm_loadu_ps(&bounds.centerX[i]), y = _mm_loadu_ps(&bounds.centerY[i]), z = _mm_loadu_ps(&bounds.centerZ[i]);
+        __m128 ex = _mm_loadu_ps(&bounds.extentX[i]), ey = _mm_loadu_ps(&bounds.extentY[i]), ez = _mm_loadu_ps(&bounds.extentZ[i]);
+        __m128 inside = _mm_cmpeq_ps(x, x);
+        for (const glm::vec4& plane : frustum.planes) {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.x)), _mm_mul_ps(y, _mm_set1_ps(plane.y))), _mm_mul_ps(z, _mm_set1_ps(plane.z))),
+                                 _mm_set1_ps(plane.w));
+            __m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, _mm_set1_ps(std::fabs(plane.x))), _mm_mul_ps(ey, _mm_set1_ps(std::fabs(plane.y)))),
+                                      _mm_mul_ps(ez, _mm_set1_ps(std::fabs(plane.z))));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, _mm_sub_ps(_mm_setzero_ps(), reach)));
+        }
+        int mask = _mm_movemask_ps(inside);
+        for (int lane = 0; lane < 4; lane++)
+            visible[i + lane] = (mask >> lane) & 1;
+    }
+    for (; i < bounds.size(); i++) {
+        glm::vec3 center(bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i]);
+        glm::vec3 extent(bounds.extentX[i], bounds.extentY[i], bounds.extentZ[i]);
+        visible[i] = frustum.intersectsBox(center, extent) ? 1 : 0;
+    }
+}
+
+#else
+
+void cullSpheres(const Frustum& frustum, const BoundsArrays& bounds, std::vector<unsigned char>& visible) {
+    cullSpheresScalar(frustum, bounds, visible);
+}
+
+void cullBoxes(const Frustum& frustum, const BoundsArrays& bounds, std::vector<unsigned char>& visible) {
+    cullBoxesScalar(frustum, bounds, visible);
+}
+
+#endif
@@ -0,0 +1,218 @@
+#include "glad/glad.h"
+#include <geometry_arena.hpp>
+#include <vertex_format.hpp>
+#include <gl_state.hpp>
+#include <instance_buffer.hpp>
+
+#include <algorithm>
+#include <cstddef>
+
+namespace {
+
+// smallest buffers an arena starts with, so a few small meshes don't cause a chain of resizes
+const size_t MIN_POOL_VERTICES = 1 << 16;
+const size_t MIN_INDEX_BYTES = 1 << 22;
+// keeps every index buffer aligned for the largest index size
+const size_t INDEX_ALIGNMENT = sizeof(unsigned int);
+
+// attribute pointers of a format into the VBO bound to GL_ARRAY_BUFFER
+void setupAttributes(VertexFormat format) {
+    GLsizei stride = static_cast<GLsizei>(vertexStride(format));
+    if (format == VertexFormat::Full)
+    {
+        // vertex Positions
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+        // vertex normals
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, Normal));
+        // vertex texture coords
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, TexCoords));
+        // vertex tangent
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, Tangent));
+        // vertex bitangent
+        glEnableVertexAttribArray(4);
+        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, Bitangent));
+        // ids
+        glEnableVertexAttribArray(5);
+        glVertexAttribIPointer(5, 4, GL_INT, stride, (void*)offsetof(Vertex, m_BoneIDs));
+
+        // weights
+        glEnableVertexAttribArray(6);
+        glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, m_Weights));
+    }
+    else
+    {
+        bool halfPosition = format == VertexFormat::PackedHalf || format == VertexFormat::PackedHalfSkinned;
+        size_t frameOffset = halfPosition ? offsetof(PackedVertexHalf, Normal) : offsetof(PackedVertexFloat, Normal);
+        size_t texCoordsOffset = halfPosition ? offsetof(PackedVertexHalf, TexCoords) : offsetof(PackedVertexFloat, TexCoords);
+        size_t skinOffset = halfPosition ? sizeof(PackedVertexHalf) : sizeof(PackedVertexFloat);
+        // vertex Positions, w holds the bitangent sign
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 4, halfPosition ? GL_HALF_FLOAT : GL_FLOAT, GL_FALSE, stride, (void*)0);
+        // unorm16 texture coords, rescaled by uvTransform in the shader
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)texCoordsOffset);
+        // octahedral normal (xy) and tangent (zw)
+        glEnableVertexAttribArray(7);
+        glVertexAttribPointer(7, 4, GL_SHORT, GL_TRUE, stride, (void*)frameOffset);
+        if (isSkinnedFormat(format))
+        {
+            // ids
+            glEnableVertexAttribArray(5);
+            glVertexAttribIPointer(5, 4, GL_UNSIGNED_BYTE, stride, (void*)(skinOffset + offsetof(PackedSkin, BoneIDs)));
+            // unorm8 weights
+            glEnableVertexAttribArray(6);
+            glVertexAttribPointer(6, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*)(skinOffset + offsetof(PackedSkin, Weights)));
+        }
+    }
+}
+
+}
+
+bool GeometryArena::RangeAllocator::allocate(size_t size, size_t alignment, size_t& offset) {
+    for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it) {
+        size_t start = (it->first + alignment - 1) / alignment * alignment;
+        size_t end = it->first + it->second;
+        if (start + size > end)
+            continue;
+        // split the free range around the allocation
+        size_t rangeStart = it->first;
+        freeRanges.erase(it);
+        if (start > rangeStart)
+            freeRanges[rangeStart] = start - rangeStart;
+        if (end > start + size)
+            freeRanges[start + size] = end - (start + size);
+        offset = start;
+        return true;
+    }
+    return false;
+}
+
+void GeometryArena::RangeAllocator::free(size_t offset, size_t size) {
+    if (size == 0)
+        return;
+    auto next = freeRanges.lower_bound(offset);
+    // merge with the free neighbours on both sides
+    if (next != freeRanges.end() && offset + size == next->first) {
+        size += next->second;
+        next = freeRanges.erase(next);
+    }
+    if (next != freeRanges.begin()) {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == offset) {
+            previous->second += size;
+            return;
+        }
+    }
+    freeRanges[offset] = size;
+}
+
+void GeometryArena::RangeAllocator::grow(size_t newCapacity) {
+    size_t oldCapacity = capacity;
+    capacity = newCapacity;
+    free(oldCapacity, newCapacity - oldCapacity);
+}
+
+GeometryArena::~GeometryArena() {
+    GLState& state = GLState::current();
+    for (VertexPool& pool : pools) {
+        if (pool.VAO == 0)
+            continue;
+        InstanceBuffer::shared().forget(pool.VAO);
+        state.deleteVertexArray(pool.VAO);
+        state.deleteBuffer(pool.VBO);
+    }
+    if (EBO != 0)
+        state.deleteBuffer(EBO);
+}
+
+GeometryAllocation GeometryArena::allocate(VertexFormat format, const void* vertices, size_t vertexCount, const void* indices, size_t indexBytes) {
+    VertexPool& target = pool(format);
+    size_t stride = vertexStride(format);
+
+    // grow at least geometrically so many small meshes don't copy the buffers over and over
+    size_t vertexOffset;
+    if (!target.ranges.allocate(vertexCount, 1, vertexOffset)) {
+        size_t capacity = std::max({ target.ranges.capacity * 2, target.ranges.capacity + vertexCount, MIN_POOL_VERTICES });
+        target.VBO = growBuffer(target.VBO, target.ranges.capacity * stride, capacity * stride);
+        target.ranges.grow(capacity);
+        target.ranges.allocate(vertexCount, 1, vertexOffset);
+        // the VAO still points at the old buffer
+        GLState::current().bindVertexArray(target.VAO);
+        GLState::current().bindBuffer(GL_ARRAY_BUFFER, target.VBO);
+        setupAttributes(format);
+    }
+    size_t indexOffset;
+    if (!indexRanges.allocate(indexBytes, INDEX_ALIGNMENT, indexOffset)) {
+        size_t capacity = std::max({ indexRanges.capacity * 2, indexRanges.capacity + indexBytes + INDEX_ALIGNMENT, MIN_INDEX_BYTES });
+        EBO = growBuffer(EBO, indexRanges.capacity, capacity);
+        indexRanges.grow(capacity);
+        indexRanges.allocate(indexBytes, INDEX_ALIGNMENT, indexOffset);
+        // the element buffer binding is part of every VAO
+        for (VertexPool& other : pools) {
+            if (other.VAO == 0)
+                continue;
+            GLState::current().bindVertexArray(other.VAO);
+            GLState::current().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        }
+    }
+
+    GLState::current().bindBuffer(GL_ARRAY_BUFFER, target.VBO);
+    glBufferSubData(GL_ARRAY_BUFFER, vertexOffset * stride, vertexCount * stride, vertices);
+    GLState::current().bindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, indexOffset, indexBytes, indices);
+
+    GeometryAllocation allocation;
+    allocation.format = format;
+    allocation.VAO = target.VAO;
+    allocation.baseVertex = static_cast<unsigned int>(vertexOffset);
+    allocation.vertexCount = static_cast<unsigned int>(vertexCount);
+    allocation.indexOffset = indexOffset;
+    allocation.indexBytes = indexBytes;
+    return allocation;
+}
+
+void GeometryArena::free(const GeometryAllocation& allocation) {
+    if (allocation.VAO == 0)
+        return;
+    pool(allocation.format).ranges.free(allocation.baseVertex, allocation.vertexCount);
+    indexRanges.free(allocation.indexOffset, allocation.indexBytes);
+}
+
+GeometryArena& GeometryArena::shared() {
+    // never destroyed: its buffers go away with the context, and static destructors run after that's gone
+    static GeometryArena* arena = new GeometryArena();
+    return *arena;
+}
+
+GeometryArena::VertexPool& GeometryArena::pool(VertexFormat format) {
+    VertexPool& pool = pools[static_cast<size_t>(format)];
+    if (pool.VAO == 0) {
+        glGenVertexArrays(1, &pool.VAO);
+        // the VAO needs the shared index buffer, created here if this is the arena's first pool
+        if (EBO == 0) {
+            indexRanges.grow(MIN_INDEX_BYTES);
+            EBO = growBuffer(0, 0, MIN_INDEX_BYTES);
+        }
+        GLState::current().bindVertexArray(pool.VAO);
+        GLState::current().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    }
+    return pool;
+}
+
+unsigned int GeometryArena::growBuffer(unsigned int buffer, size_t size, size_t newSize) {
+    // copy through the dedicated copy targets so no VAO's element buffer binding changes
+    unsigned int grown;
+    glGenBuffers(1, &grown);
+    GLState::current().bindBuffer(GL_COPY_WRITE_BUFFER, grown);
+    glBufferData(GL_COPY_WRITE_BUFFER, newSize, nullptr, GL_STATIC_DRAW);
+    if (buffer != 0) {
+        GLState::current().bindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, size);
+        GLState::current().deleteBuffer(buffer);
+    }
+    return grown;
+}
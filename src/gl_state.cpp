@@ -0,0 +1,159 @@
+#include <gl_state.hpp>
+#include <render_stats.hpp>
+
+#include <cstddef>
+
+namespace {
+
+const GLenum TRACKED_TEXTURE_TARGETS[] = { GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_CUBE_MAP };
+const GLenum TRACKED_BUFFER_TARGETS[] = {
+    GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER, GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+    GL_UNIFORM_BUFFER, GL_SHADER_STORAGE_BUFFER, GL_DRAW_INDIRECT_BUFFER, GL_PIXEL_UNPACK_BUFFER
+};
+// the element buffer binding is part of the bound VAO
+const unsigned int ELEMENT_BUFFER_SLOT = 1;
+
+// slot of a target in a list, or the list size when it isn't tracked
+template<size_t N>
+unsigned int slot(const GLenum (&targets)[N], GLenum target) {
+    unsigned int i = 0;
+    while (i < N && targets[i] != target)
+        i++;
+    return i;
+}
+
+}
+
+GLState& GLState::current() {
+    static GLState state;
+    return state;
+}
+
+GLState::GLState() {
+    invalidate();
+}
+
+void GLState::invalidate() {
+    program = UNKNOWN;
+    vertexArray = UNKNOWN;
+    activeUnit = UNKNOWN;
+    for (unsigned int unit = 0; unit < TEXTURE_UNITS; unit++) {
+        for (unsigned int target = 0; target < TEXTURE_TARGETS; target++)
+            textures[unit][target] = UNKNOWN;
+        samplers[unit] = UNKNOWN;
+    }
+    for (unsigned int target = 0; target < BUFFER_TARGETS; target++)
+        buffers[target] = UNKNOWN;
+}
+
+bool GLState::changes(unsigned int& bound, unsigned int value) {
+    RenderStats::Counters& frame = RenderStats::current().frame;
+    if (bound == value) {
+        frame.stateCallsElided++;
+        return false;
+    }
+    bound = value;
+    frame.stateCalls++;
+    return true;
+}
+
+void GLState::useProgram(unsigned int id) {
+    if (changes(program, id))
+        glUseProgram(id);
+}
+
+void GLState::bindVertexArray(unsigned int id) {
+    if (!changes(vertexArray, id))
+        return;
+    glBindVertexArray(id);
+    buffers[ELEMENT_BUFFER_SLOT] = UNKNOWN;
+}
+
+void GLState::activeTexture(unsigned int unit) {
+    if (changes(activeUnit, unit))
+        glActiveTexture(GL_TEXTURE0 + unit);
+}
+
+void GLState::bindTexture(unsigned int unit, GLenum target, unsigned int texture) {
+    unsigned int index = slot(TRACKED_TEXTURE_TARGETS, target);
+    if (unit < TEXTURE_UNITS && index < TEXTURE_TARGETS) {
+        if (textures[unit][index] == texture) {
+            RenderStats::current().frame.stateCallsElided++;
+            return;
+        }
+        textures[unit][index] = texture;
+    }
+    activeTexture(unit);
+    glBindTexture(target, texture);
+    RenderStats::current().frame.stateCalls++;
+}
+
+void GLState::bindSampler(unsigned int unit, unsigned int sampler) {
+    if (unit >= TEXTURE_UNITS) {
+        glBindSampler(unit, sampler);
+        RenderStats::current().frame.stateCalls++;
+        return;
+    }
+    if (changes(samplers[unit], sampler))
+        glBindSampler(unit, sampler);
+}
+
+void GLState::bindBuffer(GLenum target, unsigned int buffer) {
+    unsigned int index = slot(TRACKED_BUFFER_TARGETS, target);
+    if (index == BUFFER_TARGETS) {
+        glBindBuffer(target, buffer);
+        RenderStats::current().frame.stateCalls++;
+        return;
+    }
+    if (changes(buffers[index], buffer))
+        glBindBuffer(target, buffer);
+}
+
+void GLState::bindBufferBase(GLenum target, unsigned int index, unsigned int buffer) {
+    glBindBufferBase(target, index, buffer);
+    RenderStats::current().frame.stateCalls++;
+    unsigned int slotIndex = slot(TRACKED_BUFFER_TARGETS, target);
+    if (slotIndex < BUFFER_TARGETS)
+        buffers[slotIndex] = buffer;
+}
+
+void GLState::bindBufferRange(GLenum target, unsigned int index, unsigned int buffer, size_t offset, size_t size) {
+    glBindBufferRange(target, index, buffer, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(size));
+    RenderStats::current().frame.stateCalls++;
+    unsigned int slotIndex = slot(TRACKED_BUFFER_TARGETS, target);
+    if (slotIndex < BUFFER_TARGETS)
+        buffers[slotIndex] = buffer;
+}
+
+void GLState::deleteProgram(unsigned int id) {
+    glDeleteProgram(id);
+    // a program in use is only flagged for deletion, but its name may still come back
+    if (program == id)
+        program = UNKNOWN;
+}
+
+void GLState::deleteVertexArray(unsigned int id) {
+    glDeleteVertexArrays(1, &id);
+    if (vertexArray == id) {
+        vertexArray = 0;
+        buffers[ELEMENT_BUFFER_SLOT] = UNKNOWN;
+    }
+}
+
+void GLState::deleteTexture(unsigned int id) {
+    glDeleteTextures(1, &id);
+    for (unsigned int unit = 0; unit < TEXTURE_UNITS; unit++) {
+        for (unsigned int target = 0; target < TEXTURE_TARGETS; target++) {
+            if (textures[unit][target] == id)
+                textures[unit][target] = 0;
+        }
+    }
+}
+
+void GLState::deleteBuffer(unsigned int id) {
+    glDeleteBuffers(1, &id);
+    for (unsigned int target = 0; target < BUFFER_TARGETS; target++) {
+        if (buffers[target] == id)
+            buffers[target] = 0;
+    }
+}
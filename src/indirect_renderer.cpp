@@ -0,0 +1,229 @@
+#include "glad/glad.h"
+#include <indirect_renderer.hpp>
+#include <gl_state.hpp>
+#include <render_stats.hpp>
+#include <transform_batch.hpp>
+#include <uniform_ring.hpp>
+#include <vertex_format.hpp>
+
+#include <algorithm>
+#include <cstdint>
+
+namespace {
+
+// layer of draws without a diffuse texture, the shader draws them white
+const unsigned int NO_LAYER = ~0u;
+const unsigned int NO_ARRAY = ~0u;
+// draw indices the index buffer starts with
+const size_t MIN_DRAW_INDICES = 1024;
+
+// the unsized formats textures are uploaded with, texture arrays need sized ones
+GLenum sizedFormat(GLint format) {
+    switch (format) {
+    case GL_RED: return GL_R8;
+    case GL_RGB: return GL_RGB8;
+    case GL_RGBA: return GL_RGBA8;
+    default: return static_cast<GLenum>(format);
+    }
+}
+
+GLenum indexType(unsigned int indexSize) {
+    if (indexSize == sizeof(uint8_t))
+        return GL_UNSIGNED_BYTE;
+    if (indexSize == sizeof(uint16_t))
+        return GL_UNSIGNED_SHORT;
+    return GL_UNSIGNED_INT;
+}
+
+}
+
+IndirectRenderer::IndirectRenderer() : shader("./shaders/model_indirect.vert", "./shaders/model_indirect.frag") {
+    diffuseArrayUniform = shader.uniform<int>("diffuseArray");
+    glGenBuffers(1, &commandBuffer);
+    glGenBuffers(1, &drawIndexBuffer);
+}
+
+IndirectRenderer::~IndirectRenderer() {
+    GLState& state = GLState::current();
+    state.deleteBuffer(commandBuffer);
+    state.deleteBuffer(drawIndexBuffer);
+    for (const TextureArray& array : arrays)
+        state.deleteTexture(array.id);
+}
+
+bool IndirectRenderer::supported() {
+    return GLAD_GL_VERSION_4_3 != 0;
+}
+
+void IndirectRenderer::add(Mesh& mesh, const glm::mat4& transform, unsigned int lod) {
+    Group* group;
+    uint32_t draw = addDraw(mesh, transform, group);
+    const MeshLod& range = mesh.lods[lod < mesh.lods.size() ? lod : mesh.lods.size() - 1];
+    const GeometryAllocation& geometry = mesh.allocation();
+    GLuint firstIndex = static_cast<GLuint>(geometry.indexOffset / mesh.indexSize + range.indexOffset);
+    group->commands.push_back(DrawCommand{ range.indexCount, 1, firstIndex, static_cast<GLint>(geometry.baseVertex), draw });
+    RenderStats::current().frame.triangles += range.indexCount / 3;
+}
+
+void IndirectRenderer::addRanges(Mesh& mesh, const glm::mat4& transform, const GLsizei* counts, const void* const* offsets, unsigned int rangeCount) {
+    Group* group;
+    uint32_t draw = addDraw(mesh, transform, group);
+    const GeometryAllocation& geometry = mesh.allocation();
+    for (unsigned int i = 0; i < rangeCount; i++) {
+        GLuint firstIndex = static_cast<GLuint>(reinterpret_cast<uintptr_t>(offsets[i]) / mesh.indexSize);
+        group->commands.push_back(DrawCommand{ static_cast<GLuint>(counts[i]), 1, firstIndex, static_cast<GLint>(geometry.baseVertex), draw });
+        RenderStats::current().frame.triangles += counts[i] / 3;
+    }
+}
+
+uint32_t IndirectRenderer::addDraw(Mesh& mesh, const glm::mat4& transform, Group*& group) {
+    TextureSlot slot = diffuseSlot(*mesh.material);
+    auto found = std::find_if(groups.begin(), groups.end(), [&](const Group& existing) {
+        return existing.VAO == mesh.VAO && existing.indexSize == mesh.indexSize && existing.textureArray == slot.array;
+    });
+    if (found == groups.end()) {
+        groups.push_back(Group{ mesh.VAO, mesh.indexSize, slot.array, {}, 0 });
+        found = groups.end() - 1;
+    }
+    group = &*found;
+    drawTransforms.push_back(transform);
+    draws.push_back(DrawData{ glm::mat4(1.0f), mesh.uvTransform, slot.layer, isPackedFormat(mesh.format) ? 1u : 0u, { 0, 0 } });
+    return static_cast<uint32_t>(draws.size() - 1);
+}
+
+IndirectRenderer::TextureSlot IndirectRenderer::diffuseSlot(const Material& material) {
+    auto diffuse = std::find_if(material.textures.begin(), material.textures.end(), [](const Texture& texture) { return texture.type == "texture_diffuse"; });
+    if (diffuse == material.textures.end() || diffuse->id == 0)
+        return TextureSlot{ 0, NO_ARRAY, NO_LAYER };
+    auto found = textureSlots.find(diffuse->path);
+    if (found != textureSlots.end() && found->second.texture == diffuse->id)
+        return found->second;
+
+    GLint width, height, format;
+    GLState::current().bindTexture(0, GL_TEXTURE_2D, diffuse->id);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+    GLenum internalFormat = sizedFormat(format);
+
+    auto array = std::find_if(arrays.begin(), arrays.end(), [&](const TextureArray& existing) {
+        return existing.internalFormat == internalFormat && existing.width == width && existing.height == height;
+    });
+    if (array == arrays.end()) {
+        TextureArray created;
+        created.internalFormat = internalFormat;
+        created.width = width;
+        created.height = height;
+        // uploads generate the full mipmap chain
+        created.levels = 1;
+        while ((std::max(width, height) >> created.levels) > 0)
+            created.levels++;
+        arrays.push_back(created);
+        array = arrays.end() - 1;
+    }
+
+    // a texture replaced under the same path reuses its layer when it still fits the array
+    TextureSlot slot{ diffuse->id, static_cast<unsigned int>(array - arrays.begin()), 0 };
+    if (found != textureSlots.end() && found->second.array == slot.array)
+        slot.layer = found->second.layer;
+    else {
+        if (array->layers == array->capacity)
+            growArray(*array);
+        slot.layer = array->layers++;
+    }
+    copyLayer(*array, diffuse->id, slot.layer);
+    textureSlots[diffuse->path] = slot;
+    return slot;
+}
+
+void IndirectRenderer::copyLayer(TextureArray& array, unsigned int texture, unsigned int layer) {
+    for (int level = 0; level < array.levels; level++) {
+        GLsizei width = std::max(1, array.width >> level), height = std::max(1, array.height >> level);
+        glCopyImageSubData(texture, GL_TEXTURE_2D, level, 0, 0, 0, array.id, GL_TEXTURE_2D_ARRAY, level, 0, 0, static_cast<GLint>(layer), width, height, 1);
+    }
+}
+
+void IndirectRenderer::growArray(TextureArray& array) {
+    unsigned int capacity = std::max(1u, array.capacity * 2);
+    unsigned int grown;
+    glGenTextures(1, &grown);
+    GLState& state = GLState::current();
+    state.bindTexture(0, GL_TEXTURE_2D_ARRAY, grown);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, array.levels, array.internalFormat, array.width, array.height, static_cast<GLsizei>(capacity));
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    if (array.id != 0) {
+        // every level of every layer in one copy each
+        for (int level = 0; level < array.levels; level++) {
+            GLsizei width = std::max(1, array.width >> level), height = std::max(1, array.height >> level);
+            glCopyImageSubData(array.id, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0, grown, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0, width, height, static_cast<GLsizei>(array.layers));
+        }
+        state.deleteTexture(array.id);
+    }
+    array.id = grown;
+    array.capacity = capacity;
+}
+
+void IndirectRenderer::submit(const RenderView& view) {
+    if (draws.empty())
+        return;
+    GLState& state = GLState::current();
+    RenderStats& stats = RenderStats::current();
+
+    // the draw index buffer only changes when it has to grow
+    if (draws.size() > drawIndexCapacity) {
+        drawIndexCapacity = std::max({ drawIndexCapacity * 2, draws.size(), MIN_DRAW_INDICES });
+        std::vector<uint32_t> indices(drawIndexCapacity);
+        for (size_t i = 0; i < indices.size(); i++)
+            indices[i] = static_cast<uint32_t>(i);
+        state.bindBuffer(GL_ARRAY_BUFFER, drawIndexBuffer);
+        glBufferData(GL_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+    }
+
+    drawMatrices.resize(draws.size());
+    modelViewProjections(view.projection * view.view, drawTransforms.data(), drawTransforms.size(), drawMatrices.data());
+    for (size_t i = 0; i < draws.size(); i++)
+        draws[i].modelViewProjection = drawMatrices[i];
+
+    // draw data goes into the frame's part of the uniform ring, commands are rewritten every frame into fresh storage
+    UniformRing& ring = UniformRing::shared();
+    size_t drawBytes = draws.size() * sizeof(DrawData);
+    ring.bindRange(GL_SHADER_STORAGE_BUFFER, 0, ring.write(draws.data(), drawBytes), drawBytes);
+    commands.clear();
+    for (Group& group : groups) {
+        group.firstCommand = commands.size();
+        commands.insert(commands.end(), group.commands.begin(), group.commands.end());
+    }
+    state.bindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawCommand), commands.data(), GL_STREAM_DRAW);
+
+    shader.use();
+    shader.set(diffuseArrayUniform, 0);
+    stats.frame.programSwitches++;
+    for (Group& group : groups) {
+        if (group.commands.empty())
+            continue;
+        state.bindVertexArray(group.VAO);
+        // VAOs are shared with the other paths, point their draw index attribute at our buffer only for this draw
+        state.bindBuffer(GL_ARRAY_BUFFER, drawIndexBuffer);
+        glEnableVertexAttribArray(DRAW_INDEX_ATTRIBUTE_LOCATION);
+        glVertexAttribIPointer(DRAW_INDEX_ATTRIBUTE_LOCATION, 1, GL_UNSIGNED_INT, sizeof(uint32_t), (void*)0);
+        glVertexAttribDivisor(DRAW_INDEX_ATTRIBUTE_LOCATION, 1);
+        stats.frame.vertexArraySwitches++;
+        if (group.textureArray != NO_ARRAY) {
+            state.bindTexture(0, GL_TEXTURE_2D_ARRAY, arrays[group.textureArray].id);
+            stats.frame.textureSwitches++;
+        }
+        glMultiDrawElementsIndirect(GL_TRIANGLES, indexType(group.indexSize), (void*)(group.firstCommand * sizeof(DrawCommand)),
+                                    static_cast<GLsizei>(group.commands.size()), 0);
+        // and leave the VAO as the direct paths set it up, their instanced draws would read past the end of the buffer
+        glDisableVertexAttribArray(DRAW_INDEX_ATTRIBUTE_LOCATION);
+        glVertexAttribDivisor(DRAW_INDEX_ATTRIBUTE_LOCATION, 0);
+        stats.frame.drawCalls++;
+        group.commands.clear();
+    }
+    draws.clear();
+    drawTransforms.clear();
+}
@@ -0,0 +1,77 @@
+#include "glad/glad.h"
+#include <instance_buffer.hpp>
+#include <gl_state.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+namespace {
+
+// room for a few thousand instances before the first orphan
+const size_t MIN_INSTANCE_BYTES = sizeof(InstanceData) * 4096;
+
+}
+
+InstanceBuffer::~InstanceBuffer() {
+    if (VBO != 0)
+        GLState::current().deleteBuffer(VBO);
+}
+
+size_t InstanceBuffer::upload(const glm::mat4* models, const NormalMatrix* normals, size_t count) {
+    staging.resize(count);
+    for (size_t i = 0; i < count; i++)
+        staging[i] = InstanceData{ models[i], normals ? normals[i] : NormalMatrix{} };
+    size_t bytes = count * sizeof(InstanceData);
+    if (VBO == 0) {
+        glGenBuffers(1, &VBO);
+        // nothing fits yet, the check below allocates the storage
+        cursor = capacity;
+    }
+    GLState::current().bindBuffer(GL_ARRAY_BUFFER, VBO);
+    if (cursor + bytes > capacity) {
+        // fresh storage: draws still reading the old one keep it until they finish
+        capacity = std::max({ capacity, bytes, MIN_INSTANCE_BYTES });
+        glBufferData(GL_ARRAY_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+        cursor = 0;
+    }
+    size_t offset = cursor;
+    glBufferSubData(GL_ARRAY_BUFFER, offset, bytes, staging.data());
+    cursor += bytes;
+    return offset;
+}
+
+void InstanceBuffer::bind(unsigned int VAO, size_t offset) {
+    auto found = std::find_if(pointed.begin(), pointed.end(), [VAO](const std::pair<unsigned int, size_t>& entry) { return entry.first == VAO; });
+    if (found != pointed.end() && found->second == offset)
+        return;
+    GLState& state = GLState::current();
+    state.bindVertexArray(VAO);
+    state.bindBuffer(GL_ARRAY_BUFFER, VBO);
+    // matrix attributes take one location per column, the normal matrix columns are padded to vec4
+    auto point = [&](GLuint location, GLint size, size_t columnOffset) {
+        if (found == pointed.end()) {
+            glEnableVertexAttribArray(location);
+            glVertexAttribDivisor(location, 1);
+        }
+        glVertexAttribPointer(location, size, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(offset + columnOffset));
+    };
+    for (unsigned int column = 0; column < 4; column++)
+        point(INSTANCE_ATTRIBUTE_LOCATION + column, 4, offsetof(InstanceData, model) + sizeof(glm::vec4) * column);
+    for (unsigned int column = 0; column < 3; column++)
+        point(INSTANCE_NORMAL_ATTRIBUTE_LOCATION + column, 3, offsetof(InstanceData, normalMatrix) + sizeof(glm::vec4) * column);
+    if (found == pointed.end())
+        pointed.emplace_back(VAO, offset);
+    else
+        found->second = offset;
+}
+
+void InstanceBuffer::forget(unsigned int VAO) {
+    pointed.erase(std::remove_if(pointed.begin(), pointed.end(), [VAO](const std::pair<unsigned int, size_t>& entry) { return entry.first == VAO; }), pointed.end());
+}
+
+InstanceBuffer& InstanceBuffer::shared() {
+    // never destroyed, like the shared geometry arena its buffer goes away with the context
+    static InstanceBuffer* buffer = new InstanceBuffer();
+    return *buffer;
+}
@@ -0,0 +1,224 @@
+#include "glad/glad.h"
+#include <light_clusters.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define LIGHT_CLUSTERS_SSE 1
+#endif
+
+namespace {
+
+// Write an array into the ring and bind it as shader storage, empty arrays bind a few zero bytes since a range can't
+// be empty: ring, binding point, data, size in bytes
+void bindStorage(UniformRing& ring, unsigned int binding, const void* data, size_t size) {
+    static const uint32_t EMPTY[4] = {};
+    if (size == 0) {
+        data = EMPTY;
+        size = sizeof(EMPTY);
+    }
+    ring.bindRange(GL_SHADER_STORAGE_BUFFER, binding, ring.write(data, size), size);
+}
+
+}
+
+void LightClusters::LightArrays::clear() {
+    x.clear();
+    y.clear();
+    z.clear();
+    radiusSquared.clear();
+    light.clear();
+}
+
+void LightClusters::LightArrays::push(float centerX, float centerY, float centerZ, float radiusSquared, uint32_t index) {
+    x.push_back(centerX);
+    y.push_back(centerY);
+    z.push_back(centerZ);
+    this->radiusSquared.push_back(radiusSquared);
+    light.push_back(index);
+}
+
+void LightClusters::LightArrays::pad() {
+#if LIGHT_CLUSTERS_SSE
+    size_t padded = (light.size() + 3) & ~size_t(3);
+    x.resize(padded, 0.0f);
+    y.resize(padded, 0.0f);
+    z.resize(padded, 0.0f);
+    radiusSquared.resize(padded, -1.0f);
+#endif
+}
+
+LightClusters::LightClusters(unsigned int tilesX, unsigned int tilesY, unsigned int slices)
+    : tilesX(std::max(tilesX, 1u)), tilesY(std::max(tilesY, 1u)), slices(std::max(slices, 1u)) {
+    sliceWork.resize(this->slices);
+}
+
+bool LightClusters::supported() {
+    return GLAD_GL_VERSION_4_3 != 0;
+}
+
+void LightClusters::build(const RenderView& view, glm::vec2 viewport, const std::vector<PointLight>& lights, ThreadPool& pool) {
+    prepare(view, viewport, lights);
+    pool.parallelFor(slices, [this](size_t slice) { assignSlice(static_cast<unsigned int>(slice), true); });
+    merge();
+}
+
+void LightClusters::buildScalar(const RenderView& view, glm::vec2 viewport, const std::vector<PointLight>& lights) {
+    prepare(view, viewport, lights);
+    for (unsigned int slice = 0; slice < slices; slice++)
+        assignSlice(slice, false);
+    merge();
+}
+
+void LightClusters::bind(UniformRing& ring, const std::vector<PointLight>& lights) const {
+    float depthRange = std::log(farPlane / nearPlane);
+    ClusterConstants constants;
+    constants.size = glm::uvec4(tilesX, tilesY, slices, static_cast<unsigned int>(lights.size()));
+    constants.viewport = glm::vec4(viewportSize, nearPlane, farPlane);
+    constants.slicing = glm::vec4(slices / depthRange, -(slices * std::log(nearPlane)) / depthRange, 0.0f, 0.0f);
+    ring.push(GL_UNIFORM_BUFFER, CLUSTER_BLOCK_BINDING, constants);
+    bindStorage(ring, LIGHT_STORAGE_BINDING, lights.data(), lights.size() * sizeof(PointLight));
+    bindStorage(ring, CLUSTER_STORAGE_BINDING, ranges.data(), ranges.size() * sizeof(ClusterRange));
+    bindStorage(ring, LIGHT_INDEX_STORAGE_BINDING, indices.data(), indices.size() * sizeof(uint32_t));
+}
+
+void LightClusters::prepare(const RenderView& view, glm::vec2 viewport, const std::vector<PointLight>& lights) {
+    viewportSize = viewport;
+    if (view.projection != boxProjection) {
+        // near and far plane of a glm::perspective matrix
+        boxProjection = view.projection;
+        nearPlane = view.projection[3][2] / (view.projection[2][2] - 1.0f);
+        farPlane = view.projection[3][2] / (view.projection[2][2] + 1.0f);
+        sliceDepths.resize(slices + 1);
+        for (unsigned int z = 0; z <= slices; z++)
+            sliceDepths[z] = nearPlane * std::pow(farPlane / nearPlane, float(z) / slices);
+        sliceDepths[slices] = farPlane;
+
+        // direction through every tile corner, scaled to depth 1
+        glm::mat4 inverseProjection = glm::inverse(view.projection);
+        std::vector<glm::vec3> corners((tilesX + 1) * (tilesY + 1));
+        for (unsigned int y = 0; y <= tilesY; y++) {
+            for (unsigned int x = 0; x <= tilesX; x++) {
+                glm::vec4 point = inverseProjection * glm::vec4(-1.0f + 2.0f * x / tilesX, -1.0f + 2.0f * y / tilesY, -1.0f, 1.0f);
+                glm::vec3 direction = glm::vec3(point) / point.w;
+                corners[x + (tilesX + 1) * y] = direction / -direction.z;
+            }
+        }
+        boxes.resize(clusterCount());
+        for (unsigned int z = 0; z < slices; z++) {
+            float nearDepth = sliceDepths[z], farDepth = sliceDepths[z + 1];
+            for (unsigned int y = 0; y < tilesY; y++) {
+                for (unsigned int x = 0; x < tilesX; x++) {
+                    const glm::vec3 tileCorners[4] = { corners[x + (tilesX + 1) * y], corners[x + 1 + (tilesX + 1) * y],
+                                                       corners[x + (tilesX + 1) * (y + 1)], corners[x + 1 + (tilesX + 1) * (y + 1)] };
+                    Box& box = boxes[x + tilesX * (y + tilesY * z)];
+                    box.min = box.max = tileCorners[0] * nearDepth;
+                    for (const glm::vec3& corner : tileCorners) {
+                        box.min = glm::min(box.min, glm::min(corner * nearDepth, corner * farDepth));
+                        box.max = glm::max(box.max, glm::max(corner * nearDepth, corner * farDepth));
+                    }
+                    // the slice's depth range exactly, so the box agrees with the depth test that gathers its lights
+                    box.min.z = -farDepth;
+                    box.max.z = -nearDepth;
+                }
+            }
+        }
+    }
+
+    viewLights.resize(lights.size());
+    for (size_t i = 0; i < lights.size(); i++)
+        viewLights[i] = glm::vec4(glm::vec3(view.view * glm::vec4(lights[i].position, 1.0f)), lights[i].radius);
+}
+
+void LightClusters::assignSlice(unsigned int z, bool simd) {
+    Slice& slice = sliceWork[z];
+    slice.lights.clear();
+    slice.indices.clear();
+    float nearDepth = sliceDepths[z], farDepth = sliceDepths[z + 1];
+    for (size_t i = 0; i < viewLights.size(); i++) {
+        const glm::vec4& light = viewLights[i];
+        float depth = -light.z;
+        if (depth + light.w >= nearDepth && depth - light.w <= farDepth)
+            slice.lights.push(light.x, light.y, light.z, light.w * light.w, static_cast<uint32_t>(i));
+    }
+    slice.counts.assign(tilesX * tilesY, 0);
+    if (slice.lights.size() == 0)
+        return;
+    slice.lights.pad();
+
+    for (unsigned int y = 0; y < tilesY; y++) {
+        // a row's box holds the boxes of its tiles, a light missing it misses all of them
+        const Box* rowBoxes = &boxes[tilesX * (y + tilesY * z)];
+        Box row = rowBoxes[0];
+        for (unsigned int x = 1; x < tilesX; x++) {
+            row.min = glm::min(row.min, rowBoxes[x].min);
+            row.max = glm::max(row.max, rowBoxes[x].max);
+        }
+        slice.hits.clear();
+        touching(row, slice.lights, simd, slice.hits);
+        if (slice.hits.empty())
+            continue;
+        slice.row.clear();
+        for (uint32_t hit : slice.hits)
+            slice.row.push(slice.lights.x[hit], slice.lights.y[hit], slice.lights.z[hit], slice.lights.radiusSquared[hit], slice.lights.light[hit]);
+        slice.row.pad();
+
+        for (unsigned int x = 0; x < tilesX; x++) {
+            slice.hits.clear();
+            touching(rowBoxes[x], slice.row, simd, slice.hits);
+            for (uint32_t hit : slice.hits)
+                slice.indices.push_back(slice.row.light[hit]);
+            slice.counts[x + tilesX * y] = static_cast<uint32_t>(slice.hits.size());
+        }
+    }
+}
+
+void LightClusters::touching(const Box& box, const LightArrays& lights, bool simd, std::vector<uint32_t>& hits) {
+#if LIGHT_CLUSTERS_SSE
+    if (simd) {
+        __m128 zero = _mm_setzero_ps();
+        __m128 minX = _mm_set1_ps(box.min.x), minY = _mm_set1_ps(box.min.y), minZ = _mm_set1_ps(box.min.z);
+        __m128 maxX = _mm_set1_ps(box.max.x), maxY = _mm_set1_ps(box.max.y), maxZ = _mm_set1_ps(box.max.z);
+        for (size_t i = 0; i < lights.size(); i += 4) {
+            // distance from each center to the box along every axis, zero inside
+            __m128 centerX = _mm_loadu_ps(&lights.x[i]), centerY = _mm_loadu_ps(&lights.y[i]), centerZ = _mm_loadu_ps(&lights.z[i]);
+            __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minX, centerX), _mm_sub_ps(centerX, maxX)), zero);
+            __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minY, centerY), _mm_sub_ps(centerY, maxY)), zero);
+            __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minZ, centerZ), _mm_sub_ps(centerZ, maxZ)), zero);
+            __m128 distanceSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+            int touched = _mm_movemask_ps(_mm_cmple_ps(distanceSquared, _mm_loadu_ps(&lights.radiusSquared[i])));
+            for (uint32_t lane = 0; touched != 0; lane++, touched >>= 1) {
+                if (touched & 1)
+                    hits.push_back(static_cast<uint32_t>(i) + lane);
+            }
+        }
+        return;
+    }
+#endif
+    (void)simd;
+    for (size_t i = 0; i < lights.size(); i++) {
+        float dx = std::max(std::max(box.min.x - lights.x[i], lights.x[i] - box.max.x), 0.0f);
+        float dy = std::max(std::max(box.min.y - lights.y[i], lights.y[i] - box.max.y), 0.0f);
+        float dz = std::max(std::max(box.min.z - lights.z[i], lights.z[i] - box.max.z), 0.0f);
+        if (dx * dx + dy * dy + dz * dz <= lights.radiusSquared[i])
+            hits.push_back(static_cast<uint32_t>(i));
+    }
+}
+
+void LightClusters::merge() {
+    unsigned int tiles = tilesX * tilesY;
+    ranges.resize(clusterCount());
+    indices.clear();
+    for (unsigned int z = 0; z < slices; z++) {
+        const Slice& slice = sliceWork[z];
+        // the slice's lists are already in cluster order
+        uint32_t offset = static_cast<uint32_t>(indices.size());
+        for (unsigned int tile = 0; tile < tiles; tile++) {
+            ranges[tile + tiles * z] = ClusterRange{ offset, slice.counts[tile] };
+            offset += slice.counts[tile];
+        }
+        indices.insert(indices.end(), slice.indices.begin(), slice.indices.end());
+    }
+}
@@ -0,0 +1,58 @@
+#include "glad/glad.h"
+#include <material.hpp>
+#include <gl_state.hpp>
+
+#include <atomic>
+#include <string>
+
+namespace {
+
+// materials are created on the loader threads
+std::atomic<unsigned int> nextMaterialId{ 0 };
+
+}
+
+Material::Material(std::vector<Texture> textures, float opacity)
+    : textures(std::move(textures)), id(nextMaterialId++), opacity(opacity), transparent(opacity < 1.0f) {}
+
+void Material::apply(const Shader& shader) {
+    const Binding& bound = binding(shader);
+    for (unsigned int i = 0; i < textures.size(); i++) {
+        shader.set(bound.samplers[i], static_cast<int>(i));
+        GLState::current().bindTexture(i, GL_TEXTURE_2D, textures[i].id);
+    }
+    // shaders that don't blend (e.g. the G-buffer pass) don't declare it
+    if (bound.opacity.valid())
+        shader.set(bound.opacity, opacity);
+}
+
+const Material::Binding& Material::binding(const Shader& shader) {
+    for (const Binding& existing : bindings) {
+        if (existing.program == shader.ID)
+            return existing;
+    }
+
+    // samplers are named after the texture type and a number counting up per type: texture_diffuseN,
+    // texture_specularN, texture_normalN and texture_heightN
+    Binding created;
+    created.program = shader.ID;
+    unsigned int diffuseNr  = 1;
+    unsigned int specularNr = 1;
+    unsigned int normalNr   = 1;
+    unsigned int heightNr   = 1;
+    for (const Texture& texture : textures) {
+        std::string number;
+        if (texture.type == "texture_diffuse")
+            number = std::to_string(diffuseNr++);
+        else if (texture.type == "texture_specular")
+            number = std::to_string(specularNr++);
+        else if (texture.type == "texture_normal")
+            number = std::to_string(normalNr++);
+        else if (texture.type == "texture_height")
+            number = std::to_string(heightNr++);
+        created.samplers.push_back(shader.uniform<int>(texture.type + number));
+    }
+    created.opacity = shader.uniform<float>("opacity");
+    bindings.push_back(std::move(created));
+    return bindings.back();
+}
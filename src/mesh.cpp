@@ -1,91 +1,218 @@
 #include "glad/glad.h"
 #include <mesh.hpp>
+#include <gl_state.hpp>
+#include <vertex_format.hpp>
+#include <render_stats.hpp>
+#include <uniform_ring.hpp>
+#include <atomic>
+#include <cstring>
 #include <string>
 
+namespace {
+
+// object space position of a vertex in any format
+glm::vec3 vertexPosition(VertexFormat format, const unsigned char* vertex) {
+    if (format == VertexFormat::PackedHalf || format == VertexFormat::PackedHalfSkinned) {
+        uint16_t position[3];
+        std::memcpy(position, vertex, sizeof(position));
+        return glm::vec3(halfToFloat(position[0]), halfToFloat(position[1]), halfToFloat(position[2]));
+    }
+    // full vertices and packed float ones both start with three floats
+    glm::vec3 position;
+    std::memcpy(&position, vertex, sizeof(position));
+    return position;
+}
+
+// meshes are created on the loader threads
+std::atomic<unsigned int> nextMeshId{ 0 };
+
+GLenum indexType(unsigned int indexSize) {
+    if (indexSize == sizeof(uint8_t))
+        return GL_UNSIGNED_BYTE;
+    if (indexSize == sizeof(uint16_t))
+        return GL_UNSIGNED_SHORT;
+    return GL_UNSIGNED_INT;
+}
+
+}
+
 Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures) {
-    this->vertices = vertices;
-    this->indices = indices;
+    this->id = nextMeshId++;
+    this->format = VertexFormat::Full;
+    this->vertexCount = static_cast<unsigned int>(vertices.size());
+    this->vertices.resize(vertices.size() * sizeof(Vertex));
+    if (!vertices.empty())
+        std::memcpy(this->vertices.data(), vertices.data(), this->vertices.size());
+    this->indexSize = chooseIndexSize(vertices.size());
+    this->indices = packIndices(indices, this->indexSize);
+    this->textures = textures;
+    this->material = std::make_shared<Material>(textures);
+    this->uvTransform = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+    // a single level of detail until the importer adds more
+    this->lods.assign(1, MeshLod{ 0, indexCount(), 0.0f });
+    computeBounds();
+}
+
+Mesh::Mesh(VertexFormat format, const unsigned char* vertexData, size_t vertexCount, glm::vec4 uvTransform, unsigned int indexSize, const unsigned char* indexData, size_t indexCount, std::vector<Texture> textures) {
+    this->id = nextMeshId++;
+    this->format = format;
+    this->vertexCount = static_cast<unsigned int>(vertexCount);
+    // plain block copies, the data is already in its final layout
+    this->vertices.assign(vertexData, vertexData + vertexCount * vertexStride(format));
+    this->indexSize = indexSize;
+    this->indices.assign(indexData, indexData + indexCount * indexSize);
     this->textures = textures;
+    this->material = std::make_shared<Material>(textures);
+    this->uvTransform = uvTransform;
+    // a single level of detail until the importer adds more
+    this->lods.assign(1, MeshLod{ 0, this->indexCount(), 0.0f });
+    computeBounds();
+}
+
+unsigned int Mesh::index(size_t i) const {
+    if (indexSize == sizeof(uint8_t))
+        return indices[i];
+    if (indexSize == sizeof(uint16_t)) {
+        uint16_t index;
+        std::memcpy(&index, indices.data() + i * sizeof(index), sizeof(index));
+        return index;
+    }
+    uint32_t index;
+    std::memcpy(&index, indices.data() + i * sizeof(index), sizeof(index));
+    return index;
+}
 
-    // now that we have all the required data, set the vertex buffers and its attribute pointers.
-    setupMesh();
+glm::vec3 Mesh::position(size_t i) const {
+    return vertexPosition(format, vertices.data() + i * vertexStride(format));
+}
+
+void Mesh::computeBounds() {
+    // the bounding box, and the sphere around its center that holds every vertex
+    boundsCenter = glm::vec3(0.0f);
+    boundsRadius = 0.0f;
+    boundsExtent = glm::vec3(0.0f);
+    if (vertexCount == 0)
+        return;
+    unsigned int stride = vertexStride(format);
+    glm::vec3 minimum = vertexPosition(format, vertices.data()), maximum = minimum;
+    for (unsigned int i = 1; i < vertexCount; i++) {
+        glm::vec3 position = vertexPosition(format, vertices.data() + size_t(i) * stride);
+        minimum = glm::min(minimum, position);
+        maximum = glm::max(maximum, position);
+    }
+    boundsCenter = (minimum + maximum) * 0.5f;
+    boundsExtent = (maximum - minimum) * 0.5f;
+    for (unsigned int i = 0; i < vertexCount; i++)
+        boundsRadius = glm::max(boundsRadius, glm::length(vertexPosition(format, vertices.data() + size_t(i) * stride) - boundsCenter));
+}
+
+unsigned int Mesh::selectLod(float pixelsPerUnit) const {
+    // walk from the coarsest level towards the full mesh until the error projects to less than a pixel
+    for (size_t i = lods.size(); i-- > 1;) {
+        if (lods[i].error * pixelsPerUnit <= 1.0f)
+            return static_cast<unsigned int>(i);
+    }
+    return 0;
 }
 
-void Mesh::Draw(Shader &shader) {
-    // bind appropriate textures
-    unsigned int diffuseNr  = 1;
-    unsigned int specularNr = 1;
-    unsigned int normalNr   = 1;
-    unsigned int heightNr   = 1;
-    for(unsigned int i = 0; i < textures.size(); i++)
+void Mesh::Draw(Shader &shader, unsigned int lod) {
+    bindMaterial(shader);
+    DrawLevel(lod);
+}
+
+void Mesh::DrawLevel(unsigned int lod) {
+    // draw mesh, the VAO stays bound so the next mesh of the same format doesn't have to bind it again
+    GLState::current().bindVertexArray(VAO);
+    const MeshLod& range = lods[lod < lods.size() ? lod : lods.size() - 1];
+    glDrawElementsBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(range.indexCount), indexType(indexSize),
+                             (void*)(geometry.indexOffset + size_t(indexSize) * range.indexOffset), static_cast<GLint>(geometry.baseVertex));
+    RenderStats::current().frame.drawCalls++;
+    RenderStats::current().frame.triangles += range.indexCount / 3;
+}
+
+void Mesh::DrawLevelInstanced(unsigned int lod, GLsizei instanceCount) {
+    GLState::current().bindVertexArray(VAO);
+    const MeshLod& range = lods[lod < lods.size() ? lod : lods.size() - 1];
+    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(range.indexCount), indexType(indexSize),
+                                      (void*)(geometry.indexOffset + size_t(indexSize) * range.indexOffset), instanceCount, static_cast<GLint>(geometry.baseVertex));
+    RenderStats::current().frame.drawCalls++;
+    RenderStats::current().frame.triangles += (range.indexCount / 3) * static_cast<unsigned long long>(instanceCount);
+}
+
+void Mesh::DrawMeshlets(Shader &shader, const Frustum& frustum, glm::vec3 cameraPosition) {
+    drawCounts.clear();
+    drawOffsets.clear();
+    drawBaseVertices.clear();
+    if (cullMeshlets(frustum, cameraPosition, drawCounts, drawOffsets, drawBaseVertices) == 0)
+        return;
+    bindMaterial(shader);
+    DrawRanges(drawCounts.data(), drawOffsets.data(), drawBaseVertices.data(), static_cast<GLsizei>(drawCounts.size()));
+}
+
+size_t Mesh::cullMeshlets(const Frustum& frustum, glm::vec3 cameraPosition, std::vector<GLsizei>& counts, std::vector<const void*>& offsets, std::vector<GLint>& baseVertices) const {
+    // gather the visible meshlets, neighbours in the index buffer merge into one range
+    size_t first = counts.size();
+    unsigned int culled = 0, end = ~0u;
+    for (const Meshlet& meshlet : meshlets)
     {
-        glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-        // retrieve texture number (the N in diffuse_textureN)
-        std::string number;
-        std::string name = textures[i].type;
-        if(name == "texture_diffuse")
-            number = std::to_string(diffuseNr++);
-        else if(name == "texture_specular")
-            number = std::to_string(specularNr++); // transfer unsigned int to string
-        else if(name == "texture_normal")
-            number = std::to_string(normalNr++); // transfer unsigned int to string
-        else if(name == "texture_height")
-            number = std::to_string(heightNr++); // transfer unsigned int to string
-
-        // now set the sampler to the correct texture unit
-        glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
-        // and finally bind the texture
-        glBindTexture(GL_TEXTURE_2D, textures[i].id);
+        if (meshletOutside(meshlet, frustum) || meshletBackfacing(meshlet, cameraPosition))
+        {
+            culled++;
+            continue;
+        }
+        if (meshlet.indexOffset == end)
+            counts.back() += static_cast<GLsizei>(meshlet.indexCount);
+        else
+        {
+            counts.push_back(static_cast<GLsizei>(meshlet.indexCount));
+            offsets.push_back((const void*)(geometry.indexOffset + size_t(indexSize) * meshlet.indexOffset));
+            baseVertices.push_back(static_cast<GLint>(geometry.baseVertex));
+        }
+        end = meshlet.indexOffset + meshlet.indexCount;
     }
-    
-    // draw mesh
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
-
-    // always good practice to set everything back to defaults once configured.
-    glActiveTexture(GL_TEXTURE0);
-}
-
-void Mesh::setupMesh() {
-    // create buffers/arrays
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
-
-    glBindVertexArray(VAO);
-    // load data into vertex buffers
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    // A great thing about structs is that their memory layout is sequential for all its items.
-    // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-    // again translates to 3/2 floats which translates to a byte array.
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);  
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-    // set the vertex attribute pointers
-    // vertex Positions
-    glEnableVertexAttribArray(0);	
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-    // vertex normals
-    glEnableVertexAttribArray(1);	
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-    // vertex texture coords
-    glEnableVertexAttribArray(2);	
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-    // vertex tangent
-    glEnableVertexAttribArray(3);
-    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-    // vertex bitangent
-    glEnableVertexAttribArray(4);
-    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-    // ids
-    glEnableVertexAttribArray(5);
-    glVertexAttribIPointer(5, 4, GL_INT, sizeof(Vertex), (void*)offsetof(Vertex, m_BoneIDs));
-
-    // weights
-    glEnableVertexAttribArray(6);
-    glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, m_Weights));
-    glBindVertexArray(0);
-}
\ No newline at end of file
+    RenderStats& stats = RenderStats::current();
+    stats.frame.clusters += meshlets.size();
+    stats.frame.clustersCulled += culled;
+    return counts.size() - first;
+}
+
+void Mesh::DrawRanges(const GLsizei* counts, const void* const* offsets, const GLint* baseVertices, GLsizei rangeCount) {
+    GLState::current().bindVertexArray(VAO);
+    glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts, indexType(indexSize), offsets, rangeCount, baseVertices);
+    RenderStats& stats = RenderStats::current();
+    stats.frame.drawCalls++;
+    for (GLsizei i = 0; i < rangeCount; i++)
+        stats.frame.triangles += counts[i] / 3;
+}
+
+void Mesh::bindMaterial(Shader &shader) {
+    material->apply(shader);
+    applyVertexDecoding();
+}
+
+void Mesh::applyVertexDecoding() {
+    UniformRing& ring = UniformRing::shared();
+    if (decodeEpoch != ring.epoch())
+    {
+        // the constants never change, one copy per frame serves every draw of the mesh
+        MeshConstants constants = { uvTransform, isPackedFormat(format) ? 1u : 0u, {} };
+        decodeOffset = ring.write(&constants, sizeof(constants));
+        decodeEpoch = ring.epoch();
+    }
+    ring.bindRange(GL_UNIFORM_BUFFER, MESH_BLOCK_BINDING, decodeOffset, sizeof(MeshConstants));
+}
+
+void Mesh::setupMesh(GeometryArena& arena) {
+    // copy the data into the arena's shared buffers, the VAO belongs to the arena
+    this->arena = &arena;
+    geometry = arena.allocate(format, vertices.data(), vertexCount, indices.data(), indices.size());
+    VAO = geometry.VAO;
+}
+
+void Mesh::releaseGeometry() {
+    if (arena)
+        arena->free(geometry);
+    arena = nullptr;
+    geometry = GeometryAllocation();
+    VAO = 0;
+}
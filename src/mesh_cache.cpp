@@ -0,0 +1,309 @@
+#include <mesh_cache.hpp>
+#include <vertex_format.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace {
+
+const char CACHE_MAGIC[8] = { 'M', 'E', 'S', 'H', 'C', 'A', 'C', 'H' };
+const uint64_t BLOCK_ALIGNMENT = 16;
+// size recorded for a dependency that didn't exist when the cache was written
+const uint64_t MISSING_FILE_SIZE = ~0ull;
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t importFlags;
+    uint32_t optionFlags;
+    uint32_t reserved;
+    uint64_t sourceHash;
+    uint64_t sourceSize;
+    uint32_t vertexSize;
+    uint32_t meshCount;
+    // the dependency block follows the header, the mesh records start at the next aligned offset
+    uint32_t dependencyCount;
+    uint32_t dependencyBytes;
+};
+
+struct MeshRecord {
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint64_t textureOffset;
+    uint64_t meshletOffset;
+    uint32_t vertexCount;
+    uint32_t vertexFormat;
+    uint32_t vertexStride;
+    uint32_t indexCount;
+    uint32_t indexSize;
+    uint32_t textureCount;
+    uint32_t textureBytes;
+    float uvTransform[4];
+    float opacity;
+    uint32_t lodCount;
+    uint32_t lodIndexOffset[MAX_MESH_LODS];
+    uint32_t lodIndexCount[MAX_MESH_LODS];
+    float lodError[MAX_MESH_LODS];
+    uint32_t meshletCount;
+};
+
+uint64_t alignUp(uint64_t value) {
+    return (value + BLOCK_ALIGNMENT - 1) & ~(BLOCK_ALIGNMENT - 1);
+}
+
+// check that [offset, offset + size) lies inside the file
+bool inBounds(uint64_t offset, uint64_t size, uint64_t fileSize) {
+    return offset <= fileSize && size <= fileSize - offset;
+}
+
+void appendU32(std::vector<char>& out, uint32_t value) {
+    const char* p = reinterpret_cast<const char*>(&value);
+    out.insert(out.end(), p, p + sizeof(value));
+}
+
+void appendU64(std::vector<char>& out, uint64_t value) {
+    const char* p = reinterpret_cast<const char*>(&value);
+    out.insert(out.end(), p, p + sizeof(value));
+}
+
+// hash and size of a dependency, files that can't be read are recorded as missing
+void hashDependency(const std::string& path, uint64_t& hash, uint64_t& size) {
+    if (!hashFile(path, hash, &size)) {
+        hash = 0;
+        size = MISSING_FILE_SIZE;
+    }
+}
+
+// check every dependency in the block (path length, path, hash, size) still has the contents it was cached with
+bool dependenciesUnchanged(const unsigned char* p, uint64_t bytes, uint32_t count) {
+    const unsigned char* end = p + bytes;
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t pathLength;
+        if (end - p < static_cast<ptrdiff_t>(sizeof(uint32_t)))
+            return false;
+        std::memcpy(&pathLength, p, sizeof(uint32_t));
+        p += sizeof(uint32_t);
+        if (static_cast<uint64_t>(end - p) < uint64_t(pathLength) + 2 * sizeof(uint64_t))
+            return false;
+        std::string path(reinterpret_cast<const char*>(p), pathLength);
+        p += pathLength;
+        uint64_t cachedHash, cachedSize, hash, size;
+        std::memcpy(&cachedHash, p, sizeof(uint64_t));
+        std::memcpy(&cachedSize, p + sizeof(uint64_t), sizeof(uint64_t));
+        p += 2 * sizeof(uint64_t);
+        hashDependency(path, hash, size);
+        if (hash != cachedHash || size != cachedSize)
+            return false;
+    }
+    return true;
+}
+
+}
+
+std::string MeshCache::cachePath(const std::string& source) {
+    return source + ".meshcache";
+}
+
+bool MeshCache::write(const std::string& source, unsigned int importFlags, unsigned int optionFlags, const std::vector<std::string>& dependencies, const std::vector<Mesh>& meshes) {
+    FileHeader header;
+    std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = MESH_CACHE_VERSION;
+    header.importFlags = importFlags;
+    header.optionFlags = optionFlags;
+    header.reserved = 0;
+    if (!hashFile(source, header.sourceHash, &header.sourceSize))
+        return false;
+    header.vertexSize = sizeof(Vertex);
+    header.meshCount = static_cast<uint32_t>(meshes.size());
+    std::vector<char> dependencyBlock;
+    for (const std::string& dependency : dependencies) {
+        uint64_t hash, size;
+        hashDependency(dependency, hash, size);
+        appendU32(dependencyBlock, static_cast<uint32_t>(dependency.size()));
+        dependencyBlock.insert(dependencyBlock.end(), dependency.begin(), dependency.end());
+        appendU64(dependencyBlock, hash);
+        appendU64(dependencyBlock, size);
+    }
+    header.dependencyCount = static_cast<uint32_t>(dependencies.size());
+    header.dependencyBytes = static_cast<uint32_t>(dependencyBlock.size());
+
+    // lay out every block up front so the records can be written before the data
+    std::vector<MeshRecord> records(meshes.size());
+    std::vector<std::vector<char>> textureBlocks(meshes.size());
+    uint64_t recordOffset = alignUp(sizeof(FileHeader) + dependencyBlock.size());
+    uint64_t offset = recordOffset + sizeof(MeshRecord) * meshes.size();
+    for (size_t i = 0; i < meshes.size(); i++) {
+        const Mesh& mesh = meshes[i];
+        std::vector<char>& block = textureBlocks[i];
+        for (const Texture& texture : mesh.textures) {
+            appendU32(block, static_cast<uint32_t>(texture.type.size()));
+            appendU32(block, static_cast<uint32_t>(texture.path.size()));
+            block.insert(block.end(), texture.type.begin(), texture.type.end());
+            block.insert(block.end(), texture.path.begin(), texture.path.end());
+        }
+
+        MeshRecord& record = records[i];
+        record.vertexCount = mesh.vertexCount;
+        record.vertexFormat = static_cast<uint32_t>(mesh.format);
+        record.vertexStride = vertexStride(mesh.format);
+        for (int c = 0; c < 4; c++)
+            record.uvTransform[c] = mesh.uvTransform[c];
+        record.opacity = mesh.opacity;
+        record.indexCount = mesh.indexCount();
+        record.indexSize = mesh.indexSize;
+        record.lodCount = static_cast<uint32_t>(std::min<size_t>(mesh.lods.size(), MAX_MESH_LODS));
+        for (uint32_t l = 0; l < MAX_MESH_LODS; l++) {
+            bool used = l < record.lodCount;
+            record.lodIndexOffset[l] = used ? mesh.lods[l].indexOffset : 0;
+            record.lodIndexCount[l] = used ? mesh.lods[l].indexCount : 0;
+            record.lodError[l] = used ? mesh.lods[l].error : 0.0f;
+        }
+        record.textureCount = static_cast<uint32_t>(mesh.textures.size());
+        record.textureBytes = static_cast<uint32_t>(block.size());
+        record.textureOffset = offset;
+        offset = alignUp(offset + block.size());
+        record.vertexOffset = offset;
+        offset = alignUp(offset + mesh.vertices.size());
+        record.indexOffset = offset;
+        offset = alignUp(offset + mesh.indices.size());
+        record.meshletCount = static_cast<uint32_t>(mesh.meshlets.size());
+        record.meshletOffset = offset;
+        offset = alignUp(offset + sizeof(Meshlet) * mesh.meshlets.size());
+    }
+
+    // write to a temporary file first so a crash never leaves a half written cache behind
+    std::string path = cachePath(source);
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out)
+            return false;
+        auto pad = [&out]() {
+            static const char zeros[BLOCK_ALIGNMENT] = {};
+            uint64_t position = static_cast<uint64_t>(out.tellp());
+            out.write(zeros, static_cast<std::streamsize>(alignUp(position) - position));
+        };
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(dependencyBlock.data(), static_cast<std::streamsize>(dependencyBlock.size()));
+        pad();
+        out.write(reinterpret_cast<const char*>(records.data()), static_cast<std::streamsize>(sizeof(MeshRecord) * records.size()));
+        for (size_t i = 0; i < meshes.size(); i++) {
+            const Mesh& mesh = meshes[i];
+            out.write(textureBlocks[i].data(), static_cast<std::streamsize>(textureBlocks[i].size()));
+            pad();
+            out.write(reinterpret_cast<const char*>(mesh.vertices.data()), static_cast<std::streamsize>(mesh.vertices.size()));
+            pad();
+            out.write(reinterpret_cast<const char*>(mesh.indices.data()), static_cast<std::streamsize>(mesh.indices.size()));
+            pad();
+            out.write(reinterpret_cast<const char*>(mesh.meshlets.data()), static_cast<std::streamsize>(sizeof(Meshlet) * mesh.meshlets.size()));
+            pad();
+        }
+        if (!out)
+            return false;
+    }
+    std::remove(path.c_str());
+    return std::rename(tempPath.c_str(), path.c_str()) == 0;
+}
+
+bool MeshCache::load(const std::string& source, unsigned int importFlags, unsigned int optionFlags) {
+    entries.clear();
+    if (!file.open(cachePath(source)))
+        return false;
+
+    const unsigned char* base = file.data();
+    uint64_t fileSize = file.size();
+    if (fileSize < sizeof(FileHeader))
+        return false;
+    FileHeader header;
+    std::memcpy(&header, base, sizeof(header));
+    if (std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+        header.version != MESH_CACHE_VERSION ||
+        header.importFlags != importFlags ||
+        header.optionFlags != optionFlags ||
+        header.vertexSize != sizeof(Vertex))
+        return false;
+
+    // the cache is stale as soon as the source contents change
+    uint64_t sourceHash, sourceSize;
+    if (!hashFile(source, sourceHash, &sourceSize) || sourceHash != header.sourceHash || sourceSize != header.sourceSize)
+        return false;
+    // and when any of the files the importer read besides the source does
+    if (!inBounds(sizeof(FileHeader), header.dependencyBytes, fileSize) ||
+        !dependenciesUnchanged(base + sizeof(FileHeader), header.dependencyBytes, header.dependencyCount))
+        return false;
+
+    uint64_t recordOffset = alignUp(sizeof(FileHeader) + uint64_t(header.dependencyBytes));
+    if (!inBounds(recordOffset, sizeof(MeshRecord) * uint64_t(header.meshCount), fileSize))
+        return false;
+    const MeshRecord* records = reinterpret_cast<const MeshRecord*>(base + recordOffset);
+
+    entries.reserve(header.meshCount);
+    for (uint32_t i = 0; i < header.meshCount; i++) {
+        const MeshRecord& record = records[i];
+        VertexFormat format = static_cast<VertexFormat>(record.vertexFormat);
+        if (record.vertexFormat > static_cast<uint32_t>(VertexFormat::PackedFloatSkinned) ||
+            record.vertexStride != vertexStride(format) ||
+            !inBounds(record.vertexOffset, uint64_t(record.vertexStride) * record.vertexCount, fileSize) ||
+            (record.indexSize != 1 && record.indexSize != 2 && record.indexSize != 4) ||
+            !inBounds(record.indexOffset, uint64_t(record.indexSize) * record.indexCount, fileSize) ||
+            !inBounds(record.textureOffset, record.textureBytes, fileSize) ||
+            !inBounds(record.meshletOffset, sizeof(Meshlet) * uint64_t(record.meshletCount), fileSize) ||
+            record.lodCount == 0 || record.lodCount > MAX_MESH_LODS) {
+            entries.clear();
+            return false;
+        }
+
+        CachedMesh mesh;
+        mesh.format = format;
+        mesh.vertices = base + record.vertexOffset;
+        mesh.vertexCount = record.vertexCount;
+        mesh.uvTransform = glm::vec4(record.uvTransform[0], record.uvTransform[1], record.uvTransform[2], record.uvTransform[3]);
+        mesh.opacity = record.opacity;
+        mesh.indexSize = record.indexSize;
+        mesh.indices = base + record.indexOffset;
+        mesh.indexCount = record.indexCount;
+        for (uint32_t l = 0; l < record.lodCount; l++) {
+            if (!inBounds(record.lodIndexOffset[l], record.lodIndexCount[l], record.indexCount)) {
+                entries.clear();
+                return false;
+            }
+            mesh.lods.push_back(MeshLod{ record.lodIndexOffset[l], record.lodIndexCount[l], record.lodError[l] });
+        }
+        mesh.meshlets.resize(record.meshletCount);
+        if (record.meshletCount > 0)
+            std::memcpy(mesh.meshlets.data(), base + record.meshletOffset, sizeof(Meshlet) * record.meshletCount);
+        for (const Meshlet& meshlet : mesh.meshlets) {
+            if (!inBounds(meshlet.indexOffset, meshlet.indexCount, record.indexCount)) {
+                entries.clear();
+                return false;
+            }
+        }
+
+        const unsigned char* p = base + record.textureOffset;
+        const unsigned char* end = p + record.textureBytes;
+        for (uint32_t t = 0; t < record.textureCount; t++) {
+            uint32_t typeLength, pathLength;
+            if (end - p < static_cast<ptrdiff_t>(2 * sizeof(uint32_t))) {
+                entries.clear();
+                return false;
+            }
+            std::memcpy(&typeLength, p, sizeof(uint32_t));
+            std::memcpy(&pathLength, p + sizeof(uint32_t), sizeof(uint32_t));
+            p += 2 * sizeof(uint32_t);
+            if (static_cast<uint64_t>(end - p) < uint64_t(typeLength) + pathLength) {
+                entries.clear();
+                return false;
+            }
+            Texture texture;
+            texture.id = 0;
+            texture.type.assign(reinterpret_cast<const char*>(p), typeLength);
+            texture.path.assign(reinterpret_cast<const char*>(p) + typeLength, pathLength);
+            p += typeLength + pathLength;
+            mesh.textures.push_back(texture);
+        }
+        entries.push_back(std::move(mesh));
+    }
+    return true;
+}
@@ -0,0 +1,261 @@
+#include <mesh_optimizer.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Forsyth's tuning constants, the simulated cache is larger than the real one on purpose
+const int FORSYTH_CACHE_SIZE = 32;
+const float FORSYTH_CACHE_DECAY_POWER = 1.5f;
+const float FORSYTH_LAST_TRIANGLE_SCORE = 0.75f;
+const float FORSYTH_VALENCE_BOOST_SCALE = 2.0f;
+const float FORSYTH_VALENCE_BOOST_POWER = 0.5f;
+
+// soft clusters shorter than this aren't worth sorting on their own
+const unsigned int MIN_CLUSTER_TRIANGLES = 8;
+
+float vertexScore(int cachePosition, unsigned int remainingValence) {
+    // no triangles left to draw with this vertex
+    if (remainingValence == 0)
+        return -1.0f;
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        // the vertices of the last triangle get a fixed score so the next one doesn't favour any of them
+        if (cachePosition < 3)
+            score = FORSYTH_LAST_TRIANGLE_SCORE;
+        else
+            score = std::pow(1.0f - float(cachePosition - 3) / float(FORSYTH_CACHE_SIZE - 3), FORSYTH_CACHE_DECAY_POWER);
+    }
+    // boost vertices with few triangles left so they get finished off instead of lingering
+    score += FORSYTH_VALENCE_BOOST_SCALE * std::pow(float(remainingValence), -FORSYTH_VALENCE_BOOST_POWER);
+    return score;
+}
+
+struct Cluster {
+    size_t start;
+    size_t end;
+    float sortKey;
+};
+
+}
+
+VertexCacheStats analyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount, unsigned int cacheSize) {
+    VertexCacheStats stats;
+    // a vertex is still cached while fewer than cacheSize other vertices were transformed after it
+    std::vector<unsigned int> timestamps(vertexCount, 0);
+    unsigned int time = cacheSize + 1;
+    for (unsigned int index : indices) {
+        if (time - timestamps[index] > cacheSize) {
+            timestamps[index] = time++;
+            stats.transformed++;
+        }
+    }
+    size_t triangleCount = indices.size() / 3;
+    stats.acmr = triangleCount ? float(stats.transformed) / triangleCount : 0.0f;
+    stats.atvr = vertexCount ? float(stats.transformed) / vertexCount : 0.0f;
+    return stats;
+}
+
+void optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount) {
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    // triangles using each vertex, the live part of every list shrinks as triangles get emitted
+    std::vector<unsigned int> remaining(vertexCount, 0);
+    for (unsigned int index : indices)
+        remaining[index]++;
+    std::vector<unsigned int> offsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+        offsets[v + 1] = offsets[v] + remaining[v];
+    std::vector<unsigned int> adjacency(indices.size());
+    {
+        std::vector<unsigned int> cursor(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); i++)
+            adjacency[cursor[indices[i]]++] = static_cast<unsigned int>(i / 3);
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> scores(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        scores[v] = vertexScore(-1, remaining[v]);
+    std::vector<float> triangleScores(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++)
+        triangleScores[t] = scores[indices[t * 3]] + scores[indices[t * 3 + 1]] + scores[indices[t * 3 + 2]];
+    std::vector<bool> emitted(triangleCount, false);
+
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+    std::vector<unsigned int> cache, nextCache;
+    cache.reserve(FORSYTH_CACHE_SIZE + 3);
+    nextCache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+    size_t best = std::max_element(triangleScores.begin(), triangleScores.end()) - triangleScores.begin();
+    size_t scanCursor = 0;
+    for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++) {
+        if (best == triangleCount) {
+            // dead end: none of the cached vertices has triangles left, continue with the next one in input order
+            while (emitted[scanCursor])
+                scanCursor++;
+            best = scanCursor;
+        }
+
+        const unsigned int* triangle = &indices[best * 3];
+        result.insert(result.end(), triangle, triangle + 3);
+        emitted[best] = true;
+
+        // take the triangle out of its vertices' live lists
+        for (int k = 0; k < 3; k++) {
+            unsigned int v = triangle[k];
+            unsigned int* list = &adjacency[offsets[v]];
+            unsigned int* last = list + remaining[v] - 1;
+            *std::find(list, last + 1, static_cast<unsigned int>(best)) = *last;
+            remaining[v]--;
+        }
+
+        // the triangle's vertices move to the front of the cache, the rest shifts back and may fall out
+        nextCache.assign(triangle, triangle + 3);
+        for (unsigned int v : cache)
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+                nextCache.push_back(v);
+        for (size_t i = FORSYTH_CACHE_SIZE; i < nextCache.size(); i++) {
+            cachePosition[nextCache[i]] = -1;
+            scores[nextCache[i]] = vertexScore(-1, remaining[nextCache[i]]);
+        }
+        if (nextCache.size() > size_t(FORSYTH_CACHE_SIZE))
+            nextCache.resize(FORSYTH_CACHE_SIZE);
+        cache.swap(nextCache);
+
+        for (size_t i = 0; i < cache.size(); i++) {
+            cachePosition[cache[i]] = static_cast<int>(i);
+            scores[cache[i]] = vertexScore(static_cast<int>(i), remaining[cache[i]]);
+        }
+
+        // the next triangle is the best one touching the cache
+        best = triangleCount;
+        float bestScore = -1.0f;
+        for (unsigned int v : cache) {
+            for (unsigned int i = 0; i < remaining[v]; i++) {
+                unsigned int t = adjacency[offsets[v] + i];
+                float score = scores[indices[t * 3]] + scores[indices[t * 3 + 1]] + scores[indices[t * 3 + 2]];
+                triangleScores[t] = score;
+                if (score > bestScore) {
+                    bestScore = score;
+                    best = t;
+                }
+            }
+        }
+    }
+    indices.swap(result);
+}
+
+void optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices, float threshold) {
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    // 1. hard boundaries: triangles where the cache starts over because none of their vertices is cached
+    std::vector<unsigned int> timestamps(vertices.size(), 0);
+    unsigned int time = VERTEX_CACHE_SIZE + 1;
+    std::vector<size_t> hardBoundaries;
+    std::vector<unsigned char> triangleMisses(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++) {
+        int misses = 0;
+        for (int k = 0; k < 3; k++) {
+            unsigned int v = indices[t * 3 + k];
+            if (time - timestamps[v] > VERTEX_CACHE_SIZE) {
+                timestamps[v] = time++;
+                misses++;
+            }
+        }
+        triangleMisses[t] = static_cast<unsigned char>(misses);
+        if (t == 0 || misses == 3)
+            hardBoundaries.push_back(t);
+    }
+    hardBoundaries.push_back(triangleCount);
+
+    // 2. soft boundaries: split hard clusters further wherever the running ACMR already is within the threshold of
+    // the whole cluster's, so reordering them costs at most that many extra transforms
+    std::vector<Cluster> clusters;
+    for (size_t h = 0; h + 1 < hardBoundaries.size(); h++) {
+        size_t start = hardBoundaries[h], end = hardBoundaries[h + 1];
+        unsigned int hardMisses = 0;
+        for (size_t t = start; t < end; t++)
+            hardMisses += triangleMisses[t];
+        float target = float(hardMisses) / (end - start) * threshold;
+
+        // restart the simulated cache for every soft cluster, it's drawn after an unknown one
+        time += VERTEX_CACHE_SIZE + 1;
+        size_t clusterStart = start;
+        unsigned int misses = 0;
+        for (size_t t = start; t < end; t++) {
+            for (int k = 0; k < 3; k++) {
+                unsigned int v = indices[t * 3 + k];
+                if (time - timestamps[v] > VERTEX_CACHE_SIZE) {
+                    timestamps[v] = time++;
+                    misses++;
+                }
+            }
+            size_t clusterTriangles = t + 1 - clusterStart;
+            if (t + 1 < end && clusterTriangles >= MIN_CLUSTER_TRIANGLES && float(misses) / clusterTriangles <= target) {
+                clusters.push_back(Cluster{ clusterStart, t + 1, 0.0f });
+                clusterStart = t + 1;
+                misses = 0;
+                time += VERTEX_CACHE_SIZE + 1;
+            }
+        }
+        clusters.push_back(Cluster{ clusterStart, end, 0.0f });
+    }
+
+    // 3. sort clusters by how far out they face: dot(cluster centroid - mesh centroid, cluster normal)
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    std::vector<glm::vec3> clusterCentroids(clusters.size()), clusterNormals(clusters.size());
+    for (size_t c = 0; c < clusters.size(); c++) {
+        glm::vec3 centroid(0.0f), normal(0.0f);
+        float area = 0.0f;
+        for (size_t t = clusters[c].start; t < clusters[c].end; t++) {
+            const glm::vec3& a = vertices[indices[t * 3]].Position;
+            const glm::vec3& b = vertices[indices[t * 3 + 1]].Position;
+            const glm::vec3& d = vertices[indices[t * 3 + 2]].Position;
+            // area weighted, the cross product's length is twice the triangle area
+            glm::vec3 cross = glm::cross(b - a, d - a);
+            float triangleArea = glm::length(cross);
+            centroid += (a + b + d) * (triangleArea / 3.0f);
+            normal += cross;
+            area += triangleArea;
+        }
+        meshCentroid += centroid;
+        meshArea += area;
+        clusterCentroids[c] = area > 0.0f ? centroid / area : centroid;
+        float normalLength = glm::length(normal);
+        clusterNormals[c] = normalLength > 0.0f ? normal / normalLength : normal;
+    }
+    if (meshArea > 0.0f)
+        meshCentroid /= meshArea;
+    for (size_t c = 0; c < clusters.size(); c++)
+        clusters[c].sortKey = glm::dot(clusterCentroids[c] - meshCentroid, clusterNormals[c]);
+    std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+    for (const Cluster& cluster : clusters)
+        result.insert(result.end(), indices.begin() + cluster.start * 3, indices.begin() + cluster.end * 3);
+    indices.swap(result);
+}
+
+void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+    const unsigned int unused = ~0u;
+    std::vector<unsigned int> remap(vertices.size(), unused);
+    std::vector<Vertex> result;
+    result.reserve(vertices.size());
+    for (unsigned int& index : indices) {
+        if (remap[index] == unused) {
+            remap[index] = static_cast<unsigned int>(result.size());
+            result.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(result);
+}
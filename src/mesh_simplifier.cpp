@@ -0,0 +1,290 @@
+#include <mesh_simplifier.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <unordered_map>
+
+namespace {
+
+// open borders are held in place by planes through the border edge, weighted like this many triangles
+const double BORDER_WEIGHT = 10.0;
+
+// symmetric 4x4 error quadric: the weighted sum of squared distances to a set of planes
+struct Quadric {
+    double a00 = 0, a11 = 0, a22 = 0, a01 = 0, a02 = 0, a12 = 0;
+    double b0 = 0, b1 = 0, b2 = 0;
+    double c = 0;
+    double weight = 0;
+
+    // plane n.p + d = 0 with a unit normal
+    static Quadric plane(glm::dvec3 n, double d, double weight) {
+        Quadric q;
+        q.a00 = weight * n.x * n.x;
+        q.a11 = weight * n.y * n.y;
+        q.a22 = weight * n.z * n.z;
+        q.a01 = weight * n.x * n.y;
+        q.a02 = weight * n.x * n.z;
+        q.a12 = weight * n.y * n.z;
+        q.b0 = weight * n.x * d;
+        q.b1 = weight * n.y * d;
+        q.b2 = weight * n.z * d;
+        q.c = weight * d * d;
+        q.weight = weight;
+        return q;
+    }
+
+    Quadric& operator+=(const Quadric& other) {
+        a00 += other.a00; a11 += other.a11; a22 += other.a22;
+        a01 += other.a01; a02 += other.a02; a12 += other.a12;
+        b0 += other.b0; b1 += other.b1; b2 += other.b2;
+        c += other.c;
+        weight += other.weight;
+        return *this;
+    }
+
+    // weighted average of the squared distances from p to the planes
+    double error(glm::dvec3 p) const {
+        double e = a00 * p.x * p.x + a11 * p.y * p.y + a22 * p.z * p.z
+                 + 2.0 * (a01 * p.x * p.y + a02 * p.x * p.z + a12 * p.y * p.z)
+                 + 2.0 * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+        return weight > 0.0 ? std::fabs(e) / weight : 0.0;
+    }
+};
+
+enum class VertexKind : unsigned char {
+    Manifold,   // interior vertex, can collapse onto any neighbour
+    Border,     // on an open border, can only slide along it
+    Locked      // seam, corner or non-manifold vertex, never moves
+};
+
+struct Collapse {
+    unsigned int from;
+    unsigned int to;
+    double cost;
+};
+
+uint64_t edgeKey(unsigned int a, unsigned int b) {
+    return (uint64_t(a) << 32) | b;
+}
+
+}
+
+float meshExtent(const std::vector<Vertex>& vertices) {
+    if (vertices.empty())
+        return 0.0f;
+    glm::vec3 minimum = vertices[0].Position, maximum = vertices[0].Position;
+    for (const Vertex& vertex : vertices) {
+        minimum = glm::min(minimum, vertex.Position);
+        maximum = glm::max(maximum, vertex.Position);
+    }
+    return glm::length(maximum - minimum);
+}
+
+std::vector<unsigned int> simplifyMesh(const std::vector<unsigned int>& sourceIndices, const std::vector<Vertex>& vertices, size_t targetIndexCount, float targetError, float* resultError) {
+    std::vector<unsigned int> indices(sourceIndices);
+    if (resultError)
+        *resultError = 0.0f;
+    size_t vertexCount = vertices.size();
+    if (indices.size() <= targetIndexCount || vertexCount == 0)
+        return indices;
+
+    // work in a unit sized space so the errors are relative to the mesh
+    float extent = meshExtent(vertices);
+    double scale = extent > 0.0f ? 1.0 / extent : 1.0;
+    std::vector<glm::dvec3> positions(vertexCount);
+    for (size_t i = 0; i < vertexCount; i++)
+        positions[i] = glm::dvec3(vertices[i].Position - vertices[0].Position) * scale;
+
+    // vertices sharing a position (texture seams, hard edges) belong to the same corner of the surface
+    std::vector<unsigned int> order(vertexCount);
+    std::iota(order.begin(), order.end(), 0u);
+    auto lessPosition = [&vertices](unsigned int a, unsigned int b) {
+        const glm::vec3& p = vertices[a].Position;
+        const glm::vec3& q = vertices[b].Position;
+        return p.x != q.x ? p.x < q.x : p.y != q.y ? p.y < q.y : p.z < q.z;
+    };
+    std::sort(order.begin(), order.end(), lessPosition);
+    std::vector<unsigned int> corner(vertexCount);
+    std::vector<unsigned int> wedges(vertexCount, 0);
+    for (size_t i = 0; i < vertexCount; i++) {
+        bool same = i > 0 && !lessPosition(order[i - 1], order[i]);
+        corner[order[i]] = same ? corner[order[i - 1]] : order[i];
+        wedges[corner[order[i]]]++;
+    }
+
+    // directed edges between corners, an edge without its twin lies on an open border
+    std::unordered_map<uint64_t, unsigned int> edges;
+    edges.reserve(indices.size());
+    for (size_t t = 0; t < indices.size(); t += 3)
+        for (int k = 0; k < 3; k++)
+            edges[edgeKey(corner[indices[t + k]], corner[indices[t + (k + 1) % 3]])]++;
+    auto isBorder = [&edges](unsigned int a, unsigned int b) {
+        return edges.find(edgeKey(b, a)) == edges.end();
+    };
+
+    std::vector<VertexKind> kinds(vertexCount, VertexKind::Manifold);
+    std::vector<unsigned int> bordersOut(vertexCount, 0), bordersIn(vertexCount, 0);
+    for (const auto& edge : edges) {
+        unsigned int a = static_cast<unsigned int>(edge.first >> 32);
+        unsigned int b = static_cast<unsigned int>(edge.first & 0xffffffffu);
+        if (edge.second > 1) {
+            kinds[a] = kinds[b] = VertexKind::Locked;
+        } else if (isBorder(a, b)) {
+            bordersOut[a]++;
+            bordersIn[b]++;
+        }
+    }
+    for (size_t i = 0; i < vertexCount; i++) {
+        if (corner[i] != i)
+            continue;
+        if (wedges[i] > 1 || bordersOut[i] > 1 || bordersIn[i] > 1 || bordersOut[i] != bordersIn[i])
+            kinds[i] = VertexKind::Locked;
+        else if (kinds[i] != VertexKind::Locked && bordersOut[i] == 1)
+            kinds[i] = VertexKind::Border;
+    }
+
+    // every corner starts with the planes of its triangles, weighted by their area
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t t = 0; t < indices.size(); t += 3) {
+        glm::dvec3 p0 = positions[indices[t]], p1 = positions[indices[t + 1]], p2 = positions[indices[t + 2]];
+        glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+        double area = glm::length(normal);
+        if (area == 0.0)
+            continue;
+        normal /= area;
+        Quadric q = Quadric::plane(normal, -glm::dot(normal, p0), area);
+        for (int k = 0; k < 3; k++)
+            quadrics[corner[indices[t + k]]] += q;
+
+        // a plane through each border edge, perpendicular to the triangle, keeps the border from shrinking
+        for (int k = 0; k < 3; k++) {
+            unsigned int a = corner[indices[t + k]], b = corner[indices[t + (k + 1) % 3]];
+            if (!isBorder(a, b))
+                continue;
+            glm::dvec3 edge = positions[b] - positions[a];
+            double length = glm::length(edge);
+            if (length == 0.0)
+                continue;
+            glm::dvec3 borderNormal = glm::normalize(glm::cross(edge, normal));
+            Quadric border = Quadric::plane(borderNormal, -glm::dot(borderNormal, positions[a]), length * length * BORDER_WEIGHT);
+            quadrics[a] += border;
+            quadrics[b] += border;
+        }
+    }
+
+    // a vertex can only move when it's the sole vertex at its corner, so collapses never tear seams apart
+    auto canCollapse = [&](unsigned int from, unsigned int to) {
+        unsigned int a = corner[from], b = corner[to];
+        if (a == b || wedges[a] > 1)
+            return false;
+        if (kinds[a] == VertexKind::Manifold)
+            return true;
+        return kinds[a] == VertexKind::Border && (isBorder(a, b) || isBorder(b, a));
+    };
+
+    double maxError = double(targetError) * double(targetError);
+    double reachedError = 0.0;
+    std::vector<unsigned int> triangleOffsets(vertexCount + 1), vertexTriangles;
+    std::vector<unsigned int> collapseTo(vertexCount);
+    std::vector<bool> touched(vertexCount);
+    std::vector<Collapse> collapses;
+    while (indices.size() > targetIndexCount) {
+        size_t triangleCount = indices.size() / 3;
+        // triangles around every vertex
+        std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0u);
+        for (unsigned int index : indices)
+            triangleOffsets[index + 1]++;
+        std::partial_sum(triangleOffsets.begin(), triangleOffsets.end(), triangleOffsets.begin());
+        vertexTriangles.resize(indices.size());
+        {
+            std::vector<unsigned int> cursor(triangleOffsets.begin(), triangleOffsets.end() - 1);
+            for (size_t i = 0; i < indices.size(); i++)
+                vertexTriangles[cursor[indices[i]]++] = static_cast<unsigned int>(i / 3);
+        }
+
+        // cost of moving each vertex onto each of its neighbours
+        collapses.clear();
+        for (size_t t = 0; t < triangleCount; t++) {
+            for (int k = 0; k < 3; k++) {
+                unsigned int a = indices[t * 3 + k], b = indices[t * 3 + (k + 1) % 3];
+                if (canCollapse(a, b)) {
+                    Quadric q = quadrics[corner[a]];
+                    q += quadrics[corner[b]];
+                    collapses.push_back(Collapse{ a, b, q.error(positions[b]) });
+                }
+                if (canCollapse(b, a)) {
+                    Quadric q = quadrics[corner[a]];
+                    q += quadrics[corner[b]];
+                    collapses.push_back(Collapse{ b, a, q.error(positions[a]) });
+                }
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+
+        // take the cheapest collapses whose neighbourhoods don't overlap, so each one sees the mesh as it will be
+        std::iota(collapseTo.begin(), collapseTo.end(), 0u);
+        std::fill(touched.begin(), touched.end(), false);
+        size_t trianglesToRemove = (indices.size() - targetIndexCount + 2) / 3;
+        size_t removed = 0, applied = 0;
+        for (const Collapse& collapse : collapses) {
+            if (collapse.cost > maxError || removed >= trianglesToRemove)
+                break;
+            if (touched[collapse.from] || touched[collapse.to])
+                continue;
+
+            // the triangles that stay must not flip over
+            bool flips = false;
+            size_t removes = 0;
+            glm::dvec3 target = positions[collapse.to];
+            for (unsigned int i = triangleOffsets[collapse.from]; i < triangleOffsets[collapse.from + 1] && !flips; i++) {
+                const unsigned int* triangle = &indices[vertexTriangles[i] * 3];
+                bool degenerate = false;
+                glm::dvec3 before[3], after[3];
+                for (int k = 0; k < 3; k++) {
+                    before[k] = after[k] = positions[triangle[k]];
+                    if (triangle[k] == collapse.from)
+                        after[k] = target;
+                    else if (corner[triangle[k]] == corner[collapse.to])
+                        degenerate = true;
+                }
+                if (degenerate) {
+                    removes++;
+                    continue;
+                }
+                glm::dvec3 n0 = glm::cross(before[1] - before[0], before[2] - before[0]);
+                glm::dvec3 n1 = glm::cross(after[1] - after[0], after[2] - after[0]);
+                flips = glm::dot(n0, n1) <= 0.0;
+            }
+            if (flips)
+                continue;
+
+            collapseTo[collapse.from] = collapse.to;
+            for (unsigned int i = triangleOffsets[collapse.from]; i < triangleOffsets[collapse.from + 1]; i++)
+                for (int k = 0; k < 3; k++)
+                    touched[indices[vertexTriangles[i] * 3 + k]] = true;
+            quadrics[corner[collapse.to]] += quadrics[corner[collapse.from]];
+            reachedError = std::max(reachedError, collapse.cost);
+            removed += removes;
+            applied++;
+        }
+        if (applied == 0)
+            break;
+
+        // move the collapsed vertices and drop the triangles that became degenerate
+        size_t write = 0;
+        for (size_t t = 0; t < triangleCount; t++) {
+            unsigned int a = collapseTo[indices[t * 3]], b = collapseTo[indices[t * 3 + 1]], c = collapseTo[indices[t * 3 + 2]];
+            if (corner[a] == corner[b] || corner[b] == corner[c] || corner[a] == corner[c])
+                continue;
+            indices[write++] = a;
+            indices[write++] = b;
+            indices[write++] = c;
+        }
+        indices.resize(write);
+    }
+
+    if (resultError)
+        *resultError = static_cast<float>(std::sqrt(reachedError));
+    return indices;
+}
@@ -0,0 +1,176 @@
+#include <meshlet.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// normals wider apart than this (about 84 degrees from the average) make the cone useless for culling
+const float MIN_CONE_DOT = 0.1f;
+
+// bounds and normal cone of the triangles in the meshlet's index range
+void computeMeshletBounds(Meshlet& meshlet, const std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices, const std::vector<glm::vec3>& normals, size_t firstTriangle) {
+    size_t begin = meshlet.indexOffset, end = begin + meshlet.indexCount;
+    glm::vec3 minimum = vertices[indices[begin]].Position, maximum = minimum;
+    for (size_t i = begin; i < end; i++) {
+        minimum = glm::min(minimum, vertices[indices[i]].Position);
+        maximum = glm::max(maximum, vertices[indices[i]].Position);
+    }
+    meshlet.center = (minimum + maximum) * 0.5f;
+    meshlet.radius = 0.0f;
+    for (size_t i = begin; i < end; i++)
+        meshlet.radius = glm::max(meshlet.radius, glm::length(vertices[indices[i]].Position - meshlet.center));
+
+    glm::vec3 axis(0.0f);
+    for (size_t t = 0; t < meshlet.indexCount / 3; t++)
+        axis += normals[firstTriangle + t];
+    meshlet.coneApex = meshlet.center;
+    meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+    meshlet.coneCutoff = 2.0f;
+    float axisLength = glm::length(axis);
+    if (axisLength == 0.0f)
+        return;
+    axis /= axisLength;
+    meshlet.coneAxis = axis;
+
+    float minimumDot = 1.0f;
+    for (size_t t = 0; t < meshlet.indexCount / 3; t++) {
+        const glm::vec3& normal = normals[firstTriangle + t];
+        // degenerate triangles can't be seen from any side
+        if (normal != glm::vec3(0.0f))
+            minimumDot = glm::min(minimumDot, glm::dot(axis, normal));
+    }
+    if (minimumDot <= MIN_CONE_DOT)
+        return;
+
+    // move the apex back along the axis until it's behind every triangle's plane
+    float maximumT = 0.0f;
+    for (size_t t = 0; t < meshlet.indexCount / 3; t++) {
+        const glm::vec3& normal = normals[firstTriangle + t];
+        if (normal == glm::vec3(0.0f))
+            continue;
+        const glm::vec3& p0 = vertices[indices[begin + t * 3]].Position;
+        maximumT = glm::max(maximumT, glm::dot(meshlet.center - p0, normal) / glm::dot(axis, normal));
+    }
+    meshlet.coneApex = meshlet.center - axis * maximumT;
+    meshlet.coneCutoff = std::sqrt(1.0f - minimumDot * minimumDot);
+}
+
+}
+
+std::vector<Meshlet> buildMeshlets(std::vector<unsigned int>& indices, size_t offset, size_t count, const std::vector<Vertex>& vertices) {
+    std::vector<Meshlet> meshlets;
+    size_t triangleCount = count / 3;
+    if (triangleCount == 0)
+        return meshlets;
+    const unsigned int* source = indices.data() + offset;
+
+    std::vector<glm::vec3> normals(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++) {
+        const glm::vec3& p0 = vertices[source[t * 3]].Position;
+        glm::vec3 normal = glm::cross(vertices[source[t * 3 + 1]].Position - p0, vertices[source[t * 3 + 2]].Position - p0);
+        float length = glm::length(normal);
+        normals[t] = length > 0.0f ? normal / length : glm::vec3(0.0f);
+    }
+
+    // triangles using each vertex
+    std::vector<unsigned int> triangleOffsets(vertices.size() + 1, 0);
+    for (size_t i = 0; i < triangleCount * 3; i++)
+        triangleOffsets[source[i] + 1]++;
+    for (size_t v = 0; v < vertices.size(); v++)
+        triangleOffsets[v + 1] += triangleOffsets[v];
+    std::vector<unsigned int> vertexTriangles(triangleCount * 3);
+    {
+        std::vector<unsigned int> cursor(triangleOffsets.begin(), triangleOffsets.end() - 1);
+        for (size_t i = 0; i < triangleCount * 3; i++)
+            vertexTriangles[cursor[source[i]]++] = static_cast<unsigned int>(i / 3);
+    }
+
+    std::vector<unsigned int> ordered;
+    ordered.reserve(triangleCount * 3);
+    std::vector<glm::vec3> orderedNormals;
+    orderedNormals.reserve(triangleCount);
+    std::vector<bool> used(triangleCount, false);
+    // id of the meshlet each vertex was last added to
+    std::vector<unsigned int> vertexMeshlet(vertices.size(), ~0u);
+    std::vector<unsigned int> meshletVertices;
+    meshletVertices.reserve(MESHLET_MAX_VERTICES);
+    size_t scanCursor = 0;
+
+    while (ordered.size() < triangleCount * 3) {
+        unsigned int id = static_cast<unsigned int>(meshlets.size());
+        Meshlet meshlet;
+        meshlet.indexOffset = static_cast<unsigned int>(offset + ordered.size());
+        meshletVertices.clear();
+        glm::vec3 normalSum(0.0f);
+
+        auto addTriangle = [&](size_t t) {
+            used[t] = true;
+            for (int k = 0; k < 3; k++) {
+                unsigned int v = source[t * 3 + k];
+                if (vertexMeshlet[v] != id) {
+                    vertexMeshlet[v] = id;
+                    meshletVertices.push_back(v);
+                }
+                ordered.push_back(v);
+            }
+            orderedNormals.push_back(normals[t]);
+            normalSum += normals[t];
+        };
+
+        // start from the first triangle left in the input order, which keeps the vertex cache order mostly intact
+        while (used[scanCursor])
+            scanCursor++;
+        addTriangle(scanCursor);
+        for (size_t triangles = 1; triangles < MESHLET_MAX_TRIANGLES; triangles++) {
+            // grow by the neighbouring triangle that adds the fewest vertices, then the one closest to the cluster's facing
+            size_t best = triangleCount;
+            int bestNew = 4;
+            float bestDot = -2.0f;
+            for (unsigned int v : meshletVertices) {
+                for (unsigned int i = triangleOffsets[v]; i < triangleOffsets[v + 1]; i++) {
+                    unsigned int t = vertexTriangles[i];
+                    if (used[t])
+                        continue;
+                    int added = 0;
+                    for (int k = 0; k < 3; k++)
+                        added += vertexMeshlet[source[t * 3 + k]] != id ? 1 : 0;
+                    if (meshletVertices.size() + added > MESHLET_MAX_VERTICES)
+                        continue;
+                    float facing = glm::dot(normals[t], normalSum);
+                    if (added < bestNew || (added == bestNew && facing > bestDot)) {
+                        best = t;
+                        bestNew = added;
+                        bestDot = facing;
+                    }
+                }
+            }
+            if (best == triangleCount)
+                break;
+            addTriangle(best);
+        }
+
+        meshlet.indexCount = static_cast<unsigned int>(offset + ordered.size() - meshlet.indexOffset);
+        meshlets.push_back(meshlet);
+    }
+
+    std::copy(ordered.begin(), ordered.end(), indices.begin() + offset);
+    for (size_t i = 0, first = 0; i < meshlets.size(); i++) {
+        computeMeshletBounds(meshlets[i], indices, vertices, orderedNormals, first);
+        first += meshlets[i].indexCount / 3;
+    }
+    return meshlets;
+}
+
+bool meshletOutside(const Meshlet& meshlet, const Frustum& frustum) {
+    return !frustum.intersectsSphere(meshlet.center, meshlet.radius);
+}
+
+bool meshletBackfacing(const Meshlet& meshlet, glm::vec3 cameraPosition) {
+    glm::vec3 direction = meshlet.coneApex - cameraPosition;
+    float length = glm::length(direction);
+    // the camera sits right on the apex, don't guess
+    if (length == 0.0f)
+        return false;
+    return glm::dot(direction / length, meshlet.coneAxis) >= meshlet.coneCutoff;
+}
@@ -1,33 +1,284 @@
 #include "assimp/postprocess.h"
 #include <assimp/material.h>
+#include <assimp/DefaultIOSystem.h>
 #include <model.hpp>
-#include <stb_image.h>
+#include <render_stats.hpp>
+#include <instance_buffer.hpp>
+#include <mesh_cache.hpp>
+#include <mesh_optimizer.hpp>
+#include <mesh_simplifier.hpp>
+#include <texture_cache.hpp>
+#include <thread_pool.hpp>
+#include <uniform_ring.hpp>
+#include <vertex_format.hpp>
 
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <limits>
 
-unsigned int TextureFromFile(const char*, const std::string&, bool = false);
+// post-processing applied on import, part of the mesh cache key
+const unsigned int IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace | aiProcess_JoinIdenticalVertices;
+// each level of detail aims for this fraction of the previous one's triangles
+const float LOD_REDUCTION = 0.5f;
+// a level that can't get below this fraction of the previous one isn't worth keeping
+const float LOD_MIN_REDUCTION = 0.8f;
+// largest simplification error accepted for a level, relative to the mesh size
+const float LOD_MAX_ERROR = 0.05f;
 
-void Model::Draw(Shader& shader) {
+namespace {
+
+// Default file access that remembers every file the importer looks for besides the source itself, like the
+// material libraries of an .obj, so the mesh cache can tell when one of them changes
+class RecordingIOSystem : public Assimp::DefaultIOSystem {
+public:
+    explicit RecordingIOSystem(const std::string& source) : source(source) {}
+
+    bool Exists(const char* path) const override {
+        record(path);
+        return DefaultIOSystem::Exists(path);
+    }
+    Assimp::IOStream* Open(const char* path, const char* mode = "rb") override {
+        record(path);
+        return DefaultIOSystem::Open(path, mode);
+    }
+
+    const std::vector<std::string>& files() const { return opened; }
+private:
+    std::string source;
+    mutable std::vector<std::string> opened;
+
+    void record(const char* path) const {
+        if (path != source && std::find(opened.begin(), opened.end(), path) == opened.end())
+            opened.push_back(path);
+    }
+};
+
+// the largest axis scale of a model matrix turns object space errors and radii into world space ones
+float largestScale(const glm::mat4& model) {
+    return glm::max(glm::length(glm::vec3(model[0])), glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+}
+
+// Level of detail a mesh is drawn at
+unsigned int meshLod(const Mesh& mesh, const RenderView& view, const glm::mat4& model, float scale) {
+    glm::vec3 center = glm::vec3(model * glm::vec4(mesh.boundsCenter, 1.0f));
+    float distance = glm::length(center - view.cameraPosition) - mesh.boundsRadius * scale;
+    // full detail once the camera is inside the bounds
+    return distance > 0.0f ? mesh.selectLod(view.pixelsPerUnit(distance) * scale) : 0;
+}
+
+}
+
+Model::~Model() {
+    // hand the geometry back to the arena, a model's own arena goes away with it
+    for (Mesh& mesh : meshes)
+        mesh.releaseGeometry();
+    // give back our references on the shared textures
+    for (const Texture& texture : textures_loaded)
+        TextureCache::instance().release(texture.id);
+}
+
+void Model::Draw(Shader& shader, const glm::mat4& model) {
+    // the meshes are still being filled in by the loader thread
+    ModelState current = state();
+    if (current == ModelState::Loading || current == ModelState::Failed)
+        return;
+    // without a view every mesh is drawn in full and nothing is culled
+    RenderQueue& queue = RenderQueue::shared();
     for (unsigned int i = 0; i < meshes.size(); i++) {
-        meshes[i].Draw(shader);
+        if (meshes[i].isResident())
+            queue.push(shader, meshes[i], model, 0.0f, 0);
     }
 }
 
+void Model::Draw(Shader& shader, const RenderView& view, const glm::mat4& model) {
+    Submit(RenderQueue::shared(), shader, view, model);
+}
+
+void Model::Submit(RenderQueue& queue, Shader& shader, const RenderView& view, const glm::mat4& model) {
+    ModelState current = state();
+    if (current == ModelState::Loading || current == ModelState::Failed)
+        return;
+    float scale = largestScale(model);
+    cullMeshes(view, model, scale);
+    Frustum frustum(view.projection * view.view * model);
+    glm::vec3 cameraPosition = glm::vec3(glm::inverse(model) * glm::vec4(view.cameraPosition, 1.0f));
+    glm::mat4 modelView = view.view * model;
+    for (unsigned int i = 0; i < meshes.size(); i++) {
+        if (!meshVisible[i])
+            continue;
+        Mesh& mesh = meshes[i];
+        unsigned int lod = meshLod(mesh, view, model, scale);
+        float depth = -(modelView * glm::vec4(mesh.boundsCenter, 1.0f)).z;
+        if (lod == 0 && !mesh.meshlets.empty())
+            queue.pushMeshlets(shader, mesh, model, depth, frustum, cameraPosition);
+        else
+            queue.push(shader, mesh, model, depth, lod);
+    }
+}
+
+void Model::cullMeshes(const RenderView& view, const glm::mat4& model, float scale) {
+    // world space bounds of every mesh, tested against the camera frustum in one batch
+    glm::mat3 absolute = glm::mat3(glm::abs(glm::vec3(model[0])), glm::abs(glm::vec3(model[1])), glm::abs(glm::vec3(model[2])));
+    meshBounds.clear();
+    for (const Mesh& mesh : meshes) {
+        glm::vec3 center = glm::vec3(model * glm::vec4(mesh.boundsCenter, 1.0f));
+        meshBounds.push(center, mesh.boundsRadius * scale, absolute * mesh.boundsExtent);
+    }
+    cullBoxes(view.frustum, meshBounds, meshVisible);
+
+    unsigned long long culled = 0;
+    for (size_t i = 0; i < meshes.size(); i++) {
+        if (!meshes[i].isResident())
+            meshVisible[i] = 0;
+        else if (!meshVisible[i])
+            culled++;
+    }
+    RenderStats& stats = RenderStats::current();
+    stats.frame.meshes += meshes.size();
+    stats.frame.meshesCulled += culled;
+}
+
+Aabb Model::Bounds() const {
+    const float infinity = std::numeric_limits<float>::infinity();
+    Aabb bounds{ glm::vec3(infinity), glm::vec3(-infinity) };
+    if (state() == ModelState::Loading)
+        return bounds;
+    for (const Mesh& mesh : meshes)
+        bounds = Aabb::merge(bounds, Aabb{ mesh.boundsCenter - mesh.boundsExtent, mesh.boundsCenter + mesh.boundsExtent });
+    return bounds;
+}
+
+void Model::DrawInstanced(Shader& shader, const RenderView& view, const glm::mat4* transforms, size_t count, unsigned int lod) {
+    ModelState current = state();
+    if (current == ModelState::Loading || current == ModelState::Failed || count == 0)
+        return;
+    // every mesh reads the same matrices
+    InstanceBuffer& instances = InstanceBuffer::shared();
+    size_t offset;
+    if (shader.instancesInClipSpace) {
+        instanceMatrices.resize(count);
+        modelViewProjections(view.projection * view.view, transforms, count, instanceMatrices.data());
+        offset = instances.upload(instanceMatrices.data(), nullptr, count);
+    } else {
+        instanceNormals.resize(count);
+        normalMatrices(transforms, count, instanceNormals.data());
+        offset = instances.upload(transforms, instanceNormals.data(), count);
+    }
+    UniformRing::shared().push(GL_UNIFORM_BUFFER, DRAW_BLOCK_BINDING, DrawConstants::instancedDraw());
+    for (unsigned int i = 0; i < meshes.size(); i++) {
+        Mesh& mesh = meshes[i];
+        if (!mesh.isResident())
+            continue;
+        mesh.material->apply(shader);
+        mesh.applyVertexDecoding();
+        instances.bind(mesh.VAO, offset);
+        mesh.DrawLevelInstanced(lod, static_cast<GLsizei>(count));
+    }
+}
+
+std::shared_ptr<Model> Model::LoadAsync(std::string const& path, UploadQueue uploads, bool gamma, ModelOptions options) {
+    std::shared_ptr<Model> model(new Model(Deferred(), gamma, options));
+    ThreadPool::shared().submit([model, path, uploads]() mutable {
+        if (!model->importModel(path))
+        {
+            model->loadState.store(ModelState::Failed, std::memory_order_release);
+            return;
+        }
+        model->decodeTextures();
+        // from here on the render thread owns the model data
+        model->loadState.store(ModelState::Uploading, std::memory_order_release);
+
+        // one task per texture and per mesh so the render thread can spread them over several frames
+        for (size_t i = 0; i < model->textures_loaded.size(); i++)
+            uploads.push([model, i]() { model->uploadTexture(i); });
+        uploads.push([model]() { model->resolveTextures(); });
+        for (size_t i = 0; i < model->meshes.size(); i++)
+            uploads.push([model, i]() { model->meshes[i].setupMesh(model->geometryArena()); });
+        uploads.push([model, path]() {
+            model->loadState.store(ModelState::Resident, std::memory_order_release);
+            std::cout << "Model resident: " << path << std::endl;
+        });
+    });
+    return model;
+}
+
 void Model::loadModel(std::string const &path) {
+    if (!importModel(path))
+    {
+        loadState.store(ModelState::Failed, std::memory_order_release);
+        return;
+    }
+    // the meshes only recorded which textures they need, decode all of them at once and upload the results
+    decodeTextures();
+    for (size_t i = 0; i < textures_loaded.size(); i++)
+        uploadTexture(i);
+    resolveTextures();
+    // now that we have all the required data, set the vertex buffers and its attribute pointers.
+    for (Mesh& mesh : meshes)
+        mesh.setupMesh(geometryArena());
+    loadState.store(ModelState::Resident, std::memory_order_release);
+}
+
+bool Model::importModel(std::string const &path) {
+    auto start = std::chrono::steady_clock::now();
+    // retrieve the directory path of the filepath
+    directory = path.substr(0, path.find_last_of('/'));
+
+    // a valid mesh cache lets us skip ASSIMP entirely
+    MeshCache cache;
+    if (cache.load(path, IMPORT_FLAGS, options.flags()))
+    {
+        for (const CachedMesh& cached : cache.meshes())
+        {
+            std::vector<Texture> textures;
+            for (const Texture& texture : cached.textures)
+                textures.push_back(loadTexture(texture.path, texture.type));
+            meshes.push_back(Mesh(cached.format, cached.vertices, cached.vertexCount, cached.uvTransform, cached.indexSize, cached.indices, cached.indexCount, textures));
+            meshes.back().lods = cached.lods;
+            meshes.back().meshlets = cached.meshlets;
+            meshes.back().opacity = cached.opacity;
+        }
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "Model loaded from cache: " << path << " (" << elapsed.count() << " ms)" << std::endl;
+        return true;
+    }
+
     // read file via ASSIMP
     Assimp::Importer importer;
-    const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+    // the importer owns and deletes its IO handler
+    RecordingIOSystem* io = new RecordingIOSystem(path);
+    importer.SetIOHandler(io);
+    const aiScene* scene = importer.ReadFile(path, IMPORT_FLAGS);
     // check for errors
     if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
     {
         std::cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << std::endl;
-        return;
+        return false;
     }
-    // retrieve the directory path of the filepath
-    directory = path.substr(0, path.find_last_of('/'));
 
     // process ASSIMP's root node recursively
     processNode(scene->mRootNode, scene);
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "Model imported: " << path << " (" << elapsed.count() << " ms)" << std::endl;
+    size_t vertexCount = 0, vertexBytes = 0, indexCount = 0, indexBytes = 0;
+    for (const Mesh& mesh : meshes)
+    {
+        vertexCount += mesh.vertexCount;
+        vertexBytes += mesh.vertices.size();
+        indexCount += mesh.indexCount();
+        indexBytes += mesh.indices.size();
+    }
+    if (vertexCount > 0)
+        std::cout << "Vertex data: " << vertexBytes << " bytes, " << double(vertexBytes) / vertexCount << " bytes per vertex ("
+                  << vertexCount * sizeof(Vertex) << " bytes unpacked)" << std::endl;
+    if (indexCount > 0)
+        std::cout << "Index data: " << indexBytes << " bytes (" << indexCount * sizeof(unsigned int) << " bytes as 32 bit)" << std::endl;
+
+    // store the result so the next launch can skip the import
+    if (!MeshCache::write(path, IMPORT_FLAGS, options.flags(), io->files(), meshes))
+        std::cout << "ERROR::MESH_CACHE:: Failed to write cache for " << path << std::endl;
+    return true;
 }
 
 void Model::processNode(aiNode* node, const aiScene* scene) {
@@ -56,6 +307,11 @@ Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene) {
     for(unsigned int i = 0; i < mesh->mNumVertices; i++)
     {
         Vertex vertex;
+        for (int k = 0; k < MAX_BONE_INFLUENCE; k++)
+        {
+            vertex.m_BoneIDs[k] = -1;
+            vertex.m_Weights[k] = 0.0f;
+        }
         glm::vec3 vector; // we declare a placeholder vector since assimp uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
         // positions
         vector.x = mesh->mVertices[i].x;
@@ -103,6 +359,24 @@ Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene) {
         for(unsigned int j = 0; j < face.mNumIndices; j++)
             indices.push_back(face.mIndices[j]);        
     }
+    // bone weights, every vertex keeps the first MAX_BONE_INFLUENCE bones that influence it
+    for(unsigned int i = 0; i < mesh->mNumBones; i++)
+    {
+        const aiBone* bone = mesh->mBones[i];
+        for(unsigned int j = 0; j < bone->mNumWeights; j++)
+        {
+            Vertex& vertex = vertices[bone->mWeights[j].mVertexId];
+            for(int k = 0; k < MAX_BONE_INFLUENCE; k++)
+            {
+                if (vertex.m_BoneIDs[k] < 0)
+                {
+                    vertex.m_BoneIDs[k] = static_cast<int>(i);
+                    vertex.m_Weights[k] = bone->mWeights[j].mWeight;
+                    break;
+                }
+            }
+        }
+    }
     // process materials
     aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];    
     // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
@@ -124,9 +398,75 @@ Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene) {
     // 4. height maps
     std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
     textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
+    // 5. opacity: .obj's 'd' comes in as opacity, its 'Tr' as a transparency factor
+    float opacity = 1.0f;
+    float transparency = 0.0f;
+    if (material->Get(AI_MATKEY_OPACITY, opacity) != AI_SUCCESS && material->Get(AI_MATKEY_TRANSPARENCYFACTOR, transparency) == AI_SUCCESS)
+        opacity = 1.0f - transparency;
+    opacity = glm::clamp(opacity, 0.0f, 1.0f);
     
+    // reorder for the GPU: cache friendly triangle order, outward facing clusters first, vertices in fetch order
+    if (options.optimizeMeshes)
+    {
+        VertexCacheStats before = analyzeVertexCache(indices, vertices.size());
+        optimizeVertexCache(indices, vertices.size());
+        optimizeOverdraw(indices, vertices);
+        optimizeVertexFetch(vertices, indices);
+        VertexCacheStats after = analyzeVertexCache(indices, vertices.size());
+        std::cout << "Mesh " << mesh->mName.C_Str() << ": ACMR " << before.acmr << " -> " << after.acmr
+                  << ", ATVR " << before.atvr << " -> " << after.atvr << std::endl;
+    }
+
+    // coarser levels of detail go after the full mesh in the same index buffer and use the same vertices
+    std::vector<MeshLod> lods(1, MeshLod{ 0, static_cast<unsigned int>(indices.size()), 0.0f });
+    if (options.generateLods)
+    {
+        // always simplify the full mesh so each level's error is measured against the original surface
+        std::vector<unsigned int> fullIndices(indices);
+        float extent = meshExtent(vertices);
+        std::cout << "Mesh " << mesh->mName.C_Str() << ": LOD triangles " << fullIndices.size() / 3;
+        for (int level = 1; level < MAX_MESH_LODS; level++)
+        {
+            size_t previousCount = lods.back().indexCount;
+            float error;
+            std::vector<unsigned int> lodIndices = simplifyMesh(fullIndices, vertices, size_t(previousCount * LOD_REDUCTION), LOD_MAX_ERROR, &error);
+            if (lodIndices.size() > previousCount * LOD_MIN_REDUCTION)
+                break;
+            if (options.optimizeMeshes)
+                optimizeVertexCache(lodIndices, vertices.size());
+            lods.push_back(MeshLod{ static_cast<unsigned int>(indices.size()), static_cast<unsigned int>(lodIndices.size()), glm::max(error * extent, lods.back().error) });
+            indices.insert(indices.end(), lodIndices.begin(), lodIndices.end());
+            std::cout << " / " << lodIndices.size() / 3;
+        }
+        std::cout << std::endl;
+    }
+
+    // meshlets only cover the full resolution level, the others are small enough to draw whole
+    std::vector<Meshlet> meshlets;
+    if (options.buildMeshlets)
+    {
+        meshlets = buildMeshlets(indices, 0, lods[0].indexCount, vertices);
+        std::cout << "Mesh " << mesh->mName.C_Str() << ": " << meshlets.size() << " meshlets" << std::endl;
+    }
+
+    // store the vertices in the smallest layout that keeps their precision
+    VertexFormat format = options.compactVertices ? chooseVertexFormat(vertices, mesh->HasBones()) : VertexFormat::Full;
+    glm::vec4 uvTransform;
+    std::vector<unsigned char> vertexData = packVertices(vertices, format, uvTransform);
+    std::cout << "Mesh " << mesh->mName.C_Str() << ": " << vertices.size() << " vertices, " << vertexFormatName(format) << " format, "
+              << vertexStride(format) << " bytes per vertex (" << sizeof(Vertex) << " unpacked)" << std::endl;
+
     // return a mesh object created from the extracted mesh data
-    return Mesh(vertices, indices, textures);
+    // indices as narrow as the vertex count allows
+    unsigned int indexSize = chooseIndexSize(vertices.size());
+    std::vector<unsigned char> indexData = packIndices(indices, indexSize);
+    std::cout << "Mesh " << mesh->mName.C_Str() << ": " << indices.size() << " indices, " << indexSize * 8 << " bit" << std::endl;
+
+    Mesh result(format, vertexData.data(), vertices.size(), uvTransform, indexSize, indexData.data(), indices.size(), textures);
+    result.lods = lods;
+    result.meshlets = meshlets;
+    result.opacity = opacity;
+    return result;
 }
 
 std::vector<Texture> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName) {
@@ -135,68 +475,95 @@ std::vector<Texture> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType
     {
         aiString str;
         mat->GetTexture(type, i, &str);
-        // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-        bool skip = false;
-        for(unsigned int j = 0; j < textures_loaded.size(); j++)
-        {
-            if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-            {
-                textures.push_back(textures_loaded[j]);
-                skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                break;
-            }
-        }
-        if(!skip)
-        {   // if texture hasn't been loaded already, load it
-            Texture texture;
-            texture.id = TextureFromFile(str.C_Str(), this->directory);
-            texture.type = typeName;
-            texture.path = str.C_Str();
-            textures.push_back(texture);
-            textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecessary load duplicate textures.
-        }
+        textures.push_back(loadTexture(str.C_Str(), typeName));
     }
     return textures;
 }
 
-unsigned int TextureFromFile(const char *path, const std::string &directory, bool gamma)
-{
-    std::string filename = std::string(path);
-    filename = directory + '/' + filename;
-    std::cout << "Loading texture at path: " << filename << std::endl;
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
+Texture Model::loadTexture(const std::string& path, const std::string& typeName) {
+    // check if texture was requested before and if so, reuse it: skip loading a new texture
+    auto found = textureIndex.find(path);
+    if (found != textureIndex.end())
+        return textures_loaded[found->second];
+    // if texture hasn't been requested already, queue it up. Its id is filled in once it's uploaded
+    Texture texture;
+    texture.id = 0;
+    texture.type = typeName;
+    texture.path = path;
+    textureIndex[path] = textures_loaded.size();
+    textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecessary load duplicate textures.
+    return texture;
+}
 
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        std::cout << "Texture channel components: " << nrComponents << std::endl;
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
+void Model::decodeTextures() {
+    // the texture cache shares entries between models and between identical files under different paths,
+    // so only images no one decoded or uploaded before cost a decode here
+    TextureCache& cache = TextureCache::instance();
+    textureHandles.resize(textures_loaded.size());
+    std::vector<double> decodeTimes(textures_loaded.size(), 0.0);
+    std::atomic<size_t> decoded(0);
+    auto start = std::chrono::steady_clock::now();
+    ThreadPool& pool = ThreadPool::shared();
+    pool.parallelFor(textures_loaded.size(), [&](size_t i) {
+        auto decodeStart = std::chrono::steady_clock::now();
+        textureHandles[i] = cache.lookup(directory + '/' + textures_loaded[i].path);
+        if (cache.decode(textureHandles[i]))
+            decoded++;
+        decodeTimes[i] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - decodeStart).count();
+    });
+
+    textureStats.count = textures_loaded.size();
+    textureStats.decoded = decoded;
+    textureStats.threads = pool.size() + 1;
+    textureStats.decodeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    textureStats.decodeCpuMs = 0.0;
+    for (double time : decodeTimes)
+        textureStats.decodeCpuMs += time;
+}
+
+GeometryArena& Model::geometryArena() {
+    if (options.sharedGeometry)
+        return GeometryArena::shared();
+    if (!ownGeometry)
+        ownGeometry.reset(new GeometryArena());
+    return *ownGeometry;
+}
+
+void Model::uploadTexture(size_t index) {
+    Texture& texture = textures_loaded[index];
+    std::cout << "Loading texture at path: " << directory << '/' << texture.path << std::endl;
+    auto start = std::chrono::steady_clock::now();
+    texture.id = TextureCache::instance().acquire(textureHandles[index]);
+    textureStats.uploadMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (texture.id)
         std::cout << "Texture successfully loaded\n" << std::endl;
-    }
     else
-    {
         std::cout << "Texture failed to load\n" << std::endl;
-        stbi_image_free(data);
+}
+
+void Model::resolveTextures() {
+    // hand the texture objects over to the meshes that reference them, meshes with the same textures and opacity share
+    // a material
+    std::unordered_map<std::string, std::shared_ptr<Material>> materials;
+    for (Mesh& mesh : meshes)
+    {
+        std::string key;
+        for (Texture& texture : mesh.textures)
+        {
+            auto found = textureIndex.find(texture.path);
+            if (found != textureIndex.end())
+                texture.id = textures_loaded[found->second].id;
+            key += texture.type + '\n' + texture.path + '\n';
+        }
+        key += std::to_string(mesh.opacity);
+        std::shared_ptr<Material>& material = materials[key];
+        if (!material)
+            material = std::make_shared<Material>(mesh.textures, mesh.opacity);
+        mesh.material = material;
     }
+    std::cout << "Materials: " << materials.size() << " for " << meshes.size() << " meshes" << std::endl;
 
-    return textureID;
-}
\ No newline at end of file
+    if (!textures_loaded.empty())
+        std::cout << "Textures: " << textureStats.count << " requested, " << textureStats.decoded << " decoded on " << textureStats.threads << " threads in " << textureStats.decodeMs
+                  << " ms (" << textureStats.decodeCpuMs << " ms of decode work), uploaded in " << textureStats.uploadMs << " ms" << std::endl;
+}
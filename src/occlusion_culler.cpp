@@ -0,0 +1,286 @@
+#include <occlusion_culler.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define OCCLUSION_SSE 1
+#endif
+
+namespace {
+
+// pixels per tile side and tiles per block side
+const unsigned int TILE_SIZE = 8;
+const unsigned int BLOCK_TILES = 4;
+const unsigned int BLOCK_SIZE = TILE_SIZE * BLOCK_TILES;
+// boxes tested per task
+const size_t TEST_BATCH = 256;
+
+unsigned int roundUp(unsigned int value, unsigned int multiple) {
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+}
+
+OcclusionCuller::OcclusionCuller(unsigned int width, unsigned int height) {
+    bufferWidth = roundUp(std::max(width, 1u), BLOCK_SIZE);
+    bufferHeight = roundUp(std::max(height, 1u), BLOCK_SIZE);
+    tilesX = bufferWidth / TILE_SIZE;
+    tilesY = bufferHeight / TILE_SIZE;
+    pixels.assign(size_t(bufferWidth) * bufferHeight, 1.0f);
+    tileDepth.assign(size_t(tilesX) * tilesY, 1.0f);
+    blockDepth.assign(size_t(tilesX / BLOCK_TILES) * (tilesY / BLOCK_TILES), 1.0f);
+    viewProjection = glm::mat4(1.0f);
+}
+
+void OcclusionCuller::beginFrame(const glm::mat4& matrix) {
+    viewProjection = matrix;
+    occluders.clear();
+}
+
+void OcclusionCuller::addOccluder(const Mesh& mesh, const glm::mat4& transform, unsigned int lod) {
+    if (mesh.lods.empty())
+        return;
+    lod = std::min(lod, static_cast<unsigned int>(mesh.lods.size() - 1));
+    occluders.push_back(Occluder{ &mesh, lod, nullptr, 0, nullptr, 0, viewProjection * transform });
+}
+
+void OcclusionCuller::addOccluder(const glm::vec3* positions, size_t vertexCount, const uint32_t* indices, size_t indexCount, const glm::mat4& transform) {
+    occluders.push_back(Occluder{ nullptr, 0, positions, vertexCount, indices, indexCount, viewProjection * transform });
+}
+
+void OcclusionCuller::rasterize(ThreadPool& pool) {
+    // the scratch of earlier frames is kept, only grown
+    if (triangles.size() < occluders.size()) {
+        triangles.resize(occluders.size());
+        clipVertices.resize(occluders.size());
+    }
+    pool.parallelFor(occluders.size(), [this](size_t i) { setupOccluder(i); });
+    std::fill(pixels.begin(), pixels.end(), 1.0f);
+    pool.parallelFor(tilesY, [this](size_t row) { rasterizeTileRow(static_cast<unsigned int>(row)); });
+
+    unsigned int blocksX = tilesX / BLOCK_TILES, blocksY = tilesY / BLOCK_TILES;
+    for (unsigned int by = 0; by < blocksY; by++) {
+        for (unsigned int bx = 0; bx < blocksX; bx++) {
+            float farthest = 0.0f;
+            for (unsigned int ty = by * BLOCK_TILES; ty < (by + 1) * BLOCK_TILES; ty++) {
+                for (unsigned int tx = bx * BLOCK_TILES; tx < (bx + 1) * BLOCK_TILES; tx++)
+                    farthest = std::max(farthest, tileDepth[size_t(ty) * tilesX + tx]);
+            }
+            blockDepth[size_t(by) * blocksX + bx] = farthest;
+        }
+    }
+}
+
+size_t OcclusionCuller::triangleCount() const {
+    size_t count = 0;
+    for (size_t i = 0; i < occluders.size(); i++)
+        count += triangles[i].size();
+    return count;
+}
+
+void OcclusionCuller::setupOccluder(size_t index) {
+    const Occluder& occluder = occluders[index];
+    std::vector<ScreenTriangle>& output = triangles[index];
+    std::vector<glm::vec4>& clip = clipVertices[index];
+    output.clear();
+    // every vertex is transformed once, the triangles share them
+    if (occluder.mesh) {
+        const Mesh& mesh = *occluder.mesh;
+        clip.resize(mesh.vertexCount);
+        for (unsigned int i = 0; i < mesh.vertexCount; i++)
+            clip[i] = occluder.transform * glm::vec4(mesh.position(i), 1.0f);
+        const MeshLod& level = mesh.lods[occluder.lod];
+        for (unsigned int i = level.indexOffset; i + 2 < level.indexOffset + level.indexCount; i += 3)
+            addTriangle(output, clip[mesh.index(i)], clip[mesh.index(i + 1)], clip[mesh.index(i + 2)]);
+    } else {
+        clip.resize(occluder.vertexCount);
+        for (size_t i = 0; i < occluder.vertexCount; i++)
+            clip[i] = occluder.transform * glm::vec4(occluder.positions[i], 1.0f);
+        for (size_t i = 0; i + 2 < occluder.indexCount; i += 3)
+            addTriangle(output, clip[occluder.indices[i]], clip[occluder.indices[i + 1]], clip[occluder.indices[i + 2]]);
+    }
+}
+
+void OcclusionCuller::addTriangle(std::vector<ScreenTriangle>& output, const glm::vec4& a, const glm::vec4& b, const glm::vec4& c) const {
+    // clip against the near plane (z >= -w), which leaves a triangle or a quad
+    const glm::vec4* input[3] = { &a, &b, &c };
+    glm::vec4 polygon[4];
+    int count = 0;
+    for (int i = 0; i < 3; i++) {
+        const glm::vec4& current = *input[i];
+        const glm::vec4& next = *input[(i + 1) % 3];
+        float currentDistance = current.z + current.w, nextDistance = next.z + next.w;
+        if (currentDistance >= 0.0f)
+            polygon[count++] = current;
+        if ((currentDistance >= 0.0f) != (nextDistance >= 0.0f))
+            polygon[count++] = current + (next - current) * (currentDistance / (currentDistance - nextDistance));
+    }
+    if (count < 3)
+        return;
+
+    glm::vec3 screen[4];
+    for (int i = 0; i < count; i++) {
+        float inverseW = 1.0f / polygon[i].w;
+        screen[i] = glm::vec3((polygon[i].x * inverseW * 0.5f + 0.5f) * bufferWidth, (polygon[i].y * inverseW * 0.5f + 0.5f) * bufferHeight,
+                              polygon[i].z * inverseW * 0.5f + 0.5f);
+    }
+    for (int i = 1; i + 1 < count; i++) {
+        const glm::vec3 corners[3] = { screen[0], screen[i], screen[i + 1] };
+        // counter clockwise triangles face the camera, the others and degenerate ones are skipped
+        float area = (corners[1].x - corners[0].x) * (corners[2].y - corners[0].y) - (corners[2].x - corners[0].x) * (corners[1].y - corners[0].y);
+        if (!(area > 0.0f))
+            continue;
+
+        // rows and columns whose pixel centers the bounds contain
+        float minX = std::min({ corners[0].x, corners[1].x, corners[2].x }), maxX = std::max({ corners[0].x, corners[1].x, corners[2].x });
+        float minY = std::min({ corners[0].y, corners[1].y, corners[2].y }), maxY = std::max({ corners[0].y, corners[1].y, corners[2].y });
+        ScreenTriangle triangle;
+        triangle.minX = std::max(0, static_cast<int>(std::ceil(minX - 0.5f)));
+        triangle.maxX = std::min(static_cast<int>(bufferWidth) - 1, static_cast<int>(std::floor(maxX - 0.5f)));
+        triangle.minY = std::max(0, static_cast<int>(std::ceil(minY - 0.5f)));
+        triangle.maxY = std::min(static_cast<int>(bufferHeight) - 1, static_cast<int>(std::floor(maxY - 0.5f)));
+        if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+            continue;
+
+        // edge e runs from corner e to the next one, positive on the inside. It's evaluated relative to the endpoint
+        // that sorts first, so the triangle on the other side of a shared edge gets exactly the negated value and no
+        // pixel center falls through the crack between them
+        for (int e = 0; e < 3; e++) {
+            const glm::vec3& from = corners[e];
+            const glm::vec3& to = corners[(e + 1) % 3];
+            const glm::vec3& origin = (from.x < to.x || (from.x == to.x && from.y < to.y)) ? from : to;
+            triangle.edgeA[e] = from.y - to.y;
+            triangle.edgeB[e] = to.x - from.x;
+            triangle.edgeX[e] = origin.x;
+            triangle.edgeY[e] = origin.y;
+        }
+        // the weight of a corner is the edge across from it over the area, depth is linear in screen space
+        float inverseArea = 1.0f / area;
+        triangle.depthA = (triangle.edgeA[1] * corners[0].z + triangle.edgeA[2] * corners[1].z + triangle.edgeA[0] * corners[2].z) * inverseArea;
+        triangle.depthB = (triangle.edgeB[1] * corners[0].z + triangle.edgeB[2] * corners[1].z + triangle.edgeB[0] * corners[2].z) * inverseArea;
+        triangle.depthC = corners[0].z - triangle.depthA * corners[0].x - triangle.depthB * corners[0].y;
+        output.push_back(triangle);
+    }
+}
+
+void OcclusionCuller::rasterizeTileRow(unsigned int row) {
+    int firstY = static_cast<int>(row * TILE_SIZE), lastY = firstY + static_cast<int>(TILE_SIZE) - 1;
+    for (size_t o = 0; o < occluders.size(); o++) {
+        for (const ScreenTriangle& triangle : triangles[o]) {
+            if (triangle.maxY < firstY || triangle.minY > lastY)
+                continue;
+            int startY = std::max(triangle.minY, firstY), endY = std::min(triangle.maxY, lastY);
+            // whole groups of four pixels, the buffer width is a multiple of four
+            int startX = triangle.minX & ~3;
+            for (int y = startY; y <= endY; y++) {
+                float centerY = y + 0.5f;
+                float rowEdge[3];
+                for (int e = 0; e < 3; e++)
+                    rowEdge[e] = triangle.edgeB[e] * (centerY - triangle.edgeY[e]);
+                float rowDepth = triangle.depthB * centerY + triangle.depthC;
+                float* line = pixels.data() + size_t(y) * bufferWidth;
+#if defined(OCCLUSION_SSE)
+                const __m128 zero = _mm_setzero_ps();
+                const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+                for (int x = startX; x <= triangle.maxX; x += 4) {
+                    __m128 centerX = _mm_add_ps(_mm_set1_ps(float(x)), offsets);
+                    __m128 inside = _mm_cmpeq_ps(zero, zero);
+                    for (int e = 0; e < 3; e++) {
+                        __m128 relative = _mm_sub_ps(centerX, _mm_set1_ps(triangle.edgeX[e]));
+                        __m128 edge = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.edgeA[e]), relative), _mm_set1_ps(rowEdge[e]));
+                        inside = _mm_and_ps(inside, _mm_cmpge_ps(edge, zero));
+                    }
+                    if (_mm_movemask_ps(inside) == 0)
+                        continue;
+                    __m128 depth = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.depthA), centerX), _mm_set1_ps(rowDepth));
+                    __m128 old = _mm_loadu_ps(line + x);
+                    __m128 nearest = _mm_min_ps(old, depth);
+                    _mm_storeu_ps(line + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+                }
+#else
+                for (int x = startX; x <= triangle.maxX; x++) {
+                    float centerX = x + 0.5f;
+                    bool inside = true;
+                    for (int e = 0; e < 3; e++)
+                        inside = inside && triangle.edgeA[e] * (centerX - triangle.edgeX[e]) + rowEdge[e] >= 0.0f;
+                    if (inside)
+                        line[x] = std::min(line[x], triangle.depthA * centerX + rowDepth);
+                }
+#endif
+            }
+        }
+    }
+
+    for (unsigned int tx = 0; tx < tilesX; tx++) {
+        float farthest = 0.0f;
+        for (int y = firstY; y <= lastY; y++) {
+            const float* line = pixels.data() + size_t(y) * bufferWidth + tx * TILE_SIZE;
+            for (unsigned int x = 0; x < TILE_SIZE; x++)
+                farthest = std::max(farthest, line[x]);
+        }
+        tileDepth[size_t(row) * tilesX + tx] = farthest;
+    }
+}
+
+bool OcclusionCuller::isOccluded(const Aabb& box) const {
+    // screen rectangle and nearest depth of the corners
+    const float infinity = std::numeric_limits<float>::infinity();
+    float minX = infinity, maxX = -infinity, minY = infinity, maxY = -infinity, nearest = infinity;
+    // one corner transformed, the others are it plus the transformed box edges
+    glm::vec3 size = box.max - box.min;
+    glm::vec4 first = viewProjection * glm::vec4(box.min, 1.0f);
+    glm::vec4 edgeX = viewProjection[0] * size.x, edgeY = viewProjection[1] * size.y, edgeZ = viewProjection[2] * size.z;
+    for (int i = 0; i < 8; i++) {
+        glm::vec4 clip = first;
+        if (i & 1)
+            clip += edgeX;
+        if (i & 2)
+            clip += edgeY;
+        if (i & 4)
+            clip += edgeZ;
+        if (clip.z < -clip.w || clip.w <= 0.0f)
+            return false;
+        float inverseW = 1.0f / clip.w;
+        float x = (clip.x * inverseW * 0.5f + 0.5f) * bufferWidth, y = (clip.y * inverseW * 0.5f + 0.5f) * bufferHeight;
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+        nearest = std::min(nearest, clip.z * inverseW * 0.5f + 0.5f);
+    }
+    if (maxX < 0.0f || maxY < 0.0f || minX >= float(bufferWidth) || minY >= float(bufferHeight))
+        return false;
+
+    // every pixel the rectangle touches, decided by block, then tile, then pixel depths
+    int firstX = std::max(0, static_cast<int>(minX)), lastX = std::min(static_cast<int>(bufferWidth) - 1, static_cast<int>(maxX));
+    int firstY = std::max(0, static_cast<int>(minY)), lastY = std::min(static_cast<int>(bufferHeight) - 1, static_cast<int>(maxY));
+    unsigned int blocksX = tilesX / BLOCK_TILES;
+    for (int ty = firstY / int(TILE_SIZE); ty <= lastY / int(TILE_SIZE); ty++) {
+        for (int tx = firstX / int(TILE_SIZE); tx <= lastX / int(TILE_SIZE); tx++) {
+            if (blockDepth[size_t(ty / BLOCK_TILES) * blocksX + tx / BLOCK_TILES] < nearest)
+                continue;
+            if (tileDepth[size_t(ty) * tilesX + tx] < nearest)
+                continue;
+            int endY = std::min(lastY, (ty + 1) * int(TILE_SIZE) - 1), endX = std::min(lastX, (tx + 1) * int(TILE_SIZE) - 1);
+            for (int y = std::max(firstY, ty * int(TILE_SIZE)); y <= endY; y++) {
+                const float* line = pixels.data() + size_t(y) * bufferWidth;
+                for (int x = std::max(firstX, tx * int(TILE_SIZE)); x <= endX; x++) {
+                    if (line[x] >= nearest)
+                        return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+void OcclusionCuller::testBoxes(const std::vector<Aabb>& boxes, std::vector<unsigned char>& occluded, ThreadPool& pool) const {
+    occluded.resize(boxes.size());
+    pool.parallelFor((boxes.size() + TEST_BATCH - 1) / TEST_BATCH, [&](size_t batch) {
+        size_t end = std::min(boxes.size(), (batch + 1) * TEST_BATCH);
+        for (size_t i = batch * TEST_BATCH; i < end; i++)
+            occluded[i] = isOccluded(boxes[i]) ? 1 : 0;
+    });
+}
@@ -0,0 +1,225 @@
+#include "glad/glad.h"
+#include <render_queue.hpp>
+#include <render_stats.hpp>
+#include <instance_buffer.hpp>
+#include <uniform_ring.hpp>
+
+#include <cstring>
+
+namespace {
+
+// key layout, from the most significant bit:
+// opaque:      0 | program (10) | VAO (6) | material (14) | mesh (16) | level of detail (2) | depth (15)
+// transparent: 1 | inverted depth (17) | program (10) | VAO (6) | material (14) | mesh (16)
+// draws of the same mesh level end up next to each other, which is what lets them merge into instanced batches
+const unsigned int PROGRAM_BITS = 10;
+const unsigned int VAO_BITS = 6;
+const unsigned int MATERIAL_BITS = 14;
+const unsigned int MESH_BITS = 16;
+const unsigned int LOD_BITS = 2;
+const unsigned int OPAQUE_DEPTH_BITS = 15;
+const unsigned int TRANSPARENT_DEPTH_BITS = 17;
+const uint64_t TRANSPARENT_BIT = uint64_t(1) << 63;
+// fewer draws of a mesh than this are submitted one by one
+const size_t MIN_BATCH_SIZE = 2;
+
+uint64_t field(unsigned int value, unsigned int bits) {
+    return value & ((uint64_t(1) << bits) - 1);
+}
+
+// the top bits of a non-negative float compare like the float itself
+uint64_t depthBits(float depth, unsigned int count) {
+    if (!(depth > 0.0f))
+        return 0;
+    uint32_t bits;
+    std::memcpy(&bits, &depth, sizeof(bits));
+    return bits >> (32 - count);
+}
+
+}
+
+void RenderQueue::push(Shader& shader, Mesh& mesh, const glm::mat4& transform, float depth, unsigned int lod) {
+    items.push_back(DrawItem{ &mesh, mesh.material.get(), &shader, transform, depth, lod, 0, 0 });
+}
+
+void RenderQueue::pushMeshlets(Shader& shader, Mesh& mesh, const glm::mat4& transform, float depth, const Frustum& frustum, glm::vec3 cameraPosition) {
+    size_t first = rangeCounts.size();
+    size_t count = mesh.cullMeshlets(frustum, cameraPosition, rangeCounts, rangeOffsets, rangeBaseVertices);
+    if (count == 0)
+        return;
+    items.push_back(DrawItem{ &mesh, mesh.material.get(), &shader, transform, depth, 0, static_cast<unsigned int>(first), static_cast<unsigned int>(count) });
+}
+
+bool RenderQueue::batchable(const DrawItem& item) {
+    // meshlet ranges differ per item, and transparent items have to keep their back to front order
+    return item.rangeCount == 0 && !item.material->transparent;
+}
+
+bool RenderQueue::sameBatch(const DrawItem& first, const DrawItem& other) {
+    return other.mesh == first.mesh && other.lod == first.lod && other.material == first.material && other.shader == first.shader && batchable(other);
+}
+
+uint64_t RenderQueue::sortKey(const DrawItem& item) {
+    uint64_t program = field(item.shader->ID, PROGRAM_BITS);
+    uint64_t vao = field(item.mesh->VAO, VAO_BITS);
+    uint64_t material = field(item.material->id, MATERIAL_BITS);
+    uint64_t mesh = field(item.mesh->id, MESH_BITS);
+    uint64_t state = (program << (VAO_BITS + MATERIAL_BITS + MESH_BITS)) | (vao << (MATERIAL_BITS + MESH_BITS)) | (material << MESH_BITS) | mesh;
+    if (!item.material->transparent) {
+        uint64_t lod = field(item.lod, LOD_BITS);
+        return (((state << LOD_BITS) | lod) << OPAQUE_DEPTH_BITS) | depthBits(item.depth, OPAQUE_DEPTH_BITS);
+    }
+    // farthest first, state only breaks ties
+    uint64_t inverted = field(static_cast<unsigned int>(~depthBits(item.depth, TRANSPARENT_DEPTH_BITS)), TRANSPARENT_DEPTH_BITS);
+    return TRANSPARENT_BIT | (inverted << (PROGRAM_BITS + VAO_BITS + MATERIAL_BITS + MESH_BITS)) | state;
+}
+
+void RenderQueue::sortEntries() {
+    // all eight histograms in one pass over the keys
+    size_t histograms[8][256] = {};
+    for (const SortEntry& entry : entries) {
+        for (unsigned int digit = 0; digit < 8; digit++)
+            histograms[digit][(entry.key >> (digit * 8)) & 0xFF]++;
+    }
+    sortScratch.resize(entries.size());
+    for (unsigned int digit = 0; digit < 8; digit++) {
+        size_t* histogram = histograms[digit];
+        // a byte shared by every key leaves the order as it is
+        if (histogram[(entries[0].key >> (digit * 8)) & 0xFF] == entries.size())
+            continue;
+        size_t offset = 0;
+        for (unsigned int i = 0; i < 256; i++) {
+            size_t count = histogram[i];
+            histogram[i] = offset;
+            offset += count;
+        }
+        for (const SortEntry& entry : entries)
+            sortScratch[histogram[(entry.key >> (digit * 8)) & 0xFF]++] = entry;
+        entries.swap(sortScratch);
+    }
+}
+
+void RenderQueue::flush(const RenderView& view) {
+    if (items.empty())
+        return;
+    sortItems();
+    drawEntries(0, entries.size(), view.projection * view.view);
+    reset();
+}
+
+void RenderQueue::flush(IndirectRenderer& indirect, const RenderView& view) {
+    if (items.empty())
+        return;
+    sortItems();
+    // opaque items sort first and all go into the multi-draw, transparent ones keep their order and draw one by one
+    size_t i = 0;
+    for (; i < entries.size() && !items[entries[i].item].material->transparent; i++) {
+        DrawItem& item = items[entries[i].item];
+        if (item.rangeCount > 0)
+            indirect.addRanges(*item.mesh, item.transform, &rangeCounts[item.firstRange], &rangeOffsets[item.firstRange], item.rangeCount);
+        else
+            indirect.add(*item.mesh, item.transform, item.lod);
+    }
+    indirect.submit(view);
+    drawEntries(i, entries.size(), view.projection * view.view);
+    reset();
+}
+
+void RenderQueue::sortItems() {
+    entries.resize(items.size());
+    for (size_t i = 0; i < items.size(); i++)
+        entries[i] = SortEntry{ sortKey(items[i]), static_cast<uint32_t>(i) };
+    sortEntries();
+}
+
+void RenderQueue::drawEntries(size_t begin, size_t end, const glm::mat4& viewProjection) {
+    // the matrices of every draw in draw order, in one pass each
+    size_t count = end - begin;
+    drawTransforms.resize(count);
+    drawMatrices.resize(count);
+    drawNormals.resize(count);
+    for (size_t i = begin; i < end; i++)
+        drawTransforms[i - begin] = items[entries[i].item].transform;
+    modelViewProjections(viewProjection, drawTransforms.data(), count, drawMatrices.data());
+    normalMatrices(drawTransforms.data(), count, drawNormals.data());
+
+    // only touch the state that differs from the previous item
+    RenderStats& stats = RenderStats::current();
+    Shader* shader = nullptr;
+    Material* material = nullptr;
+    unsigned int vao = 0;
+    bool blending = false;
+    UniformRing& ring = UniformRing::shared();
+    for (size_t i = begin; i < end; i++) {
+        DrawItem& item = items[entries[i].item];
+        if (item.material->transparent && !blending) {
+            // transparent items come last, they test against the opaque depth but don't write it
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            glDepthMask(GL_FALSE);
+            blending = true;
+        }
+        if (item.shader != shader) {
+            shader = item.shader;
+            shader->use();
+            // sampler uniforms belong to the program, the material has to be applied again
+            material = nullptr;
+            stats.frame.programSwitches++;
+        }
+        if (item.material != material) {
+            material = item.material;
+            material->apply(*shader);
+            stats.frame.textureSwitches += material->textures.size();
+        }
+        if (item.mesh->VAO != vao) {
+            // bound by the draw below
+            vao = item.mesh->VAO;
+            stats.frame.vertexArraySwitches++;
+        }
+        item.mesh->applyVertexDecoding();
+
+        // the same mesh drawn several times in a row becomes one instanced draw
+        size_t batchEnd = i + 1;
+        if (batchable(item)) {
+            while (batchEnd < end && sameBatch(item, items[entries[batchEnd].item]))
+                batchEnd++;
+        }
+        if (batchEnd - i >= MIN_BATCH_SIZE) {
+            // the batch's matrices are already next to each other
+            size_t instanceCount = batchEnd - i;
+            InstanceBuffer& instances = InstanceBuffer::shared();
+            const glm::mat4* matrices = shader->instancesInClipSpace ? &drawMatrices[i - begin] : &drawTransforms[i - begin];
+            size_t offset = instances.upload(matrices, &drawNormals[i - begin], instanceCount);
+            instances.bind(item.mesh->VAO, offset);
+            ring.push(GL_UNIFORM_BUFFER, DRAW_BLOCK_BINDING, DrawConstants::instancedDraw());
+            item.mesh->DrawLevelInstanced(item.lod, static_cast<GLsizei>(instanceCount));
+            stats.frame.batches++;
+            stats.frame.batchedDraws += instanceCount;
+            i = batchEnd - 1;
+            continue;
+        }
+
+        ring.push(GL_UNIFORM_BUFFER, DRAW_BLOCK_BINDING, DrawConstants(item.transform, drawMatrices[i - begin], drawNormals[i - begin]));
+        if (item.rangeCount > 0)
+            item.mesh->DrawRanges(&rangeCounts[item.firstRange], &rangeOffsets[item.firstRange], &rangeBaseVertices[item.firstRange], static_cast<GLsizei>(item.rangeCount));
+        else
+            item.mesh->DrawLevel(item.lod);
+    }
+    if (blending) {
+        glDepthMask(GL_TRUE);
+        glDisable(GL_BLEND);
+    }
+}
+
+RenderQueue& RenderQueue::shared() {
+    static RenderQueue queue;
+    return queue;
+}
+
+void RenderQueue::reset() {
+    items.clear();
+    entries.clear();
+    rangeCounts.clear();
+    rangeOffsets.clear();
+    rangeBaseVertices.clear();
+}
@@ -0,0 +1,71 @@
+#include <render_stats.hpp>
+#include <allocation_counter.hpp>
+
+#include <iostream>
+
+namespace {
+
+// seconds between two reports
+const double REPORT_INTERVAL = 1.0;
+
+}
+
+RenderStats& RenderStats::current() {
+    static RenderStats stats;
+    return stats;
+}
+
+void RenderStats::beginFrame() {
+    frame = Counters();
+    frameStartAllocations = allocationCount();
+}
+
+void RenderStats::endFrame(double frameSeconds) {
+    frame.allocations = allocationCount() - frameStartAllocations;
+    totals.drawCalls += frame.drawCalls;
+    totals.triangles += frame.triangles;
+    totals.meshes += frame.meshes;
+    totals.meshesCulled += frame.meshesCulled;
+    totals.clusters += frame.clusters;
+    totals.clustersCulled += frame.clustersCulled;
+    totals.occlusionTests += frame.occlusionTests;
+    totals.occlusionCulled += frame.occlusionCulled;
+    totals.lights += frame.lights;
+    totals.lightAssignments += frame.lightAssignments;
+    totals.programSwitches += frame.programSwitches;
+    totals.textureSwitches += frame.textureSwitches;
+    totals.vertexArraySwitches += frame.vertexArraySwitches;
+    totals.batches += frame.batches;
+    totals.batchedDraws += frame.batchedDraws;
+    totals.stateCalls += frame.stateCalls;
+    totals.stateCallsElided += frame.stateCallsElided;
+    totals.submitNanoseconds += frame.submitNanoseconds;
+    totals.allocations += frame.allocations;
+    elapsed += frameSeconds;
+    frames++;
+    if (elapsed < REPORT_INTERVAL)
+        return;
+
+    double perFrame = 1.0 / frames;
+    std::cout << "Frame time: " << elapsed * 1000.0 * perFrame << " ms (" << frames / elapsed << " FPS), "
+              << totals.submitNanoseconds * 1.0e-6 * perFrame << " ms submit, "
+              << totals.drawCalls * perFrame << " draw calls, "
+              << totals.triangles * perFrame << " triangles, "
+              << totals.programSwitches * perFrame << " program, " << totals.textureSwitches * perFrame << " texture and "
+              << totals.vertexArraySwitches * perFrame << " VAO switches, "
+              << totals.batches * perFrame << " batches from " << totals.batchedDraws * perFrame << " draws, "
+              << totals.stateCalls * perFrame << " GL binds (" << totals.stateCallsElided * perFrame << " skipped), "
+              << totals.allocations * perFrame << " allocations per frame";
+    if (totals.meshes > 0)
+        std::cout << ", " << 100.0 * totals.meshesCulled / totals.meshes << "% of " << totals.meshes * perFrame << " meshes culled";
+    if (totals.clusters > 0)
+        std::cout << ", " << 100.0 * totals.clustersCulled / totals.clusters << "% of " << totals.clusters * perFrame << " clusters culled";
+    if (totals.occlusionTests > 0)
+        std::cout << ", " << 100.0 * totals.occlusionCulled / totals.occlusionTests << "% of " << totals.occlusionTests * perFrame << " objects occluded";
+    if (totals.lights > 0)
+        std::cout << ", " << totals.lights * perFrame << " lights in " << totals.lightAssignments * perFrame << " cluster slots";
+    std::cout << std::endl;
+    totals = Counters();
+    elapsed = 0.0;
+    frames = 0;
+}
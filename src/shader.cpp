@@ -1,14 +1,41 @@
 #include "glad/glad.h"
 #include <shader.hpp>
+#include <gl_state.hpp>
+#include <uniform_ring.hpp>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <glm/gtc/type_ptr.hpp>
 
-Shader::Shader(const char* vertexPath, const char* fragmentPath) {
+namespace {
+
+// GL type a uniform needs to be declared with to be set through a handle of type T
+template<typename T> GLenum uniformType();
+template<> GLenum uniformType<bool>() { return GL_BOOL; }
+template<> GLenum uniformType<int>() { return GL_INT; }
+template<> GLenum uniformType<float>() { return GL_FLOAT; }
+template<> GLenum uniformType<glm::vec3>() { return GL_FLOAT_VEC3; }
+template<> GLenum uniformType<glm::vec4>() { return GL_FLOAT_VEC4; }
+template<> GLenum uniformType<glm::mat4>() { return GL_FLOAT_MAT4; }
+
+// uniform blocks by name and the binding point UniformRing binds them at, GLSL 3.30 can't say it in the shader
+const struct {
+    const char* name;
+    GLuint binding;
+} UNIFORM_BLOCKS[] = {
+    { "Camera", CAMERA_BLOCK_BINDING },
+    { "DrawConstants", DRAW_BLOCK_BINDING },
+    { "MeshConstants", MESH_BLOCK_BINDING },
+    { "ClusterGrid", CLUSTER_BLOCK_BINDING },
+};
+
+}
+
+Shader::Shader(const char* vertexPath, const char* fragmentPath, const char* fragmentLibraryPath) {
     // Retrieve the vertex/fragment source code from file path
     std::string vertexCode;
     std::string fragmentCode;
+    std::string libraryCode;
     std::ifstream vShaderFile;
     std::ifstream fShaderFile;
     // Ensure ifstream objects can throw exceptions
@@ -28,9 +55,26 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath) {
         // Convert stream into string
         vertexCode = vShaderStream.str();
         fragmentCode = fShaderStream.str();
+        if (fragmentLibraryPath) {
+            std::ifstream libraryFile;
+            libraryFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+            libraryFile.open(fragmentLibraryPath);
+            std::stringstream libraryStream;
+            libraryStream << libraryFile.rdbuf();
+            libraryCode = libraryStream.str();
+        }
     } catch (std::ifstream::failure& e) {
         std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ:\nERROR: " << e.what() << std::endl;
     }
+    if (!libraryCode.empty()) {
+        // nothing but the #version line may come before it. Compile errors report the library as source string 1 and
+        // the fragment shader's own lines as string 0 with their line numbers in its file
+        size_t versionEnd = fragmentCode.find('\n');
+        if (fragmentCode.compare(0, 8, "#version") != 0 || versionEnd == std::string::npos)
+            std::cout << "ERROR::SHADER::FRAGMENT::NO_VERSION_LINE: " << fragmentPath << std::endl;
+        else
+            fragmentCode = fragmentCode.substr(0, versionEnd + 1) + "#line 1 1\n" + libraryCode + "\n#line 2 0\n" + fragmentCode.substr(versionEnd + 1);
+    }
 
     const char* vShaderCode = vertexCode.c_str();
     const char* fShaderCode = fragmentCode.c_str();
@@ -74,6 +118,9 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath) {
         std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << "\n";
     } else {
         std::cout << "SUCCESS::SHADER::PROGRAM::CREATED\n";
+        reflectUniforms();
+        bindUniformBlocks();
+        instancesInClipSpace = glGetAttribLocation(ID, "aInstanceModelViewProjection") >= 0;
     }
 
     // Delete the shaders as they're linked into our program now and no longer necessary
@@ -82,36 +129,139 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath) {
 }
 
 Shader::~Shader() {
-    glDeleteProgram(ID);
+    GLState::current().deleteProgram(ID);
 }
 
 void Shader::use() {
-    glUseProgram(ID);
+    GLState::current().useProgram(ID);
+}
+
+void Shader::reflectUniforms() {
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::string name(static_cast<size_t>(maxLength > 0 ? maxLength : 1), '\0');
+    for (GLint i = 0; i < count; i++) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(ID, static_cast<GLuint>(i), maxLength, &length, &size, &type, &name[0]);
+        std::string uniformName = name.substr(0, static_cast<size_t>(length));
+        GLint location = glGetUniformLocation(ID, uniformName.c_str());
+        // uniforms in blocks have no location
+        if (location < 0)
+            continue;
+        uniforms[uniformName] = UniformInfo{ location, type };
+        // arrays are reported as name[0], make them reachable by their plain name too
+        size_t bracket = uniformName.find('[');
+        if (bracket != std::string::npos)
+            uniforms[uniformName.substr(0, bracket)] = UniformInfo{ location, type };
+    }
+}
+
+void Shader::bindUniformBlocks() {
+    for (const auto& block : UNIFORM_BLOCKS) {
+        GLuint index = glGetUniformBlockIndex(ID, block.name);
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, index, block.binding);
+    }
+}
+
+bool Shader::compatibleType(GLenum declared, GLenum expected) {
+    if (declared == expected)
+        return true;
+    // samplers are set with their texture unit
+    if (expected == GL_INT) {
+        switch (declared) {
+        case GL_SAMPLER_1D: case GL_SAMPLER_2D: case GL_SAMPLER_3D: case GL_SAMPLER_CUBE:
+        case GL_SAMPLER_2D_SHADOW: case GL_SAMPLER_2D_ARRAY: case GL_SAMPLER_2D_ARRAY_SHADOW: case GL_SAMPLER_CUBE_SHADOW:
+        case GL_SAMPLER_BUFFER: case GL_INT_SAMPLER_2D: case GL_UNSIGNED_INT_SAMPLER_2D: case GL_SAMPLER_2D_MULTISAMPLE:
+            return true;
+        default:
+            return false;
+        }
+    }
+    return false;
+}
+
+GLint Shader::location(const std::string& name) const {
+    auto found = uniforms.find(name);
+    return found != uniforms.end() ? found->second.location : -1;
+}
+
+template<typename T>
+UniformHandle<T> Shader::uniform(const std::string& name) const {
+    UniformHandle<T> handle;
+    auto found = uniforms.find(name);
+    // like glGetUniformLocation, names the compiler optimized away just give an invalid handle
+    if (found == uniforms.end())
+        return handle;
+    if (!compatibleType(found->second.type, uniformType<T>())) {
+        std::cout << "ERROR::SHADER::UNIFORM_TYPE_MISMATCH: " << name << std::endl;
+        return handle;
+    }
+    handle.location = found->second.location;
+    return handle;
+}
+
+template UniformHandle<bool> Shader::uniform<bool>(const std::string&) const;
+template UniformHandle<int> Shader::uniform<int>(const std::string&) const;
+template UniformHandle<float> Shader::uniform<float>(const std::string&) const;
+template UniformHandle<glm::vec3> Shader::uniform<glm::vec3>(const std::string&) const;
+template UniformHandle<glm::vec4> Shader::uniform<glm::vec4>(const std::string&) const;
+template UniformHandle<glm::mat4> Shader::uniform<glm::mat4>(const std::string&) const;
+
+void Shader::set(UniformHandle<bool> handle, bool value) const {
+    glUniform1i(handle.location, (int)value);
+}
+
+void Shader::set(UniformHandle<int> handle, int value) const {
+    glUniform1i(handle.location, value);
+}
+
+void Shader::set(UniformHandle<float> handle, float value) const {
+    glUniform1f(handle.location, value);
+}
+
+void Shader::set(UniformHandle<glm::vec3> handle, glm::vec3 value) const {
+    glUniform3fv(handle.location, 1, glm::value_ptr(value));
+}
+
+void Shader::set(UniformHandle<glm::vec4> handle, glm::vec4 value) const {
+    glUniform4fv(handle.location, 1, glm::value_ptr(value));
+}
+
+void Shader::set(UniformHandle<glm::mat4> handle, const glm::mat4& value) const {
+    glUniformMatrix4fv(handle.location, 1, GL_FALSE, glm::value_ptr(value));
 }
 
 void Shader::setBool(const std::string& name, bool value) const {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+    glUniform1i(location(name), (int)value);
 }
 
 void Shader::setInt(const std::string& name, int value) const {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+    glUniform1i(location(name), value);
 }
 
 void Shader::setFloat(const std::string& name, float value) const {
-    glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+    glUniform1f(location(name), value);
 }
 
 void Shader::setVec3(const std::string& name, float x, float y, float z) const {
-    glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+    glUniform3f(location(name), x, y, z);
 }
 
 void Shader::setVec3(const std::string& name, glm::vec3 value) const {
-    glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, glm::value_ptr(value));
+    glUniform3fv(location(name), 1, glm::value_ptr(value));
+}
+
+void Shader::setVec4(const std::string& name, glm::vec4 value) const {
+    glUniform4fv(location(name), 1, glm::value_ptr(value));
 }
 
 void Shader::setMat4(const std::string& name, glm::mat4 value) const {
     glUniformMatrix4fv(
-        glGetUniformLocation(ID, name.c_str()), 
+        location(name),
         1, 
         GL_FALSE, 
         glm::value_ptr(value));
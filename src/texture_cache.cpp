@@ -0,0 +1,165 @@
+#include "glad/glad.h"
+#include <texture_cache.hpp>
+#include <gl_state.hpp>
+#include <mapped_file.hpp>
+
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+#include <vector>
+
+namespace {
+
+std::string canonicalPath(const std::string& filename) {
+    std::error_code error;
+    std::filesystem::path path = std::filesystem::weakly_canonical(filename, error);
+    return error ? filename : path.generic_string();
+}
+
+// whether two files hold the same bytes, files that can't be read never match
+bool sameContents(const std::string& first, const std::string& second) {
+    MappedFile a, b;
+    if (!a.open(first) || !b.open(second))
+        return false;
+    return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size()) == 0;
+}
+
+}
+
+TextureCache& TextureCache::instance() {
+    static TextureCache cache;
+    return cache;
+}
+
+TextureCache::Handle TextureCache::lookup(const std::string& filename) {
+    std::string path = canonicalPath(filename);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = byPath.find(path);
+        if (found != byPath.end())
+            return found->second;
+    }
+
+    // hash outside the lock, the file may be large. Unreadable files get an entry of their own
+    // so they fail to decode once instead of on every lookup
+    uint64_t hash = 0, size = 0;
+    bool readable = hashFile(path, hash, &size);
+
+    // a matching hash and size only make the same image likely, the bytes are compared outside the lock too
+    std::vector<Handle> candidates;
+    if (readable)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto range = byContent.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            if (it->second->contentSize == size)
+                candidates.push_back(it->second);
+        }
+    }
+    Handle same;
+    for (const Handle& candidate : candidates)
+    {
+        if (sameContents(path, candidate->path))
+        {
+            same = candidate;
+            break;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = byPath.find(path);
+    if (found != byPath.end())
+        return found->second;
+    if (same)
+    {
+        // same image under another path, unless its last user released it in the meantime
+        auto range = byContent.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            if (it->second == same)
+            {
+                byPath[path] = same;
+                return same;
+            }
+        }
+    }
+    Handle entry = std::make_shared<Entry>();
+    entry->path = path;
+    entry->contentHash = hash;
+    entry->contentSize = size;
+    byPath[path] = entry;
+    if (readable)
+        byContent.emplace(hash, entry);
+    return entry;
+}
+
+bool TextureCache::decode(const Handle& entry) {
+    std::lock_guard<std::mutex> lock(entry->mutex);
+    if (entry->id != 0 || entry->image.pixels)
+        return false;
+    entry->image = decodeImage(entry->path);
+    return true;
+}
+
+unsigned int TextureCache::acquire(const Handle& entry) {
+    std::lock_guard<std::mutex> lock(entry->mutex);
+    if (entry->id == 0)
+    {
+        if (!entry->image.pixels)
+            entry->image = decodeImage(entry->path);
+        entry->id = uploadTexture(entry->image);
+        // the GPU copy is all we need from now on
+        freeImage(entry->image);
+        if (entry->id == 0)
+            return 0;
+        std::lock_guard<std::mutex> cacheLock(mutex);
+        byTexture[entry->id] = entry;
+    }
+    entry->references++;
+    return entry->id;
+}
+
+void TextureCache::release(unsigned int textureID) {
+    if (textureID == 0)
+        return;
+    Handle entry;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = byTexture.find(textureID);
+        if (found == byTexture.end())
+            return;
+        entry = found->second;
+    }
+
+    std::lock_guard<std::mutex> entryLock(entry->mutex);
+    if (entry->references == 0 || --entry->references > 0)
+        return;
+    GLState::current().deleteTexture(entry->id);
+    entry->id = 0;
+
+    // forget the entry under every path it was known by
+    std::lock_guard<std::mutex> lock(mutex);
+    byTexture.erase(textureID);
+    auto range = byContent.equal_range(entry->contentHash);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (it->second == entry)
+        {
+            byContent.erase(it);
+            break;
+        }
+    }
+    for (auto it = byPath.begin(); it != byPath.end();)
+    {
+        if (it->second == entry)
+            it = byPath.erase(it);
+        else
+            ++it;
+    }
+}
+
+size_t TextureCache::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return byContent.size();
+}
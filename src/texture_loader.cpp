@@ -0,0 +1,42 @@
+#include "glad/glad.h"
+#include <texture_loader.hpp>
+#include <gl_state.hpp>
+#include <stb_image.h>
+
+DecodedImage decodeImage(const std::string& filename) {
+    DecodedImage image;
+    image.pixels = stbi_load(filename.c_str(), &image.width, &image.height, &image.components, 0);
+    return image;
+}
+
+void freeImage(DecodedImage& image) {
+    stbi_image_free(image.pixels);
+    image.pixels = nullptr;
+}
+
+unsigned int uploadTexture(const DecodedImage& image) {
+    if (!image.pixels)
+        return 0;
+
+    GLenum format;
+    if (image.components == 1)
+        format = GL_RED;
+    else if (image.components == 3)
+        format = GL_RGB;
+    else if (image.components == 4)
+        format = GL_RGBA;
+    else
+        return 0;
+
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    GLState::current().bindTexture(0, GL_TEXTURE_2D, textureID);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.pixels);
+    glGenerateMipmap(GL_TEXTURE_2D);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    return textureID;
+}
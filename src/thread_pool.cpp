@@ -0,0 +1,85 @@
+#include <thread_pool.hpp>
+
+#include <algorithm>
+#include <atomic>
+
+ThreadPool::ThreadPool(unsigned int threadCount) {
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned int i = 0; i < threadCount; i++)
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    condition.notify_all();
+    for (std::thread& worker : workers)
+        worker.join();
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& body) {
+    if (count == 0)
+        return;
+    // hand out indices from a shared counter so uneven items balance themselves out. Helpers that
+    // only get to run after everything is done find no work left, which keeps nested calls from
+    // a worker thread from waiting on tasks stuck behind it in the queue.
+    struct Progress {
+        std::atomic<size_t> next{0};
+        size_t done = 0;
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+    auto progress = std::make_shared<Progress>();
+    const std::function<void(size_t)>* work = &body;
+    auto run = [progress, count, work]() {
+        size_t completed = 0;
+        for (size_t i = progress->next++; i < count; i = progress->next++) {
+            (*work)(i);
+            completed++;
+        }
+        if (completed == 0)
+            return;
+        std::lock_guard<std::mutex> lock(progress->mutex);
+        progress->done += completed;
+        if (progress->done == count)
+            progress->finished.notify_all();
+    };
+    size_t helpers = std::min(count - 1, workers.size());
+    for (size_t i = 0; i < helpers; i++)
+        enqueue(run);
+    // the calling thread works too instead of just waiting
+    run();
+    std::unique_lock<std::mutex> lock(progress->mutex);
+    progress->finished.wait(lock, [&progress, count]() { return progress->done == count; });
+}
+
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::enqueue(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push(std::move(task));
+    }
+    condition.notify_one();
+}
+
+void ThreadPool::workerLoop() {
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+            if (stopping && tasks.empty())
+                return;
+            task = std::move(tasks.front());
+            tasks.pop();
+        }
+        task();
+    }
+}
@@ -0,0 +1,128 @@
+#include <transform_batch.hpp>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#endif
+
+namespace {
+
+// columns of the inverse transpose are the cross products of the other two columns over the determinant, the same
+// math the SIMD version does lane by lane
+NormalMatrix normalMatrix(const glm::mat4& model) {
+    glm::vec3 a(model[0]), b(model[1]), c(model[2]);
+    glm::vec3 bc = glm::cross(b, c), ca = glm::cross(c, a), ab = glm::cross(a, b);
+    float inverseDeterminant = 1.0f / glm::dot(a, bc);
+    return NormalMatrix{ { glm::vec4(bc * inverseDeterminant, 0.0f), glm::vec4(ca * inverseDeterminant, 0.0f), glm::vec4(ab * inverseDeterminant, 0.0f) } };
+}
+
+}
+
+void modelViewProjectionsScalar(const glm::mat4& viewProjection, const glm::mat4* models, size_t count, glm::mat4* out) {
+    for (size_t i = 0; i < count; i++)
+        out[i] = viewProjection * models[i];
+}
+
+void normalMatricesScalar(const glm::mat4* models, size_t count, NormalMatrix* out) {
+    for (size_t i = 0; i < count; i++) {
+        glm::mat3 normal = glm::transpose(glm::inverse(glm::mat3(models[i])));
+        out[i] = NormalMatrix{ { glm::vec4(normal[0], 0.0f), glm::vec4(normal[1], 0.0f), glm::vec4(normal[2], 0.0f) } };
+    }
+}
+
+// the products sum in the same order as glm's, so SIMD and scalar results are identical
+#if defined(__AVX__)
+
+void modelViewProjections(const glm::mat4& viewProjection, const glm::mat4* models, size_t count, glm::mat4* out) {
+    // the view projection columns in both halves, each half computes one output column
+    __m256 c0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(&viewProjection[0][0]));
+    __m256 c1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(&viewProjection[1][0]));
+    __m256 c2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(&viewProjection[2][0]));
+    __m256 c3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(&viewProjection[3][0]));
+    for (size_t i = 0; i < count; i++) {
+        for (int column = 0; column < 4; column += 2) {
+            __m256 model = _mm256_loadu_ps(&models[i][column][0]);
+            __m256 x = _mm256_shuffle_ps(model, model, 0x00), y = _mm256_shuffle_ps(model, model, 0x55);
+            __m256 z = _mm256_shuffle_ps(model, model, 0xAA), w = _mm256_shuffle_ps(model, model, 0xFF);
+            __m256 result = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(c0, x), _mm256_mul_ps(c1, y)), _mm256_mul_ps(c2, z)), _mm256_mul_ps(c3, w));
+            _mm256_storeu_ps(&out[i][column][0], result);
+        }
+    }
+}
+
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+
+void modelViewProjections(const glm::mat4& viewProjection, const glm::mat4* models, size_t count, glm::mat4* out) {
+    __m128 c0 = _mm_loadu_ps(&viewProjection[0][0]), c1 = _mm_loadu_ps(&viewProjection[1][0]);
+    __m128 c2 = _mm_loadu_ps(&viewProjection[2][0]), c3 = _mm_loadu_ps(&viewProjection[3][0]);
+    for (size_t i = 0; i < count; i++) {
+        for (int column = 0; column < 4; column++) {
+            const float* model = &models[i][column][0];
+            __m128 result = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(model[0])), _mm_mul_ps(c1, _mm_set1_ps(model[1]))),
+                                                  _mm_mul_ps(c2, _mm_set1_ps(model[2]))),
+                                       _mm_mul_ps(c3, _mm_set1_ps(model[3])));
+            _mm_storeu_ps(&out[i][column][0], result);
+        }
+    }
+}
+
+#else
+
+void modelViewProjections(const glm::mat4& viewProjection, const glm::mat4* models, size_t count, glm::mat4* out) {
+    modelViewProjectionsScalar(viewProjection, models, count, out);
+}
+
+#endif
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+
+void normalMatrices(const glm::mat4* models, size_t count, NormalMatrix* out) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        // one column of four matrices, turned into one register per component with an object in each lane
+        __m128 ax = _mm_loadu_ps(&models[i][0][0]), ay = _mm_loadu_ps(&models[i + 1][0][0]), az = _mm_loadu_ps(&models[i + 2][0][0]), aw = _mm_loadu_ps(&models[i + 3][0][0]);
+        __m128 bx = _mm_loadu_ps(&models[i][1][0]), by = _mm_loadu_ps(&models[i + 1][1][0]), bz = _mm_loadu_ps(&models[i + 2][1][0]), bw = _mm_loadu_ps(&models[i + 3][1][0]);
+        __m128 cx = _mm_loadu_ps(&models[i][2][0]), cy = _mm_loadu_ps(&models[i + 1][2][0]), cz = _mm_loadu_ps(&models[i + 2][2][0]), cw = _mm_loadu_ps(&models[i + 3][2][0]);
+        _MM_TRANSPOSE4_PS(ax, ay, az, aw);
+        _MM_TRANSPOSE4_PS(bx, by, bz, bw);
+        _MM_TRANSPOSE4_PS(cx, cy, cz, cw);
+
+        __m128 bcX = _mm_sub_ps(_mm_mul_ps(by, cz), _mm_mul_ps(bz, cy));
+        __m128 bcY = _mm_sub_ps(_mm_mul_ps(bz, cx), _mm_mul_ps(bx, cz));
+        __m128 bcZ = _mm_sub_ps(_mm_mul_ps(bx, cy), _mm_mul_ps(by, cx));
+        __m128 caX = _mm_sub_ps(_mm_mul_ps(cy, az), _mm_mul_ps(cz, ay));
+        __m128 caY = _mm_sub_ps(_mm_mul_ps(cz, ax), _mm_mul_ps(cx, az));
+        __m128 caZ = _mm_sub_ps(_mm_mul_ps(cx, ay), _mm_mul_ps(cy, ax));
+        __m128 abX = _mm_sub_ps(_mm_mul_ps(ay, bz), _mm_mul_ps(az, by));
+        __m128 abY = _mm_sub_ps(_mm_mul_ps(az, bx), _mm_mul_ps(ax, bz));
+        __m128 abZ = _mm_sub_ps(_mm_mul_ps(ax, by), _mm_mul_ps(ay, bx));
+        __m128 determinant = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bcX), _mm_mul_ps(ay, bcY)), _mm_mul_ps(az, bcZ));
+        __m128 inverse = _mm_div_ps(_mm_set1_ps(1.0f), determinant);
+
+        // back to one register per column and object, w is zero
+        __m128 zero = _mm_setzero_ps();
+        __m128 n0x = _mm_mul_ps(bcX, inverse), n0y = _mm_mul_ps(bcY, inverse), n0z = _mm_mul_ps(bcZ, inverse), n0w = zero;
+        __m128 n1x = _mm_mul_ps(caX, inverse), n1y = _mm_mul_ps(caY, inverse), n1z = _mm_mul_ps(caZ, inverse), n1w = zero;
+        __m128 n2x = _mm_mul_ps(abX, inverse), n2y = _mm_mul_ps(abY, inverse), n2z = _mm_mul_ps(abZ, inverse), n2w = zero;
+        _MM_TRANSPOSE4_PS(n0x, n0y, n0z, n0w);
+        _MM_TRANSPOSE4_PS(n1x, n1y, n1z, n1w);
+        _MM_TRANSPOSE4_PS(n2x, n2y, n2z, n2w);
+        __m128 columns[3][4] = { { n0x, n0y, n0z, n0w }, { n1x, n1y, n1z, n1w }, { n2x, n2y, n2z, n2w } };
+        for (int object = 0; object < 4; object++) {
+            for (int column = 0; column < 3; column++)
+                _mm_storeu_ps(&out[i + object].columns[column][0], columns[column][object]);
+        }
+    }
+    for (; i < count; i++)
+        out[i] = normalMatrix(models[i]);
+}
+
+#else
+
+void normalMatrices(const glm::mat4* models, size_t count, NormalMatrix* out) {
+    for (size_t i = 0; i < count; i++)
+        out[i] = normalMatrix(models[i]);
+}
+
+#endif
@@ -0,0 +1,147 @@
+#include "glad/glad.h"
+#include <uniform_ring.hpp>
+#include <gl_state.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// a frame of a few thousand draws fits before the first growth
+const size_t MIN_SEGMENT_BYTES = 1 << 20;
+// nanoseconds a single wait for a fence lasts before it's retried
+const GLuint64 FENCE_TIMEOUT = 1000000000;
+
+size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+}
+
+CameraConstants::CameraConstants(const RenderView& renderView) {
+    view = renderView.view;
+    projection = renderView.projection;
+    viewProjection = projection * view;
+    inverseView = glm::inverse(view);
+    inverseProjection = glm::inverse(projection);
+    inverseViewProjection = inverseView * inverseProjection;
+    position = glm::vec4(renderView.cameraPosition, 1.0f);
+    for (int i = 0; i < 6; i++)
+        frustumPlanes[i] = renderView.frustum.planes[i];
+}
+
+DrawConstants::DrawConstants(const glm::mat4& transform, const glm::mat4& viewProjection) : model(transform), instanced(0), padding{} {
+    modelViewProjections(viewProjection, &model, 1, &modelViewProjection);
+    normalMatrices(&model, 1, &normalMatrix);
+}
+
+DrawConstants DrawConstants::instancedDraw() {
+    DrawConstants constants(glm::mat4(1.0f), glm::mat4(1.0f), NormalMatrix{ { glm::vec4(1.0f, 0.0f, 0.0f, 0.0f), glm::vec4(0.0f, 1.0f, 0.0f, 0.0f), glm::vec4(0.0f, 0.0f, 1.0f, 0.0f) } });
+    constants.instanced = 1;
+    return constants;
+}
+
+UniformRing::~UniformRing() {
+    deleteFences();
+    GLState& state = GLState::current();
+    for (unsigned int old : retired)
+        state.deleteBuffer(old);
+    if (buffer != 0)
+        state.deleteBuffer(buffer);
+}
+
+void UniformRing::beginFrame() {
+    GLState& state = GLState::current();
+    for (unsigned int old : retired)
+        state.deleteBuffer(old);
+    retired.clear();
+    if (buffer == 0)
+        create(MIN_SEGMENT_BYTES);
+    GLsync& fence = fences[segment];
+    if (fence != nullptr) {
+        // only blocks when the CPU got three frames ahead of the GPU
+        while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT) == GL_TIMEOUT_EXPIRED) {}
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+    cursor = segment * segmentSize;
+    currentEpoch++;
+}
+
+void UniformRing::endFrame() {
+    if (buffer == 0)
+        return;
+    if (fences[segment] != nullptr)
+        glDeleteSync(fences[segment]);
+    fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    segment = (segment + 1) % SEGMENTS;
+}
+
+size_t UniformRing::write(const void* data, size_t size) {
+    if (buffer == 0)
+        create(std::max(MIN_SEGMENT_BYTES, size));
+    size_t offset = alignUp(cursor, alignment);
+    if (offset + size > (segment + 1) * segmentSize) {
+        // the frame outgrew its segment: continue in a bigger buffer, the old one lives until the next frame
+        retired.push_back(buffer);
+        mapped = nullptr;
+        buffer = 0;
+        create(std::max(segmentSize * 2, size));
+        offset = cursor;
+    }
+    if (mapped != nullptr)
+        std::memcpy(mapped + offset, data, size);
+    else {
+        GLState::current().bindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+    }
+    cursor = offset + size;
+    return offset;
+}
+
+void UniformRing::bindRange(GLenum target, unsigned int index, size_t offset, size_t size) {
+    GLState::current().bindBufferRange(target, index, buffer, offset, size);
+}
+
+void UniformRing::create(size_t size) {
+    // the fences guarded the old buffer, nothing is using the new one yet
+    deleteFences();
+    if (alignment == 0) {
+        GLint uniformAlignment = 0;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+        alignment = static_cast<size_t>(std::max(uniformAlignment, 16));
+        if (GLAD_GL_VERSION_4_3) {
+            GLint storageAlignment = 0;
+            glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageAlignment);
+            alignment = std::max(alignment, static_cast<size_t>(storageAlignment));
+        }
+    }
+    segmentSize = alignUp(size, alignment);
+    glGenBuffers(1, &buffer);
+    GLState::current().bindBuffer(GL_UNIFORM_BUFFER, buffer);
+    GLsizeiptr bytes = static_cast<GLsizeiptr>(segmentSize * SEGMENTS);
+    if (GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        // dynamic storage keeps glBufferSubData working should the mapping fail
+        glBufferStorage(GL_UNIFORM_BUFFER, bytes, nullptr, flags | GL_DYNAMIC_STORAGE_BIT);
+        mapped = static_cast<unsigned char*>(glMapBufferRange(GL_UNIFORM_BUFFER, 0, bytes, flags));
+    }
+    else
+        glBufferData(GL_UNIFORM_BUFFER, bytes, nullptr, GL_DYNAMIC_DRAW);
+    cursor = segment * segmentSize;
+    currentEpoch++;
+}
+
+void UniformRing::deleteFences() {
+    for (GLsync& fence : fences) {
+        if (fence != nullptr)
+            glDeleteSync(fence);
+        fence = nullptr;
+    }
+}
+
+UniformRing& UniformRing::shared() {
+    // never destroyed, like the instance buffer it goes away with the context
+    static UniformRing* ring = new UniformRing();
+    return *ring;
+}
@@ -0,0 +1,35 @@
+#include <upload_queue.hpp>
+
+#include <chrono>
+
+UploadQueue::UploadQueue() : state(std::make_shared<State>()) {}
+
+void UploadQueue::push(std::function<void()> task) {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    state->tasks.push_back(std::move(task));
+}
+
+size_t UploadQueue::process(double budgetMs) {
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(budgetMs));
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (state->tasks.empty())
+                return 0;
+            task = std::move(state->tasks.front());
+            state->tasks.pop_front();
+        }
+        // run outside the lock, tasks are free to queue follow up work
+        task();
+        if (std::chrono::steady_clock::now() >= deadline)
+            break;
+    }
+    return pending();
+}
+
+size_t UploadQueue::pending() const {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    return state->tasks.size();
+}
@@ -0,0 +1,265 @@
+#include <vertex_format.hpp>
+
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// meshes with up to this many vertices use 8 bit indices
+const size_t MAX_BYTE_INDEX_VERTICES = 256;
+const size_t MAX_SHORT_INDEX_VERTICES = 65536;
+
+// largest position rounding error accepted for half floats, relative to the mesh's bounding box diagonal
+const float HALF_POSITION_TOLERANCE = 1.0f / 2048.0f;
+
+float signNotZero(float value) {
+    return value >= 0.0f ? 1.0f : -1.0f;
+}
+
+// map a unit vector onto the octahedron and unfold it into [-1, 1]^2
+glm::vec2 octEncode(glm::vec3 n) {
+    float length = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+    if (length == 0.0f)
+        return glm::vec2(0.0f);
+    glm::vec2 p = glm::vec2(n.x, n.y) / length;
+    if (n.z < 0.0f)
+        p = glm::vec2((1.0f - std::fabs(p.y)) * signNotZero(p.x), (1.0f - std::fabs(p.x)) * signNotZero(p.y));
+    return p;
+}
+
+// [-1, 1] and [0, 1] to 16 bit normalized integers, out of range values are clamped
+int16_t packSnorm16(float value) {
+    return static_cast<int16_t>(std::round(glm::clamp(value, -1.0f, 1.0f) * 32767.0f));
+}
+
+uint16_t packUnorm16(float value) {
+    return static_cast<uint16_t>(std::round(glm::clamp(value, 0.0f, 1.0f) * 65535.0f));
+}
+
+void packOct(glm::vec3 n, int16_t out[2]) {
+    glm::vec2 p = octEncode(n);
+    out[0] = packSnorm16(p.x);
+    out[1] = packSnorm16(p.y);
+}
+
+float bitangentSign(const Vertex& vertex) {
+    return glm::dot(glm::cross(vertex.Normal, vertex.Tangent), vertex.Bitangent) < 0.0f ? -1.0f : 1.0f;
+}
+
+// fill the attributes shared by both packed layouts
+template<typename Packed>
+void packFrame(const Vertex& vertex, glm::vec4 uvTransform, Packed& packed) {
+    packOct(vertex.Normal, packed.Normal);
+    packOct(vertex.Tangent, packed.Tangent);
+    glm::vec2 uv = (vertex.TexCoords - glm::vec2(uvTransform.x, uvTransform.y)) / glm::vec2(uvTransform.z, uvTransform.w);
+    packed.TexCoords[0] = packUnorm16(uv.x);
+    packed.TexCoords[1] = packUnorm16(uv.y);
+}
+
+void packSkin(const Vertex& vertex, PackedSkin& skin) {
+    for (int i = 0; i < MAX_BONE_INFLUENCE; i++) {
+        bool used = vertex.m_BoneIDs[i] >= 0;
+        skin.BoneIDs[i] = used ? static_cast<uint8_t>(vertex.m_BoneIDs[i]) : 0;
+        skin.Weights[i] = used ? static_cast<uint8_t>(glm::round(glm::clamp(vertex.m_Weights[i], 0.0f, 1.0f) * 255.0f)) : 0;
+    }
+}
+
+}
+
+unsigned int vertexStride(VertexFormat format) {
+    switch (format) {
+    case VertexFormat::PackedHalf:
+        return sizeof(PackedVertexHalf);
+    case VertexFormat::PackedFloat:
+        return sizeof(PackedVertexFloat);
+    case VertexFormat::PackedHalfSkinned:
+        return sizeof(PackedVertexHalf) + sizeof(PackedSkin);
+    case VertexFormat::PackedFloatSkinned:
+        return sizeof(PackedVertexFloat) + sizeof(PackedSkin);
+    default:
+        return sizeof(Vertex);
+    }
+}
+
+bool isPackedFormat(VertexFormat format) {
+    return format != VertexFormat::Full;
+}
+
+bool isSkinnedFormat(VertexFormat format) {
+    return format == VertexFormat::PackedHalfSkinned || format == VertexFormat::PackedFloatSkinned;
+}
+
+const char* vertexFormatName(VertexFormat format) {
+    switch (format) {
+    case VertexFormat::PackedHalf:
+        return "packed half";
+    case VertexFormat::PackedFloat:
+        return "packed float";
+    case VertexFormat::PackedHalfSkinned:
+        return "packed half skinned";
+    case VertexFormat::PackedFloatSkinned:
+        return "packed float skinned";
+    default:
+        return "full";
+    }
+}
+
+VertexFormat chooseVertexFormat(const std::vector<Vertex>& vertices, bool skinned) {
+    if (vertices.empty())
+        return VertexFormat::Full;
+    // packed skin data only has room for 256 bones
+    if (skinned) {
+        for (const Vertex& vertex : vertices)
+            for (int i = 0; i < MAX_BONE_INFLUENCE; i++)
+                if (vertex.m_BoneIDs[i] > 255)
+                    return VertexFormat::Full;
+    }
+
+    glm::vec3 minimum = vertices[0].Position, maximum = vertices[0].Position;
+    for (const Vertex& vertex : vertices) {
+        minimum = glm::min(minimum, vertex.Position);
+        maximum = glm::max(maximum, vertex.Position);
+    }
+    float tolerance = glm::length(maximum - minimum) * HALF_POSITION_TOLERANCE;
+
+    bool half = true;
+    for (const Vertex& vertex : vertices) {
+        for (int i = 0; i < 3 && half; i++) {
+            float value = vertex.Position[i];
+            float rounded = halfToFloat(floatToHalf(value));
+            // also catches values out of half range, which round to infinity
+            if (!(std::fabs(rounded - value) <= tolerance))
+                half = false;
+        }
+        if (!half)
+            break;
+    }
+    if (half)
+        return skinned ? VertexFormat::PackedHalfSkinned : VertexFormat::PackedHalf;
+    return skinned ? VertexFormat::PackedFloatSkinned : VertexFormat::PackedFloat;
+}
+
+std::vector<unsigned char> packVertices(const std::vector<Vertex>& vertices, VertexFormat format, glm::vec4& uvTransform) {
+    uvTransform = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+    unsigned int stride = vertexStride(format);
+    std::vector<unsigned char> data(vertices.size() * stride);
+    if (vertices.empty())
+        return data;
+    if (!isPackedFormat(format)) {
+        std::memcpy(data.data(), vertices.data(), data.size());
+        return data;
+    }
+
+    // unorm16 texture coordinates cover exactly the range the mesh uses, which may go past [0, 1] with repeating textures
+    glm::vec2 minimum = vertices[0].TexCoords, maximum = vertices[0].TexCoords;
+    for (const Vertex& vertex : vertices) {
+        minimum = glm::min(minimum, vertex.TexCoords);
+        maximum = glm::max(maximum, vertex.TexCoords);
+    }
+    glm::vec2 scale = maximum - minimum;
+    uvTransform = glm::vec4(minimum.x, minimum.y, scale.x > 0.0f ? scale.x : 1.0f, scale.y > 0.0f ? scale.y : 1.0f);
+
+    bool halfPosition = format == VertexFormat::PackedHalf || format == VertexFormat::PackedHalfSkinned;
+    bool skinned = isSkinnedFormat(format);
+    for (size_t i = 0; i < vertices.size(); i++) {
+        const Vertex& vertex = vertices[i];
+        unsigned char* out = data.data() + i * stride;
+        size_t skinOffset;
+        if (halfPosition) {
+            PackedVertexHalf packed;
+            for (int c = 0; c < 3; c++)
+                packed.Position[c] = floatToHalf(vertex.Position[c]);
+            packed.Position[3] = floatToHalf(bitangentSign(vertex));
+            packFrame(vertex, uvTransform, packed);
+            std::memcpy(out, &packed, sizeof(packed));
+            skinOffset = sizeof(packed);
+        } else {
+            PackedVertexFloat packed;
+            for (int c = 0; c < 3; c++)
+                packed.Position[c] = vertex.Position[c];
+            packed.Position[3] = bitangentSign(vertex);
+            packFrame(vertex, uvTransform, packed);
+            std::memcpy(out, &packed, sizeof(packed));
+            skinOffset = sizeof(packed);
+        }
+        if (skinned) {
+            PackedSkin skin;
+            packSkin(vertex, skin);
+            std::memcpy(out + skinOffset, &skin, sizeof(skin));
+        }
+    }
+    return data;
+}
+
+unsigned int chooseIndexSize(size_t vertexCount) {
+    if (vertexCount <= MAX_BYTE_INDEX_VERTICES)
+        return sizeof(uint8_t);
+    if (vertexCount <= MAX_SHORT_INDEX_VERTICES)
+        return sizeof(uint16_t);
+    return sizeof(uint32_t);
+}
+
+std::vector<unsigned char> packIndices(const std::vector<unsigned int>& indices, unsigned int indexSize) {
+    std::vector<unsigned char> data(indices.size() * indexSize);
+    if (indexSize == sizeof(uint32_t)) {
+        if (!indices.empty())
+            std::memcpy(data.data(), indices.data(), data.size());
+        return data;
+    }
+    for (size_t i = 0; i < indices.size(); i++) {
+        if (indexSize == sizeof(uint16_t)) {
+            uint16_t index = static_cast<uint16_t>(indices[i]);
+            std::memcpy(data.data() + i * sizeof(index), &index, sizeof(index));
+        } else {
+            data[i] = static_cast<uint8_t>(indices[i]);
+        }
+    }
+    return data;
+}
+
+uint16_t floatToHalf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000u;
+    uint32_t exponent = (bits >> 23) & 0xffu;
+    uint32_t mantissa = bits & 0x7fffffu;
+    // infinity stays infinity, NaN stays NaN
+    if (exponent == 0xffu)
+        return static_cast<uint16_t>(sign | 0x7c00u | (mantissa != 0 ? 0x200u : 0u));
+    int halfExponent = static_cast<int>(exponent) - 127 + 15;
+    if (halfExponent >= 31)
+        return static_cast<uint16_t>(sign | 0x7c00u);
+    uint32_t half, remainder, halfway;
+    if (halfExponent <= 0) {
+        // subnormal half, too small ones round to zero
+        if (halfExponent < -10)
+            return static_cast<uint16_t>(sign);
+        mantissa |= 0x800000u;
+        uint32_t shift = static_cast<uint32_t>(14 - halfExponent);
+        half = mantissa >> shift;
+        remainder = mantissa & ((1u << shift) - 1u);
+        halfway = 1u << (shift - 1u);
+    } else {
+        half = (static_cast<uint32_t>(halfExponent) << 10) | (mantissa >> 13);
+        remainder = mantissa & 0x1fffu;
+        halfway = 0x1000u;
+    }
+    // round to nearest even, a carry out of the mantissa correctly moves on to the next exponent or infinity
+    if (remainder > halfway || (remainder == halfway && (half & 1u)))
+        half++;
+    return static_cast<uint16_t>(sign | half);
+}
+
+float halfToFloat(uint16_t half) {
+    uint32_t sign = static_cast<uint32_t>(half & 0x8000u) << 16;
+    uint32_t exponent = (half >> 10) & 0x1fu;
+    uint32_t mantissa = half & 0x3ffu;
+    if (exponent == 0) {
+        float value = std::ldexp(static_cast<float>(mantissa), -24);
+        return sign != 0 ? -value : value;
+    }
+    uint32_t bits = sign | (exponent == 31 ? 0x7f800000u : (exponent + 112u) << 23) | (mantissa << 13);
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}